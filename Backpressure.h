@@ -0,0 +1,147 @@
+#ifndef _BACKPRESSURE_H_
+#define _BACKPRESSURE_H_
+
+// Header Includes
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "DeviceClock.h"
+#include "RecordingFormat.h"
+
+// What to give up, beyond frames lost to a full ring, while the writer falls behind
+enum ShedPolicy
+{
+	SHED_POLICY_NONE,	// Nothing; frames are only lost once a ring is full
+	SHED_POLICY_DROP_COLOR,	// Drop color frames, keeping depth
+	SHED_POLICY_DECIMATE,	// Keep only frames whose index is a multiple of the decimation, in both streams
+	SHED_POLICY_COMPRESS	// Keep every frame but store raw streams compressed until the writer catches up
+};
+
+// Why a frame was shed
+enum ShedReason
+{
+	SHED_REASON_DROP_COLOR,
+	SHED_REASON_DECIMATE,
+	SHED_REASON_COUNT
+};
+
+// Decides what to shed while storage lags. The writer counts as lagging once either ring is half
+// full and until both are down to a quarter, so the policy switches on before frames are lost at
+// random to a full ring and doesn't flap around a single threshold. Safe to call from the capture,
+// listener and writer threads at once.
+class Backpressure
+{
+public:
+	Backpressure(ShedPolicy policy, int decimation) :
+		m_policy(policy), m_decimation(decimation > 1 ? decimation : 2), m_lagging(false), m_episodes(0), m_laggingSince(0), m_laggingTime(0)
+	{
+		for(int s = 0; s < RECORDING_MAX_STREAMS; s++)
+		{
+			for(int r = 0; r < SHED_REASON_COUNT; r++)
+			{
+				m_shed[s][r].store(0);
+			}
+			m_compressed[s].store(0);
+		}
+	}
+
+	// Updates the lagging state from the fuller ring's occupancy and returns it
+	bool update(unsigned int occupancy, unsigned int capacity)
+	{
+		bool lagging = m_lagging.load(std::memory_order_relaxed);
+		if(!lagging && occupancy * 2 >= capacity)
+		{
+			if(!m_lagging.exchange(true, std::memory_order_relaxed))
+			{
+				m_episodes.fetch_add(1, std::memory_order_relaxed);
+				m_laggingSince.store(HostClockMicroseconds(), std::memory_order_relaxed);
+			}
+			return true;
+		}
+		if(lagging && occupancy * 4 <= capacity)
+		{
+			if(m_lagging.exchange(false, std::memory_order_relaxed))
+			{
+				m_laggingTime.fetch_add(HostClockMicroseconds() - m_laggingSince.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+			return false;
+		}
+		return lagging;
+	}
+
+	// Capture side: true to keep a frame just read, false (and counted) to shed it
+	bool keep(RecordingStream stream, int frameIndex, bool lagging)
+	{
+		if(!lagging)
+		{
+			return true;
+		}
+		if(m_policy == SHED_POLICY_DROP_COLOR && stream == RECORDING_STREAM_COLOR)
+		{
+			m_shed[stream][SHED_REASON_DROP_COLOR].fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		if(m_policy == SHED_POLICY_DECIMATE && frameIndex % m_decimation != 0)
+		{
+			m_shed[stream][SHED_REASON_DECIMATE].fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		return true;
+	}
+
+	// Writer side: true to compress a frame of a stream that is normally stored raw
+	bool compress(RecordingStream stream, bool lagging)
+	{
+		if(m_policy != SHED_POLICY_COMPRESS || !lagging)
+		{
+			return false;
+		}
+		m_compressed[stream].fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Prints how often and how long the writer lagged and what was shed for it
+	void printStatistics(std::ostream& out)
+	{
+		static const char* policies[] = { "none", "drop-color", "decimate", "compress" };
+		uint64_t laggingTime = m_laggingTime.load();
+		if(m_lagging.load())
+		{
+			laggingTime += HostClockMicroseconds() - m_laggingSince.load();
+		}
+
+		char line[256];
+		snprintf(line, sizeof(line), "Backpressure (%s) : writer lagged %lu times for %.2f s", policies[m_policy], m_episodes.load(), laggingTime / 1000000.0);
+		out << line;
+		if(m_policy == SHED_POLICY_DROP_COLOR || m_policy == SHED_POLICY_DECIMATE)
+		{
+			ShedReason reason = (m_policy == SHED_POLICY_DROP_COLOR) ? SHED_REASON_DROP_COLOR : SHED_REASON_DECIMATE;
+			out << " | Shed by policy : color " << m_shed[RECORDING_STREAM_COLOR][reason].load() << ", depth " << m_shed[RECORDING_STREAM_DEPTH][reason].load();
+		}
+		else if(m_policy == SHED_POLICY_COMPRESS)
+		{
+			out << " | Compressed under load : color " << m_compressed[RECORDING_STREAM_COLOR].load() << ", depth " << m_compressed[RECORDING_STREAM_DEPTH].load();
+		}
+		out << std::endl;
+	}
+
+	ShedPolicy policy() const { return m_policy; }
+	unsigned long shed(RecordingStream stream, ShedReason reason) const { return m_shed[stream][reason].load(std::memory_order_relaxed); }
+
+private:
+	Backpressure(const Backpressure&);
+	Backpressure& operator=(const Backpressure&);
+
+	ShedPolicy m_policy;
+	int m_decimation;
+	std::atomic<bool> m_lagging;
+	std::atomic<unsigned long> m_episodes;
+	std::atomic<uint64_t> m_laggingSince;
+	std::atomic<uint64_t> m_laggingTime;
+	std::atomic<unsigned long> m_shed[RECORDING_MAX_STREAMS][SHED_REASON_COUNT];
+	std::atomic<unsigned long> m_compressed[RECORDING_MAX_STREAMS];
+};
+
+#endif // _BACKPRESSURE_H_
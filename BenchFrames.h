@@ -0,0 +1,124 @@
+#ifndef _BENCH_FRAMES_H_
+#define _BENCH_FRAMES_H_
+
+// Header Includes
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+#include "RecordingReader.h"
+
+// Frame size of the split files of the old program, and of the synthetic frames
+#define BENCH_LEGACY_RES_X 640
+#define BENCH_LEGACY_RES_Y 480
+
+// Number of synthetic frames the benchmarks run over without a recording
+#define BENCH_SYNTHETIC_FRAMES 16
+
+inline double Seconds()
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+// Parses the arguments the frame benchmarks share, [Recording.rgbd] [Iterations] or
+// --split ImageOutput.dat DepthOutput.dat [Iterations], and opens the recording if one is given.
+// Leaves iterations alone when no count is given. A benchmark whose count is something else, such
+// as threads, names it for the usage. Returns false after printing usage or an error.
+inline bool OpenBenchRecording(const int argc, const char* argv[], RecordingReader& reader, int& iterations, const char* countName = "Iterations")
+{
+	bool opened = true;
+	int argi = 1;
+	if(argc >= 4 && strcmp(argv[1], "--split") == 0)
+	{
+		opened = reader.openSplit(argv[2], argv[3], BENCH_LEGACY_RES_X, BENCH_LEGACY_RES_Y);
+		argi = 4;
+	}
+	else if(argc >= 2 && argv[1][0] != '-' && atoi(argv[1]) == 0)
+	{
+		opened = reader.openRecording(argv[1]);
+		argi = 2;
+	}
+	else if(argc >= 2 && argv[1][0] == '-')
+	{
+		std::cerr << "Usage: " << argv[0] << " [Recording.rgbd] [" << countName << "]" << std::endl;
+		std::cerr << "       " << argv[0] << " --split ImageOutput.dat DepthOutput.dat [" << countName << "]" << std::endl;
+		return false;
+	}
+	if(!opened)
+	{
+		std::cerr << "Can't open recording" << std::endl;
+		return false;
+	}
+	if(argi < argc)
+	{
+		iterations = atoi(argv[argi]);
+	}
+	return true;
+}
+
+// Appends the decoded frames of one stream of a recording, packed without row padding: 8 bit RGB
+// for color, 16 bit values for depth. width and height become those of the frames read.
+template<typename T>
+void ReadBenchFrames(const RecordingReader& reader, RecordingStream stream, int& width, int& height, std::vector< std::vector<T> >& frames)
+{
+	int channels = (stream == RECORDING_STREAM_COLOR) ? 3 : 1;
+	for(uint64_t n = 0; n < reader.frameCount(stream); n++)
+	{
+		FrameView view;
+		if(!reader.frame(stream, n, view))
+		{
+			continue;
+		}
+		std::vector<T> frame(view.width * view.height * channels);
+		if(RecordingReader::decode(view, &frame[0]))
+		{
+			width = view.width;
+			height = view.height;
+			frames.push_back(frame);
+		}
+	}
+}
+
+// Synthetic depth frames: a floor-to-wall ramp over the sensor's 0.5 - 8 m range with a little
+// noise and some invalid pixels, and a box 1 m in front of it moving across the frames. The same
+// frames on every run.
+inline void SyntheticDepthFrames(int width, int height, std::vector< std::vector<uint16_t> >& frames)
+{
+	srand(1);
+	for(int f = 0; f < BENCH_SYNTHETIC_FRAMES; f++)
+	{
+		std::vector<uint16_t> frame(width * height);
+		for(int y = 0; y < height; y++)
+		{
+			for(int x = 0; x < width; x++)
+			{
+				int depth = 500 + (y * 7500 / height) + rand() % 8;
+				bool box = x >= f * width / BENCH_SYNTHETIC_FRAMES && x < f * width / BENCH_SYNTHETIC_FRAMES + width / 8 && y >= height / 3 && y < height * 2 / 3;
+				frame[y * width + x] = (rand() % 20 == 0) ? 0 : box ? depth - 1000 : depth;
+			}
+		}
+		frames.push_back(frame);
+	}
+}
+
+// Synthetic RGB color frames of random bytes, the same on every run
+inline void SyntheticColorFrames(int width, int height, std::vector< std::vector<uint8_t> >& frames)
+{
+	srand(1);
+	for(int f = 0; f < BENCH_SYNTHETIC_FRAMES; f++)
+	{
+		std::vector<uint8_t> frame(width * height * 3);
+		for(size_t i = 0; i < frame.size(); i++)
+		{
+			frame[i] = rand();
+		}
+		frames.push_back(frame);
+	}
+}
+
+#endif // _BENCH_FRAMES_H_
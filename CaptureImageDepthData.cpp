@@ -1,275 +1,2311 @@
-// Header Includes
-#include <opencv2/opencv.hpp>
-#include <OpenNI.h>
-#include <iostream>
-#include <curses.h>
-
-#define RES_X 640
-#define RES_Y 480
-
-#define DEFAULT_FRAME_LIMIT 9000
-
-// Namespaces
-using namespace std;
-
-int main( const int argc, const char* argv[] )
-{	
-	// Device
-	openni::Device device;
-
-	// VideoStream
-	openni::VideoStream color;
-	openni::VideoStream depth;
-
-	// Target Device URI
-	const char* device_uri = openni::ANY_DEVICE;
-
-	// Initialize OpenNI Module
-	openni::Status ret = openni::OpenNI::initialize();
-	cout << "OpenNI Initialization Error : " << openni::OpenNI::getExtendedError() << endl;
-
-	// Device Counts & Informations
-	openni::Array< openni::DeviceInfo > devicesInfo;
-	openni::OpenNI::enumerateDevices( &devicesInfo );
-	cout << "Device Counts : " << devicesInfo.getSize() << endl;
-	for ( int i = 0 ; i < devicesInfo.getSize() ; i++ )
-	{
-		cout << "Device Info [ " << i << " ] : " << devicesInfo[i].getName() << endl;
-	}
-
-	// Open
-	ret =device.open( device_uri );
-	if ( ret != openni::STATUS_OK )
-	{
-		cerr << "Device Open Failed" << endl;
-		// Shutdown
-		openni::OpenNI::shutdown();
-		return EXIT_FAILURE;
-	}
-
-	/*Set Image Registration Mode (Depth to color)
-	openni::ImageRegistrationMode imgRegMode = openni::IMAGE_REGISTRATION_DEPTH_TO_COLOR;
-	ret = device.setImageRegistrationMode(imgRegMode);
-	if (~( ret == openni::STATUS_OK )){
-		cout << "Can't set depth to color registration" << endl;
-	}
-	*/
-	// Create Depth Image
-	ret = depth.create( device, openni::SENSOR_DEPTH );
-	openni::VideoMode dMode = depth.getVideoMode();	
-	dMode.setResolution(RES_X, RES_Y);
-	depth.setVideoMode(dMode);
-	if ( ret == openni::STATUS_OK )
-	{
-		// Start Depth
-		depth.start();
-	}
-
-	// Create Color Image
-	ret = color.create( device, openni::SENSOR_COLOR );	
-	openni::VideoMode cMode = color.getVideoMode();	
-	cMode.setResolution(RES_X, RES_Y);
-	color.setVideoMode(cMode);
-
-	if ( ret == openni::STATUS_OK )
-	{
-		// Start Color
-		color.start();
-	}
-	
-
-	// Check Valid State
-	if ( !color.isValid() || !depth.isValid() )
-	{
-		cout << "Image Invalid" << endl;
-		openni::OpenNI::shutdown();
-		return EXIT_FAILURE;
-	}
-
-	// Get Color Stream Min-Max Value
-	int minColorValue = color.getMinPixelValue();
-	int maxColorValue = color.getMaxPixelValue();
-	cout << "Color min-Max Value : " << minColorValue << "-" << maxColorValue << endl;
-
-	// Get Depth Stream Min-Max Value
-	int minDepthValue = depth.getMinPixelValue();
-	int maxDepthValue = depth.getMaxPixelValue();
-	cout << "Depth min-Max Value : " << minDepthValue << "-" << maxDepthValue << endl;
-
-	// Get Sensor Resolution Information
-	int dImgWidth = depth.getVideoMode().getResolutionX();
-	int dImgHeight = depth.getVideoMode().getResolutionY();
-	int cImgWidth = color.getVideoMode().getResolutionX();
-	int cImgHeight = color.getVideoMode().getResolutionY();
-	cout << "Color Resolution : " << cImgWidth << "x" << cImgHeight << endl;
-	cout << "Depth Resolution : " << dImgWidth << "x" << dImgHeight << endl;
-
-	// Frame Information Reference
-	openni::VideoFrameRef colorFrame;
-	openni::VideoFrameRef depthFrame;
-
-	// Color Image & Depth Image Matrix
-	cv::Mat cImg = cv::Mat( cImgHeight, cImgWidth, CV_8UC3 );
-	cv::Mat dImg = cv::Mat( dImgHeight, dImgWidth, CV_8UC3 );
-	cv::Mat dRaw = cv::Mat (dImgHeight, dImgWidth, CV_16UC1 );
-
-	// Get FPS Information
-	cout << "Color : " << color.getVideoMode().getFps() << "(fps) | Depth : " << depth.getVideoMode().getFps() << "(fps)" << endl;
-		
-	// Generate output filenames using current date/time
-	char *RGBFileName = (char*)malloc(sizeof(char) * 200);
-	char *DepthFileName = (char*)malloc(sizeof(char) * 200);
-	time_t RawTime;
-	struct tm * CurrentDateTime;
-	char CurrentDateTimeString [100];
-
-	time(&RawTime);
-	CurrentDateTime = localtime(&RawTime);
-	strftime(CurrentDateTimeString, 20, "%Y-%m-%d_%H%M%S", CurrentDateTime);
-	sprintf(RGBFileName, "Output/ImageOutput_%s.dat", CurrentDateTimeString);
-	sprintf(DepthFileName, "Output/DepthOutput_%s.dat", CurrentDateTimeString);
-
-	
-	// Output depth map to file
-	FILE *DepthFile = fopen(DepthFileName, "wb");
-	// Output depth map to file
-	FILE *ImageFile = fopen(RGBFileName, "wb");
-	
-	// Determine the frame limit. If none was specified via command argument, use the default defined above
-	int FrameLimit;	
-	if(argc == 2)
-	{
-		FrameLimit = atoi(argv[1]);
-	}		
-	else
-	{
-		FrameLimit = DEFAULT_FRAME_LIMIT;
-	}
-
-	// Main data capture loop
-	cout << "Capturing " << FrameLimit << " frames of data..." << endl;
-	for(int i = 0; i < FrameLimit; i++)
-	{
-		// Read a Frame from VideoStream
-		color.readFrame( &colorFrame );
-		depth.readFrame( &depthFrame );
-
-		// Copy To Mat
-		openni::RGB888Pixel* colorImgRaw = (openni::RGB888Pixel*)colorFrame.getData();
-		for ( int i = 0 ; i < ( colorFrame.getDataSize() / sizeof( openni::RGB888Pixel ) ) ; i++ )
-		{
-			int idx = i * 3; // cv::Mat is BGR
-			unsigned char* data = &cImg.data[idx];
-			data[0] = (unsigned char)colorImgRaw[i].b;
-			data[1] = (unsigned char)colorImgRaw[i].g;
-			data[2] = (unsigned char)colorImgRaw[i].r;
-		}
-
-		fwrite(colorImgRaw, 3, cImgWidth * cImgHeight, ImageFile);
-		
-		openni::DepthPixel* depthImgRaw = (openni::DepthPixel*)depthFrame.getData();
-		int lb, ub;
-		for ( int i = 0 ; i < ( depthFrame.getDataSize() / sizeof( openni::DepthPixel ) ) ; i++ )
-		{
-			int idx = i * 3; // Grayscale
-			unsigned char* data = &dImg.data[idx];
-			
-			lb = (depthImgRaw[i]/5) % 256;
-			ub = depthImgRaw[i]/5 / 256;
-
-			switch (ub) {
-				case 0:
-					data[2] = 255;
-					data[1] = 255-lb;
-					data[0] = 255-lb;
-					break;
-				case 1:
-					data[2] = 255;
-					data[1] = lb;
-					data[0] = 0;
-					break;
-				case 2:
-					data[2] = 255-lb;
-					data[1] = 255;
-					data[0] = 0;
-					break;
-				case 3:
-					data[2] = 0;
-					data[1] = 255;
-					data[0] = lb;
-					break;
-				case 4:
-					data[2] = 0;
-					data[1] = 255-lb;
-					data[0] = 255;
-					break;
-				case 5:
-					data[2] = 0;
-					data[1] = 0;
-					data[0] = 255-lb;
-					break;
-				default:
-					data[2] = 0;
-					data[1] = 0;
-					data[0] = 0;
-					break;
-			}
-
-			/*
-			int gray_scale = ( ( depthImgRaw[i] * 255 ) / ( maxDepthValue - minDepthValue ) );
-			data[0] = (unsigned char)~gray_scale;
-			data[1] = (unsigned char)~gray_scale;
-			data[2] = (unsigned char)~gray_scale;
-			*/
-		}
-		
-		fwrite(depthImgRaw, sizeof(openni::DepthPixel), cImgWidth * cImgHeight, DepthFile);
-
-		// Show Images
-		//cv::imshow( "depth", dImg );
-		//cv::imshow( "color", cImg );
-
-		FILE *pcl = fopen("data.pcl", "wb");
-		int numPoints  = cImgWidth * cImgHeight;
-		fwrite(&numPoints, sizeof(int), 1, pcl);
-		fwrite(&cImgWidth, sizeof(int), 1, pcl);
-		fwrite(&cImgHeight, sizeof(int), 1, pcl);
-		/*
-		float *worldPoints;
-		worldPoints = (float*) malloc(3*dImgWidth*dImgHeight*sizeof(float));
-		
-		for (int v = 0; v < cImgHeight; v++) {
-			for (int u = 0; u < cImgWidth; u++) {
-				int x, y;
-			
-				openni::CoordinateConverter::convertDepthToWorld(depth,u,v,depthImgRaw[v*dImgWidth+u], &worldPoints[v*dImgWidth+u+0], &worldPoints[v*dImgWidth+u+1], &worldPoints[v*dImgWidth+u+2]);
-				openni::CoordinateConverter::convertDepthToColor(depth, color,u,v,depthImgRaw[v*dImgWidth+u],&x,&y);
-				fwrite(&worldPoints[v*dImgWidth+u], sizeof(float), 3, pcl);
-				fwrite(&colorImgRaw[y*dImgWidth+x], sizeof(char), 3, pcl);
-				//fwrite(colorImgRaw, 3, cImgWidth * cImgHeight, pcl);
-	
-			}
-		}
-		
-		fclose(pcl);
-		*/
-
-	}
-
-	cout << "All finished, closing streams and exiting gracefully" << endl;
-
-	// Close File streams
-	fclose(ImageFile);
-	fclose(DepthFile);
-
-	// Destroy Streams
-	color.destroy();
-	depth.destroy();
-	// Close Device
-	device.close();
-	// Shutdown OpenNI
-	openni::OpenNI::shutdown();
-
-	// Return
-	return EXIT_SUCCESS;
-}
+// Header Includes
+#include <opencv2/opencv.hpp>
+#include <OpenNI.h>
+#include <iostream>
+#include <curses.h>
+#include <math.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Backpressure.h"
+#include "DeviceClock.h"
+#include "EventTrigger.h"
+#include "FrameBus.h"
+#include "FrameCopy.h"
+#include "FrameEncoder.h"
+#include "FramePairer.h"
+#include "FrameRing.h"
+#include "LatencyStats.h"
+#include "PointCloudWriter.h"
+#include "Preview.h"
+#include "RecordingWriter.h"
+#include "ThreadTuning.h"
+#include "VideoModes.h"
+
+// Stream resolution unless --color-mode / --depth-mode choose another
+#define DEFAULT_RES_X 640
+#define DEFAULT_RES_Y 480
+
+#define DEFAULT_FRAME_LIMIT 9000
+
+// Number of frames per stream that can be queued between the capture and writer threads
+#define DEFAULT_RING_CAPACITY 32
+
+// Color and depth frames further apart than this (in microseconds) are never paired
+#define DEFAULT_PAIR_TOLERANCE_US 16000
+// Frames of one stream held back while waiting for a partner from the other
+#define DEFAULT_PAIR_MAX_PENDING 8
+
+// Threads compressing depth frames when --compress-depth is given
+#define DEFAULT_DEPTH_ENCODER_THREADS 2
+// Threads and quality for --color-codec jpeg|png
+#define DEFAULT_COLOR_ENCODER_THREADS 3
+#define DEFAULT_JPEG_QUALITY 90
+#define DEFAULT_PNG_LEVEL 1
+// Threads converting frame pairs to point clouds when --point-cloud is given
+#define DEFAULT_POINT_CLOUD_THREADS 2
+
+// Longest the capture thread blocks waiting for a frame, so it notices an unplugged device
+#define FRAME_WAIT_TIMEOUT_MS 200
+// How often to look for an unplugged device again if no connection event brings it back
+#define RECONNECT_RETRY_MS 1000
+// Seconds to wait for an unplugged device before finishing its recording, 0 to wait forever
+#define DEFAULT_RECONNECT_TIMEOUT_S 600
+
+// Real-time priority of the capture path when --rt is given without --rt-priority
+#define DEFAULT_RT_PRIORITY 50
+
+// Event-triggered recording (--pre-trigger): seconds kept recording after the last trigger, how far
+// (in millimetres) and in what percentage of the watched pixels depth must move to fire the trigger,
+// and the socket external triggers arrive on
+#define DEFAULT_POST_TRIGGER_S 2.0
+#define DEFAULT_TRIGGER_THRESHOLD_MM 50
+#define DEFAULT_TRIGGER_PERCENT 1.0
+#define DEFAULT_TRIGGER_SOCKET "/tmp/CaptureImageDepthData.trigger"
+
+// Frames of each stream kept on the --frame-bus for readers to catch up on
+#define DEFAULT_FRAME_BUS_SLOTS 8
+
+// Frames kept under --backpressure decimate when no N is given: one in this many
+#define DEFAULT_SHED_DECIMATION 2
+
+// Namespaces
+using namespace std;
+
+// How frames are pulled from the sensor
+enum CaptureMode
+{
+	CAPTURE_MODE_POLL,	// A capture thread blocks on readFrame() for color, then depth
+	CAPTURE_MODE_EVENT	// Each stream's NewFrameListener queues frames as the driver delivers them
+};
+
+// What starts an event-triggered recording
+enum TriggerSource
+{
+	TRIGGER_SOURCE_DEPTH = 1,	// Depth changing in the watched region
+	TRIGGER_SOURCE_SOCKET = 2,	// A datagram on the trigger socket
+	TRIGGER_SOURCE_ANY = 3
+};
+
+// Command line options
+struct CaptureOptions
+{
+	int frameLimit;
+	CaptureMode mode;
+	FramePairer::MatchKey pairKey;
+	long long pairTolerance;
+	// Also write the old headerless ImageOutput/DepthOutput .dat files
+	bool legacyDat;
+	// Losslessly compress depth in the recording, on depthEncoderThreads worker threads
+	bool compressDepth;
+	int depthEncoderThreads;
+	// Store color as RECORDING_ENCODING_JPEG or _PNG, encoded on colorEncoderThreads worker threads
+	RecordingEncoding colorEncoding;
+	int colorQuality;
+	int colorEncoderThreads;
+	// Show every previewEvery'th frame pair in a window; no display work at all when false
+	bool preview;
+	int previewEvery;
+	// Depth display colormap and its scale in millimetres per colormap step
+	DepthColormap colormap;
+	int colormapScale;
+	// Stream colored point clouds to a .pcl file on pointCloudThreads worker threads, with or without zero-depth points
+	bool pointCloud;
+	bool pointCloudDense;
+	int pointCloudThreads;
+	// Devices to capture from at once: the given URIs, every enumerated device, or else openni::ANY_DEVICE
+	std::vector<std::string> deviceUris;
+	bool allDevices;
+	// Seconds an unplugged device is waited for before its recording is finished, 0 for no limit
+	int reconnectTimeout;
+	// Stream modes to select from each sensor's supported modes; --list-modes only prints those
+	VideoModeRequest colorMode;
+	VideoModeRequest depthMode;
+	bool listModes;
+	// CPUs and scheduling for the threads reading the sensor, writing files and encoding frames
+	ThreadTuning captureTuning;
+	ThreadTuning writerTuning;
+	ThreadTuning workerTuning;
+	// mlockall() the process so the capture path never waits on a page fault
+	bool lockMemory;
+	// What to shed, and for SHED_POLICY_DECIMATE how much, while the writer falls behind
+	ShedPolicy shedPolicy;
+	int shedDecimation;
+	// Frame pairs between fdatasync()s of the recording, 0 to leave flushing to the OS
+	int syncEvery;
+	// CSV file to dump every stage's timing histogram to at exit, empty for none
+	std::string statsFile;
+	// Write recordings with O_DIRECT from aligned buffers, submitted asynchronously, instead of stdio
+	bool directIo;
+	// Start a new recording segment after this many frame pairs or bytes, 0 for no limit
+	int segmentFrames;
+	uint64_t segmentBytes;
+	// Only record around events: keep preTrigger seconds of frame pairs in memory, and once a trigger
+	// fires write them out and keep recording until postTrigger seconds after the last trigger.
+	// Event-triggered recording is off while preTrigger is 0.
+	double preTrigger;
+	double postTrigger;
+	TriggerSource triggerSource;
+	// Depth change detector: region watched, change in millimetres, and fraction of the region's pixels
+	TriggerRegion triggerRegion;
+	int triggerThreshold;
+	double triggerFraction;
+	std::string triggerSocket;
+	// Shared memory name to publish every captured frame under for other local processes, empty
+	// for none, and how many frames of each stream it holds
+	std::string frameBus;
+	int frameBusSlots;
+};
+
+// One captured frame. The frame reference keeps the driver buffer alive
+// until the writer thread has finished with it and releases the slot.
+struct StreamSlot
+{
+	openni::VideoFrameRef frame;
+	int frameNumber;
+};
+
+// Event-triggered recording state. Frame pairs are copied into the history, so their driver buffers
+// go straight back to the driver, and wait there until a trigger fires; then they are written out and
+// recording goes on until postTrigger after the last trigger. Only the writer thread touches it,
+// except for the atomics the main thread uses.
+struct TriggeredRecording
+{
+	TriggeredRecording() : preTriggerPairs(0), postTrigger(0), useDepth(false), historyFirst(0), historyCount(0), lastTrigger(0), pairsRecorded(0), pairsDiscarded(0)
+	{
+		externalTriggers.store(0);
+		active.store(false);
+		events.store(0);
+	}
+
+	// Pairs kept from before a trigger, and device microseconds kept recording after one
+	size_t preTriggerPairs;
+	uint64_t postTrigger;
+	// Fires on depth changing in the watched region, when useDepth is set
+	DepthChangeDetector detector;
+	bool useDepth;
+	// Triggers from the socket, added by the main thread and taken by the writer
+	std::atomic<unsigned int> externalTriggers;
+	// Copies of the color/depth pairs from before the trigger: a ring of preTriggerPairs pairs,
+	// allocated up front, holding historyCount pairs from historyFirst on, oldest first
+	std::vector< std::pair<FrameCopy, FrameCopy> > history;
+	size_t historyFirst;
+	size_t historyCount;
+	// Recording an event, since the depth timestamp of its last trigger
+	std::atomic<bool> active;
+	uint64_t lastTrigger;
+	std::atomic<unsigned int> events;
+	unsigned int pairsRecorded;
+	unsigned int pairsDiscarded;
+};
+
+// State shared by the capture and writer threads
+struct CaptureSession
+{
+	openni::VideoStream* color;
+	openni::VideoStream* depth;
+	FrameRing<StreamSlot>* colorRing;
+	FrameRing<StreamSlot>* depthRing;
+	int frameLimit;
+	FramePairer* pairer;
+	// Maps the device's frame timestamps onto the host clock shared by every device
+	DeviceClock* clock;
+
+	// Streams still being captured; the writer stops once this is zero and the rings are empty
+	std::atomic<int> streamsRemaining;
+	// Device hotplug handshake with the main thread. While connected is false the capture thread
+	// parks and sets parked; gapRequested asks the writer to finish everything captured before the
+	// break; stop tells a parked capture thread to give up. writerDone is set once the writer has
+	// finished, after which nobody will answer gapRequested.
+	std::atomic<bool> connected;
+	std::atomic<bool> parked;
+	std::atomic<bool> gapRequested;
+	std::atomic<bool> stop;
+	std::atomic<bool> writerDone;
+	// Color/depth pairs the writer has finished with
+	std::atomic<int> framesWritten;
+
+	// Applied by the capture thread (or listeners) and the writer thread to themselves
+	const ThreadTuning* captureTuning;
+	const ThreadTuning* writerTuning;
+	// Time from each frame's host timestamp until the capture side read it, per stream, and
+	// until the writer took it off its ring
+	LatencyHistogram captureLatency[RECORDING_MAX_STREAMS];
+	LatencyHistogram writerLatency;
+	// Time from each frame's host timestamp until it was on the frame bus, per stream
+	LatencyHistogram busLatency[RECORDING_MAX_STREAMS];
+	// Time spent in each stage of the capture path: reading a frame from the driver, looking for
+	// depth changes to trigger on, copying a pair into the pre-trigger history, publishing a frame to
+	// the frame bus, writing a frame or handing it to its encoder, and syncing the recording every
+	// syncEvery frame pairs. The preview times its own stages on its display thread.
+	LatencyHistogram readTime[RECORDING_MAX_STREAMS];
+	LatencyHistogram detectTime;
+	LatencyHistogram historyTime;
+	LatencyHistogram publishTime[RECORDING_MAX_STREAMS];
+	LatencyHistogram writeTime[RECORDING_MAX_STREAMS];
+	LatencyHistogram syncTime;
+	int syncEvery;
+	// Frames the driver skipped, from jumps in each stream's frame index
+	FrameIndexGaps indexGaps[RECORDING_MAX_STREAMS];
+	// Recording segments: where their names start, the limits that end one, the one being
+	// written and how many frame pairs it has
+	std::string segmentBase;
+	int segmentFrames;
+	uint64_t segmentBytes;
+	int segment;
+	int segmentPairs;
+	// Set once a segment couldn't be started; no more frames go to the recording after that
+	bool recordingFailed;
+	// Frames written raw that the recording failed to write, per stream; the encoders count their own
+	uint64_t writeFailures[RECORDING_MAX_STREAMS];
+	// Event-triggered recording, NULL when every frame pair is recorded
+	TriggeredRecording* trigger;
+	// Shared memory every frame is published to by the capture thread (or listeners) as it is read,
+	// before any shedding, NULL unless requested
+	FrameBusWriter* frameBus;
+
+	Preview* preview;
+
+	RecordingWriter* recording;
+	// Compress each stream for the recording, NULL when it is stored raw
+	StreamEncoder* colorEncoder;
+	StreamEncoder* depthEncoder;
+	// Point cloud output, NULL unless requested
+	PointCloudWriter* pointCloud;
+	// Load shedding policy, and whether each encoder is only used while the writer lags
+	Backpressure* backpressure;
+	bool colorEncodeUnderLoad;
+	bool depthEncodeUnderLoad;
+	// Legacy split outputs, NULL unless requested
+	FILE* ImageFile;
+	FILE* DepthFile;
+};
+
+// Applies a thread tuning to the calling thread, warning if the system doesn't allow it
+void TuneThread(const ThreadTuning& tuning, const char* name)
+{
+	if(!ApplyThreadTuning(pthread_self(), tuning))
+	{
+		cerr << "Can't set CPUs / scheduling for the " << name << " thread : " << strerror(errno) << endl;
+	}
+}
+
+// Microseconds between a frame's time on the host clock and now. As the clock mapping uses the
+// fastest delivery seen, this is the delay beyond the best case, mostly from scheduling.
+uint64_t HandlingLatency(const DeviceClock& clock, uint64_t timestamp)
+{
+	uint64_t now = HostClockMicroseconds();
+	uint64_t host = clock.toHost(timestamp);
+	return (host != 0 && host < now) ? now - host : 0;
+}
+
+// True while the writer is falling behind, judged by the fuller of the two rings
+bool WriterLagging(CaptureSession* session)
+{
+	unsigned int colorOccupancy = session->colorRing->occupancy();
+	unsigned int depthOccupancy = session->depthRing->occupancy();
+	return session->backpressure->update(colorOccupancy > depthOccupancy ? colorOccupancy : depthOccupancy, session->colorRing->capacity());
+}
+
+// Copies a frame onto the frame bus straight from its driver buffer, for other processes to read
+// in place, and times it and its latency from capture. Frames the bus has no room for, which the
+// fixed stream modes rule out, are left off.
+void PublishFrame(CaptureSession* session, RecordingStream stream, const openni::VideoFrameRef& frame)
+{
+	FrameBusFrame published;
+	published.stream = stream;
+	published.timestamp = frame.getTimestamp();
+	published.hostTimestamp = session->clock->toHost(frame.getTimestamp());
+	published.frameIndex = frame.getFrameIndex();
+	published.width = frame.getWidth();
+	published.height = frame.getHeight();
+	published.strideInBytes = frame.getStrideInBytes();
+	published.dataSize = frame.getDataSize();
+	published.data = frame.getData();
+	uint64_t start = HostClockMicroseconds();
+	session->frameBus->publish(published);
+	session->publishTime[stream].add(HostClockMicroseconds() - start);
+	session->busLatency[stream].add(HandlingLatency(*session->clock, frame.getTimestamp()));
+}
+
+// Queues one frame from a stream into its ring. When the ring is full the frame is still
+// read, so the driver keeps moving, but it is shed (the ring counts the overrun); while the
+// writer lags, the backpressure policy may shed it first. Every frame read, kept or not,
+// refines the device's mapping onto the host clock and is published on the frame bus, if there is
+// one, so readers see every frame whatever the disk is doing. A frame the driver failed to hand
+// over is let go of before anything looks at it.
+bool QueueFrame(CaptureSession* session, RecordingStream which, openni::VideoStream& stream, openni::VideoFrameRef& discard, int frameNumber)
+{
+	FrameRing<StreamSlot>& ring = (which == RECORDING_STREAM_COLOR) ? *session->colorRing : *session->depthRing;
+	StreamSlot* slot = ring.beginPush();
+	openni::VideoFrameRef& frame = (slot != NULL) ? slot->frame : discard;
+	uint64_t start = HostClockMicroseconds();
+	openni::Status status = stream.readFrame( &frame );
+	session->readTime[which].add(HostClockMicroseconds() - start);
+	if(status != openni::STATUS_OK)
+	{
+		// Leave the slot unpublished for the next frame
+		frame.release();
+		return false;
+	}
+	session->clock->observe(frame.getTimestamp());
+	session->captureLatency[which].add(HandlingLatency(*session->clock, frame.getTimestamp()));
+	session->indexGaps[which].observe(frame.getFrameIndex());
+	if(session->frameBus != NULL)
+	{
+		PublishFrame(session, which, frame);
+	}
+	if(slot == NULL)
+	{
+		return false;
+	}
+	if(!session->backpressure->keep(which, frame.getFrameIndex(), WriterLagging(session)))
+	{
+		// Leave the slot unpublished for the next frame
+		frame.release();
+		return false;
+	}
+
+	slot->frameNumber = frameNumber;
+	ring.commitPush();
+	return true;
+}
+
+// Waits for a frame on one stream, but never longer than FRAME_WAIT_TIMEOUT_MS, so a stream
+// whose device has gone away can't block the caller. Returns false on timeout.
+bool WaitForFrame(openni::VideoStream& stream)
+{
+	openni::VideoStream* streams[] = { &stream };
+	int ready;
+	return openni::OpenNI::waitForAnyStream(streams, 1, &ready, FRAME_WAIT_TIMEOUT_MS) == openni::STATUS_OK;
+}
+
+// Capture thread for CAPTURE_MODE_POLL: reads color and depth from the sensor as fast as it
+// delivers them. Never touches the disk, so write stalls can't back up the USB reader.
+// While the device is unplugged it parks until the main thread has reopened the streams.
+void CaptureThread(CaptureSession* session)
+{
+	TuneThread(*session->captureTuning, "capture");
+
+	// Scratch references used to keep draining the driver when a ring is full
+	openni::VideoFrameRef discardColor;
+	openni::VideoFrameRef discardDepth;
+
+	int colorFrames = 0;
+	int depthFrames = 0;
+	while(colorFrames < session->frameLimit || depthFrames < session->frameLimit)
+	{
+		if(!session->connected.load(std::memory_order_acquire))
+		{
+			if(session->stop.load(std::memory_order_acquire))
+			{
+				break;
+			}
+			// Let go of the old streams' buffers before they are destroyed
+			discardColor.release();
+			discardDepth.release();
+			session->parked.store(true, std::memory_order_release);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+
+		if(colorFrames < session->frameLimit && WaitForFrame(*session->color))
+		{
+			QueueFrame(session, RECORDING_STREAM_COLOR, *session->color, discardColor, colorFrames++);
+		}
+		if(depthFrames < session->frameLimit && WaitForFrame(*session->depth))
+		{
+			QueueFrame(session, RECORDING_STREAM_DEPTH, *session->depth, discardDepth, depthFrames++);
+		}
+	}
+
+	session->streamsRemaining.fetch_sub(2, std::memory_order_release);
+}
+
+// Listener for CAPTURE_MODE_EVENT, in the style of the EventBasedRead sample. Runs on the
+// driver's callback thread, so it only moves the frame reference into the ring and returns.
+// The capture thread tuning is applied to that driver thread on its first frame.
+class RingFrameListener : public openni::VideoStream::NewFrameListener
+{
+public:
+	RingFrameListener(CaptureSession* session, RecordingStream stream) : m_session(session), m_stream(stream), m_framesRead(0), m_tuned(false)
+	{
+	}
+
+	void onNewFrame(openni::VideoStream& stream)
+	{
+		int framesRead = m_framesRead.load(std::memory_order_relaxed);
+		if(framesRead >= m_session->frameLimit)
+		{
+			return;
+		}
+		if(!m_tuned)
+		{
+			TuneThread(*m_session->captureTuning, "driver callback");
+			m_tuned = true;
+		}
+
+		QueueFrame(m_session, m_stream, stream, m_discard, framesRead);
+		m_framesRead.store(++framesRead, std::memory_order_relaxed);
+		if(framesRead == m_session->frameLimit)
+		{
+			m_session->streamsRemaining.fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+	// Lets go of the scratch frame once the listener has been removed from its stream
+	void release()
+	{
+		m_discard.release();
+	}
+
+	// True once the listener has queued its whole share of frames
+	bool finished() const
+	{
+		return m_framesRead.load(std::memory_order_relaxed) >= m_session->frameLimit;
+	}
+
+private:
+	CaptureSession* m_session;
+	RecordingStream m_stream;
+	openni::VideoFrameRef m_discard;
+	// Written by the driver thread, read by the main thread through finished()
+	std::atomic<int> m_framesRead;
+	bool m_tuned;
+};
+
+// Passes a frame to the stream's encoder, or writes it raw. An encoder kept for load shedding is
+// only used while the writer lags, and is drained before the next raw frame to keep frames in order.
+template<typename Frame>
+void WriteRecordingFrame(CaptureSession* session, RecordingStream stream, StreamEncoder* encoder, bool encodeUnderLoad, Frame& frame, bool lagging)
+{
+	if(session->recordingFailed)
+	{
+		return;
+	}
+	if(encoder != NULL && (!encodeUnderLoad || session->backpressure->compress(stream, lagging)))
+	{
+		encoder->submit(frame);
+		return;
+	}
+	if(encoder != NULL)
+	{
+		encoder->drain(true);
+	}
+	if(!session->recording->writeFrame(stream, frame) && session->writeFailures[stream]++ == 0)
+	{
+		cerr << "Error writing " << (stream == RECORDING_STREAM_COLOR ? "color" : "depth") << " frame to " << session->recording->fileName() << " : " << strerror(errno) << endl;
+	}
+}
+
+// Writes a color frame to the recording and the legacy image file
+template<typename Frame>
+void WriteColorFrame(CaptureSession* session, Frame& colorFrame, bool lagging)
+{
+	WriteRecordingFrame(session, RECORDING_STREAM_COLOR, session->colorEncoder, session->colorEncodeUnderLoad, colorFrame, lagging);
+	if(session->ImageFile != NULL)
+	{
+		fwrite(colorFrame.getData(), 3, colorFrame.getWidth() * colorFrame.getHeight(), session->ImageFile);
+	}
+}
+
+// Writes a depth frame to the recording and the legacy depth file
+template<typename Frame>
+void WriteDepthFrame(CaptureSession* session, Frame& depthFrame, bool lagging)
+{
+	openni::DepthPixel* depthImgRaw = (openni::DepthPixel*)depthFrame.getData();
+
+	WriteRecordingFrame(session, RECORDING_STREAM_DEPTH, session->depthEncoder, session->depthEncodeUnderLoad, depthFrame, lagging);
+	if(session->DepthFile != NULL)
+	{
+		fwrite(depthImgRaw, sizeof(openni::DepthPixel), depthFrame.getWidth() * depthFrame.getHeight(), session->DepthFile);
+	}
+}
+
+// Name of a recording segment: the base name and the segment number, or only the base name when
+// the recording isn't split
+std::string SegmentFileName(const std::string& base, int segment, bool segmented)
+{
+	char number[16] = "";
+	if(segmented)
+	{
+		snprintf(number, sizeof(number), "_%04d", segment);
+	}
+	return base + number + ".rgbd";
+}
+
+// Called before each frame pair is written: ends the recording segment if it has reached its frame
+// or size limit and starts the next, so no segment is left empty. Frames still being encoded are
+// written first, so every segment holds whole frame pairs.
+void RotateRecording(CaptureSession* session)
+{
+	if(session->recordingFailed)
+	{
+		return;
+	}
+	if(!(session->segmentFrames > 0 && session->segmentPairs >= session->segmentFrames) &&
+		!(session->segmentBytes > 0 && session->recording->bytesWritten() >= session->segmentBytes))
+	{
+		return;
+	}
+
+	if(session->colorEncoder != NULL)
+	{
+		session->colorEncoder->drain(true);
+	}
+	if(session->depthEncoder != NULL)
+	{
+		session->depthEncoder->drain(true);
+	}
+	std::string finished = session->recording->fileName();
+	session->segment++;
+	session->segmentPairs = 0;
+	if(!session->recording->rotate(SegmentFileName(session->segmentBase, session->segment, true).c_str()))
+	{
+		cerr << "Error finishing " << finished << " or starting " << session->recording->fileName() << " : " << strerror(errno) << endl;
+	}
+	if(!session->recording->isOpen())
+	{
+		cerr << "No recording segment open, no longer recording frames" << endl;
+		session->recordingFailed = true;
+	}
+}
+
+// Writes a depth frame whose color was shed under --backpressure drop-color to the recording only,
+// as the legacy files and point clouds need both frames of a pair, then lets go of it
+template<typename Frame>
+void WriteDepthAlone(CaptureSession* session, Frame& depthFrame)
+{
+	RotateRecording(session);
+	bool lagging = WriterLagging(session);
+	uint64_t start = HostClockMicroseconds();
+	WriteRecordingFrame(session, RECORDING_STREAM_DEPTH, session->depthEncoder, session->depthEncodeUnderLoad, depthFrame, lagging);
+	session->writeTime[RECORDING_STREAM_DEPTH].add(HostClockMicroseconds() - start);
+	depthFrame.release();
+}
+
+// Writes one matched frame pair to the recording, the legacy files and the point cloud writer,
+// then lets go of the frames. A pair without color is a depth frame written alone. The frames are
+// driver frames, or FrameCopy from the pre-trigger history.
+template<typename Frame>
+void WritePair(CaptureSession* session, Frame& colorFrame, Frame& depthFrame)
+{
+	if(!colorFrame.isValid())
+	{
+		WriteDepthAlone(session, depthFrame);
+		return;
+	}
+	RotateRecording(session);
+	session->segmentPairs++;
+	bool lagging = WriterLagging(session);
+	uint64_t start = HostClockMicroseconds();
+	WriteColorFrame(session, colorFrame, lagging);
+	uint64_t colorWritten = HostClockMicroseconds();
+	WriteDepthFrame(session, depthFrame, lagging);
+	session->writeTime[RECORDING_STREAM_COLOR].add(colorWritten - start);
+	session->writeTime[RECORDING_STREAM_DEPTH].add(HostClockMicroseconds() - colorWritten);
+	if(session->pointCloud != NULL)
+	{
+		session->pointCloud->submit(colorFrame, depthFrame);
+	}
+	// Hand the driver buffers back as soon as they are on disk
+	colorFrame.release();
+	depthFrame.release();
+	int written = session->framesWritten.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	if(session->syncEvery > 0 && written % session->syncEvery == 0 && !session->recordingFailed)
+	{
+		start = HostClockMicroseconds();
+		if(!session->recording->sync())
+		{
+			cerr << "Can't sync the recording to disk, no longer trying : " << strerror(errno) << endl;
+			session->syncEvery = 0;
+		}
+		session->syncTime.add(HostClockMicroseconds() - start);
+	}
+}
+
+// Event-triggered recording of one frame pair. While no event is being recorded the pair joins the
+// pre-trigger history, pushing out the oldest. A trigger writes out the history and starts recording
+// until postTrigger after the last trigger; each event after the first is flagged as a gap.
+void ProcessTriggeredPair(CaptureSession* session, openni::VideoFrameRef& colorFrame, openni::VideoFrameRef& depthFrame)
+{
+	TriggeredRecording& trigger = *session->trigger;
+	bool fired = trigger.externalTriggers.exchange(0, std::memory_order_acquire) > 0;
+	if(trigger.useDepth)
+	{
+		// Every depth frame is folded into the background, straight from the driver buffer
+		const uint16_t* depth = (const uint16_t*)depthFrame.getData();
+		uint64_t start = HostClockMicroseconds();
+		fired = trigger.detector.update(depth, depthFrame.getWidth(), depthFrame.getHeight(), depthFrame.getStrideInBytes()) || fired;
+		session->detectTime.add(HostClockMicroseconds() - start);
+	}
+
+	uint64_t timestamp = depthFrame.getTimestamp();
+	if(fired)
+	{
+		if(!trigger.active.load(std::memory_order_relaxed))
+		{
+			if(trigger.events.load(std::memory_order_relaxed) > 0)
+			{
+				if(session->colorEncoder != NULL)
+				{
+					session->colorEncoder->drain(true);
+				}
+				if(session->depthEncoder != NULL)
+				{
+					session->depthEncoder->drain(true);
+				}
+				session->recording->markGap();
+			}
+			trigger.events.fetch_add(1, std::memory_order_relaxed);
+			trigger.active.store(true, std::memory_order_relaxed);
+			while(trigger.historyCount > 0)
+			{
+				std::pair<FrameCopy, FrameCopy>& pair = trigger.history[trigger.historyFirst];
+				WritePair(session, pair.first, pair.second);
+				trigger.historyFirst = (trigger.historyFirst + 1) % trigger.history.size();
+				trigger.historyCount--;
+				trigger.pairsRecorded++;
+			}
+		}
+		trigger.lastTrigger = timestamp;
+	}
+
+	if(trigger.active.load(std::memory_order_relaxed))
+	{
+		WritePair(session, colorFrame, depthFrame);
+		trigger.pairsRecorded++;
+		// Timestamps start again from zero after a device reset; count from there
+		if(timestamp < trigger.lastTrigger)
+		{
+			trigger.lastTrigger = timestamp;
+		}
+		if(timestamp - trigger.lastTrigger >= trigger.postTrigger)
+		{
+			trigger.active.store(false, std::memory_order_relaxed);
+		}
+		return;
+	}
+
+	// Copy the pair over the oldest one once the history is full, and hand the driver buffers back
+	if(trigger.historyCount == trigger.history.size())
+	{
+		trigger.historyFirst = (trigger.historyFirst + 1) % trigger.history.size();
+		trigger.historyCount--;
+		trigger.pairsDiscarded++;
+	}
+	std::pair<FrameCopy, FrameCopy>& pair = trigger.history[(trigger.historyFirst + trigger.historyCount) % trigger.history.size()];
+	uint64_t start = HostClockMicroseconds();
+	pair.first.assign(colorFrame);
+	pair.second.assign(depthFrame);
+	session->historyTime.add(HostClockMicroseconds() - start);
+	trigger.historyCount++;
+	colorFrame.release();
+	depthFrame.release();
+}
+
+// Shows, triggers on or writes a pair from the pairer. pairsSeen counts pairs with color for the
+// preview to pick every previewEvery'th of.
+void HandlePair(CaptureSession* session, openni::VideoFrameRef& colorFrame, openni::VideoFrameRef& depthFrame, int& pairsSeen)
+{
+	// Show Images
+	if(colorFrame.isValid() && session->preview->due(pairsSeen++))
+	{
+		session->preview->show(colorFrame, depthFrame);
+	}
+
+	if(session->trigger != NULL)
+	{
+		ProcessTriggeredPair(session, colorFrame, depthFrame);
+	}
+	else
+	{
+		WritePair(session, colorFrame, depthFrame);
+	}
+}
+
+// Writer thread: drains both rings independently, so one stream arriving late never holds up the other,
+// and writes out only the color/depth pairs the pairer has matched so the two output files stay aligned.
+// Under --backpressure drop-color, depth whose color was shed is written to the recording alone.
+void WriterThread(CaptureSession* session)
+{
+	TuneThread(*session->writerTuning, "writer");
+	FramePairer& pairer = *session->pairer;
+	openni::VideoFrameRef colorFrame;
+	openni::VideoFrameRef depthFrame;
+	int pairsSeen = 0;
+
+	while(true)
+	{
+		bool idle = true;
+
+		StreamSlot* slot = session->colorRing->front();
+		if(slot != NULL)
+		{
+			session->writerLatency.add(HandlingLatency(*session->clock, slot->frame.getTimestamp()));
+			pairer.addColor(slot->frame);
+			slot->frame.release();
+			session->colorRing->pop();
+			idle = false;
+		}
+
+		slot = session->depthRing->front();
+		if(slot != NULL)
+		{
+			session->writerLatency.add(HandlingLatency(*session->clock, slot->frame.getTimestamp()));
+			pairer.addDepth(slot->frame);
+			slot->frame.release();
+			session->depthRing->pop();
+			idle = false;
+		}
+
+		while(pairer.nextPair(colorFrame, depthFrame))
+		{
+			HandlePair(session, colorFrame, depthFrame, pairsSeen);
+		}
+		// Write out whatever the encoder pools have finished
+		if(session->colorEncoder != NULL)
+		{
+			session->colorEncoder->drain(false);
+		}
+		if(session->depthEncoder != NULL)
+		{
+			session->depthEncoder->drain(false);
+		}
+		if(session->pointCloud != NULL)
+		{
+			session->pointCloud->drain(false);
+		}
+
+		if(idle && session->gapRequested.load(std::memory_order_acquire))
+		{
+			// Capture has paused for a device reconnect and the rings are empty: write out everything
+			// from before the break, so only frames captured after it carry the gap marker
+			pairer.flush();
+			while(pairer.nextPair(colorFrame, depthFrame))
+			{
+				HandlePair(session, colorFrame, depthFrame, pairsSeen);
+			}
+			if(session->colorEncoder != NULL)
+			{
+				session->colorEncoder->drain(true);
+			}
+			if(session->depthEncoder != NULL)
+			{
+				session->depthEncoder->drain(true);
+			}
+			if(session->pointCloud != NULL)
+			{
+				session->pointCloud->drain(true);
+			}
+			session->recording->markGap();
+			session->gapRequested.store(false, std::memory_order_release);
+		}
+		else if(idle)
+		{
+			// Rings are empty: we're finished once capture is, otherwise wait for the next frame
+			if(session->streamsRemaining.load(std::memory_order_acquire) == 0 && session->colorRing->front() == NULL && session->depthRing->front() == NULL)
+			{
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	// Whatever is still unmatched will never find a partner, bar depth kept while color is shed, and
+	// history no trigger came for is dropped
+	pairer.flush();
+	while(pairer.nextPair(colorFrame, depthFrame))
+	{
+		HandlePair(session, colorFrame, depthFrame, pairsSeen);
+	}
+	if(session->trigger != NULL)
+	{
+		session->trigger->pairsDiscarded += session->trigger->historyCount;
+		session->trigger->historyCount = 0;
+	}
+	if(session->colorEncoder != NULL)
+	{
+		session->colorEncoder->drain(true);
+	}
+	if(session->depthEncoder != NULL)
+	{
+		session->depthEncoder->drain(true);
+	}
+	if(session->pointCloud != NULL)
+	{
+		session->pointCloud->drain(true);
+	}
+	session->writerDone.store(true, std::memory_order_release);
+}
+
+// Parses [FrameLimit] [--poll|--event] [--pair-tolerance N] [--pair-by-index] [--legacy-dat] [--compress-depth] [--depth-threads N]
+// [--color-codec jpeg|png] [--color-quality N] [--color-threads N] [--preview] [--preview-every N]
+// [--colormap rainbow|gray] [--colormap-scale N] [--point-cloud] [--point-cloud-dense] [--point-cloud-threads N]
+// [--device URI]... [--all-devices] [--reconnect-timeout S] [--color-mode WxH@FPS:FORMAT] [--depth-mode WxH@FPS:FORMAT]
+// [--list-modes] [--rt fifo|rr] [--rt-priority N] [--capture-cpus LIST] [--writer-cpus LIST] [--worker-cpus LIST] [--mlock]
+// [--backpressure none|drop-color|decimate[:N]|compress] [--sync-every N] [--stats-file PATH] [--direct-io]
+// [--segment-frames N] [--segment-size MB] [--pre-trigger S] [--post-trigger S] [--trigger depth|socket|any]
+// [--trigger-roi X,Y,W,H] [--trigger-threshold MM] [--trigger-fraction PCT] [--trigger-socket PATH]
+// [--frame-bus NAME] [--frame-bus-slots N].
+// Returns false on an unrecognised argument or a mode the recording can't store.
+bool ParseArguments(const int argc, const char* argv[], CaptureOptions& options)
+{
+	options.frameLimit = DEFAULT_FRAME_LIMIT;
+	options.mode = CAPTURE_MODE_POLL;
+	options.pairKey = FramePairer::MATCH_TIMESTAMP;
+	options.pairTolerance = DEFAULT_PAIR_TOLERANCE_US;
+	options.legacyDat = false;
+	options.compressDepth = false;
+	options.depthEncoderThreads = DEFAULT_DEPTH_ENCODER_THREADS;
+	options.colorEncoding = RECORDING_ENCODING_RAW;
+	options.colorQuality = -1;
+	options.colorEncoderThreads = DEFAULT_COLOR_ENCODER_THREADS;
+	options.preview = false;
+	options.previewEvery = 1;
+	options.colormap = DEPTH_COLORMAP_RAINBOW;
+	options.colormapScale = DEFAULT_DEPTH_COLORMAP_SCALE;
+	options.pointCloud = false;
+	options.pointCloudDense = false;
+	options.pointCloudThreads = DEFAULT_POINT_CLOUD_THREADS;
+	options.allDevices = false;
+	options.reconnectTimeout = DEFAULT_RECONNECT_TIMEOUT_S;
+	options.colorMode = VideoModeRequest(DEFAULT_RES_X, DEFAULT_RES_Y);
+	options.depthMode = VideoModeRequest(DEFAULT_RES_X, DEFAULT_RES_Y);
+	options.listModes = false;
+	options.lockMemory = false;
+	options.shedPolicy = SHED_POLICY_NONE;
+	options.shedDecimation = DEFAULT_SHED_DECIMATION;
+	options.syncEvery = 0;
+	options.directIo = false;
+	options.segmentFrames = 0;
+	options.segmentBytes = 0;
+	options.preTrigger = 0;
+	options.postTrigger = DEFAULT_POST_TRIGGER_S;
+	options.triggerSource = TRIGGER_SOURCE_DEPTH;
+	options.triggerThreshold = DEFAULT_TRIGGER_THRESHOLD_MM;
+	options.triggerFraction = DEFAULT_TRIGGER_PERCENT / 100.0;
+	options.triggerSocket = DEFAULT_TRIGGER_SOCKET;
+	options.frameBusSlots = DEFAULT_FRAME_BUS_SLOTS;
+	int rtPriority = DEFAULT_RT_PRIORITY;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--poll") == 0)
+		{
+			options.mode = CAPTURE_MODE_POLL;
+		}
+		else if(strcmp(argv[i], "--event") == 0)
+		{
+			options.mode = CAPTURE_MODE_EVENT;
+		}
+		else if(strcmp(argv[i], "--pair-tolerance") == 0 && i + 1 < argc)
+		{
+			options.pairTolerance = atoll(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--pair-by-index") == 0)
+		{
+			// Frame indices of synchronized streams match exactly
+			options.pairKey = FramePairer::MATCH_FRAME_INDEX;
+			options.pairTolerance = 0;
+		}
+		else if(strcmp(argv[i], "--legacy-dat") == 0)
+		{
+			options.legacyDat = true;
+		}
+		else if(strcmp(argv[i], "--compress-depth") == 0)
+		{
+			options.compressDepth = true;
+		}
+		else if(strcmp(argv[i], "--depth-threads") == 0 && i + 1 < argc)
+		{
+			options.depthEncoderThreads = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--color-codec") == 0 && i + 1 < argc)
+		{
+			i++;
+			if(strcmp(argv[i], "jpeg") == 0)
+			{
+				options.colorEncoding = RECORDING_ENCODING_JPEG;
+			}
+			else if(strcmp(argv[i], "png") == 0)
+			{
+				options.colorEncoding = RECORDING_ENCODING_PNG;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--color-quality") == 0 && i + 1 < argc)
+		{
+			options.colorQuality = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--color-threads") == 0 && i + 1 < argc)
+		{
+			options.colorEncoderThreads = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--preview") == 0)
+		{
+			options.preview = true;
+		}
+		else if(strcmp(argv[i], "--preview-every") == 0 && i + 1 < argc)
+		{
+			options.preview = true;
+			options.previewEvery = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--colormap") == 0 && i + 1 < argc)
+		{
+			i++;
+			if(strcmp(argv[i], "rainbow") == 0)
+			{
+				options.colormap = DEPTH_COLORMAP_RAINBOW;
+			}
+			else if(strcmp(argv[i], "gray") == 0)
+			{
+				options.colormap = DEPTH_COLORMAP_GRAY;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--colormap-scale") == 0 && i + 1 < argc)
+		{
+			options.colormapScale = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--point-cloud") == 0)
+		{
+			options.pointCloud = true;
+		}
+		else if(strcmp(argv[i], "--point-cloud-dense") == 0)
+		{
+			options.pointCloud = true;
+			options.pointCloudDense = true;
+		}
+		else if(strcmp(argv[i], "--point-cloud-threads") == 0 && i + 1 < argc)
+		{
+			options.pointCloudThreads = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+		{
+			options.deviceUris.push_back(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--all-devices") == 0)
+		{
+			options.allDevices = true;
+		}
+		else if(strcmp(argv[i], "--reconnect-timeout") == 0 && i + 1 < argc)
+		{
+			options.reconnectTimeout = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--color-mode") == 0 && i + 1 < argc)
+		{
+			if(!ParseVideoModeRequest(argv[++i], options.colorMode))
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--depth-mode") == 0 && i + 1 < argc)
+		{
+			if(!ParseVideoModeRequest(argv[++i], options.depthMode))
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--list-modes") == 0)
+		{
+			options.listModes = true;
+		}
+		else if(strcmp(argv[i], "--rt") == 0 && i + 1 < argc)
+		{
+			i++;
+			if(strcmp(argv[i], "fifo") == 0)
+			{
+				options.captureTuning.policy = SCHED_FIFO;
+			}
+			else if(strcmp(argv[i], "rr") == 0)
+			{
+				options.captureTuning.policy = SCHED_RR;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--rt-priority") == 0 && i + 1 < argc)
+		{
+			rtPriority = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--capture-cpus") == 0 && i + 1 < argc)
+		{
+			if(!ParseCpuList(argv[++i], options.captureTuning.cpus))
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--writer-cpus") == 0 && i + 1 < argc)
+		{
+			if(!ParseCpuList(argv[++i], options.writerTuning.cpus))
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--worker-cpus") == 0 && i + 1 < argc)
+		{
+			if(!ParseCpuList(argv[++i], options.workerTuning.cpus))
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--mlock") == 0)
+		{
+			options.lockMemory = true;
+		}
+		else if(strcmp(argv[i], "--backpressure") == 0 && i + 1 < argc)
+		{
+			i++;
+			if(strcmp(argv[i], "none") == 0)
+			{
+				options.shedPolicy = SHED_POLICY_NONE;
+			}
+			else if(strcmp(argv[i], "drop-color") == 0)
+			{
+				options.shedPolicy = SHED_POLICY_DROP_COLOR;
+			}
+			else if(strncmp(argv[i], "decimate", 8) == 0 && (argv[i][8] == '\0' || argv[i][8] == ':'))
+			{
+				options.shedPolicy = SHED_POLICY_DECIMATE;
+				options.shedDecimation = (argv[i][8] == ':') ? atoi(argv[i] + 9) : DEFAULT_SHED_DECIMATION;
+				if(options.shedDecimation < 2)
+				{
+					return false;
+				}
+			}
+			else if(strcmp(argv[i], "compress") == 0)
+			{
+				options.shedPolicy = SHED_POLICY_COMPRESS;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--sync-every") == 0 && i + 1 < argc)
+		{
+			options.syncEvery = atoi(argv[++i]);
+			if(options.syncEvery < 0)
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--stats-file") == 0 && i + 1 < argc)
+		{
+			options.statsFile = argv[++i];
+		}
+		else if(strcmp(argv[i], "--direct-io") == 0)
+		{
+			options.directIo = true;
+		}
+		else if(strcmp(argv[i], "--segment-frames") == 0 && i + 1 < argc)
+		{
+			options.segmentFrames = atoi(argv[++i]);
+			if(options.segmentFrames < 0)
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--segment-size") == 0 && i + 1 < argc)
+		{
+			int megabytes = atoi(argv[++i]);
+			if(megabytes < 0)
+			{
+				return false;
+			}
+			options.segmentBytes = (uint64_t)megabytes << 20;
+		}
+		else if(strcmp(argv[i], "--pre-trigger") == 0 && i + 1 < argc)
+		{
+			options.preTrigger = atof(argv[++i]);
+			if(options.preTrigger <= 0)
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--post-trigger") == 0 && i + 1 < argc)
+		{
+			options.postTrigger = atof(argv[++i]);
+			if(options.postTrigger < 0)
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--trigger") == 0 && i + 1 < argc)
+		{
+			i++;
+			if(strcmp(argv[i], "depth") == 0)
+			{
+				options.triggerSource = TRIGGER_SOURCE_DEPTH;
+			}
+			else if(strcmp(argv[i], "socket") == 0)
+			{
+				options.triggerSource = TRIGGER_SOURCE_SOCKET;
+			}
+			else if(strcmp(argv[i], "any") == 0)
+			{
+				options.triggerSource = TRIGGER_SOURCE_ANY;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--trigger-roi") == 0 && i + 1 < argc)
+		{
+			if(!ParseTriggerRegion(argv[++i], options.triggerRegion))
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--trigger-threshold") == 0 && i + 1 < argc)
+		{
+			options.triggerThreshold = atoi(argv[++i]);
+			if(options.triggerThreshold < 0)
+			{
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "--trigger-fraction") == 0 && i + 1 < argc)
+		{
+			double percent = atof(argv[++i]);
+			if(percent < 0 || percent > 100)
+			{
+				return false;
+			}
+			options.triggerFraction = percent / 100.0;
+		}
+		else if(strcmp(argv[i], "--trigger-socket") == 0 && i + 1 < argc)
+		{
+			options.triggerSocket = argv[++i];
+		}
+		else if(strcmp(argv[i], "--frame-bus") == 0 && i + 1 < argc)
+		{
+			options.frameBus = argv[++i];
+		}
+		else if(strcmp(argv[i], "--frame-bus-slots") == 0 && i + 1 < argc)
+		{
+			options.frameBusSlots = atoi(argv[++i]);
+			if(options.frameBusSlots < 1)
+			{
+				return false;
+			}
+		}
+		else if(argv[i][0] != '-')
+		{
+			options.frameLimit = atoi(argv[i]);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	// Only the sensor-reading path runs at real-time priority; the writer and encoders keep time sharing
+	if(options.captureTuning.policy != SCHED_OTHER)
+	{
+		if(rtPriority < sched_get_priority_min(options.captureTuning.policy) || rtPriority > sched_get_priority_max(options.captureTuning.policy))
+		{
+			cerr << "Real-time priority must be between " << sched_get_priority_min(options.captureTuning.policy) << " and " << sched_get_priority_max(options.captureTuning.policy) << endl;
+			return false;
+		}
+		options.captureTuning.priority = rtPriority;
+	}
+
+	// The recording, encoders and preview handle RGB888 color and 16 bit depth; point clouds need millimetres
+	openni::PixelFormat colorFormat = options.colorMode.pixelFormat;
+	openni::PixelFormat depthFormat = options.depthMode.pixelFormat;
+	if(colorFormat != 0 && colorFormat != openni::PIXEL_FORMAT_RGB888)
+	{
+		cerr << "Color can only be recorded as rgb888" << endl;
+		return false;
+	}
+	if(depthFormat != 0 && depthFormat != openni::PIXEL_FORMAT_DEPTH_1_MM && (depthFormat != openni::PIXEL_FORMAT_DEPTH_100_UM || options.pointCloud))
+	{
+		cerr << "Depth can only be recorded as 1mm, or 100um without point clouds" << endl;
+		return false;
+	}
+
+	if(options.colorQuality < 0)
+	{
+		options.colorQuality = (options.colorEncoding == RECORDING_ENCODING_PNG) ? DEFAULT_PNG_LEVEL : DEFAULT_JPEG_QUALITY;
+	}
+	return true;
+}
+
+// Everything captured from one device. Each device has its own streams, rings, pairer and output
+// files, read and written by its own capture and writer threads, so one slow device or disk never
+// holds up another. Only the host clock that frames are stamped against is shared.
+struct DeviceCapture
+{
+	DeviceCapture(const char* deviceUri, const CaptureOptions& options) :
+		uri(deviceUri != openni::ANY_DEVICE ? deviceUri : ""), usbVendorId(0), usbProductId(0), haveModes(false),
+		colorRing(DEFAULT_RING_CAPACITY), depthRing(DEFAULT_RING_CAPACITY),
+		pairer(options.pairKey, options.pairTolerance, DEFAULT_PAIR_MAX_PENDING, options.shedPolicy == SHED_POLICY_DROP_COLOR),
+		backpressure(options.shedPolicy, options.shedDecimation), colorEncoder(NULL), depthEncoder(NULL), pointCloud(NULL), ImageFile(NULL), DepthFile(NULL),
+		colorListener(&session, RECORDING_STREAM_COLOR), depthListener(&session, RECORDING_STREAM_DEPTH),
+		unplugged(false), unpluggedAt(0), lastAttempt(0), reconnects(0), downtime(0), longestDowntime(0)
+	{
+	}
+
+	// Empty for openni::ANY_DEVICE until the device has been opened
+	std::string uri;
+	// Serial number (or position) of the device, added to its file names when capturing from several
+	std::string label;
+	// Identify the same sensor again when it comes back, possibly at a new USB address
+	std::string serial;
+	uint16_t usbVendorId;
+	uint16_t usbProductId;
+	// Video modes the streams were first started with, reapplied after a reconnect
+	bool haveModes;
+	openni::VideoMode colorMode;
+	openni::VideoMode depthMode;
+
+	openni::Device device;
+	openni::VideoStream color;
+	openni::VideoStream depth;
+
+	// Frame rings between the capture side and the writer thread
+	FrameRing<StreamSlot> colorRing;
+	FrameRing<StreamSlot> depthRing;
+	// Pairs color with depth on the writer thread
+	FramePairer pairer;
+	DeviceClock clock;
+	Backpressure backpressure;
+	TriggeredRecording trigger;
+	FrameBusWriter frameBus;
+
+	RecordingWriter recording;
+	StreamEncoder* colorEncoder;
+	StreamEncoder* depthEncoder;
+	PointCloudWriter* pointCloud;
+	FILE* ImageFile;
+	FILE* DepthFile;
+	std::string RecordingFileName;
+	std::string PointCloudFileName;
+
+	// Display images are only built if a preview is attached
+	Preview preview;
+	CaptureSession session;
+	RingFrameListener colorListener;
+	RingFrameListener depthListener;
+	std::thread capture;
+	std::thread writer;
+
+	// Hotplug state, only touched by the main thread. Times are HostClockMicroseconds().
+	bool unplugged;
+	uint64_t unpluggedAt;
+	uint64_t lastAttempt;
+	unsigned int reconnects;
+	uint64_t downtime;
+	uint64_t longestDowntime;
+
+private:
+	DeviceCapture(const DeviceCapture&);
+	DeviceCapture& operator=(const DeviceCapture&);
+};
+
+// Destroys a device's streams and closes it. Safe to call on streams or a device that aren't open.
+void CloseDevice(DeviceCapture& capture)
+{
+	// The preview may still be showing frames from these streams
+	capture.preview.release();
+	capture.color.stop();
+	capture.depth.stop();
+	// Destroy Streams
+	capture.color.destroy();
+	capture.depth.destroy();
+	// Close Device
+	capture.device.close();
+}
+
+// Sets a stream's video mode and starts it. Returns false, naming the mode asked for, if the
+// driver refuses either.
+bool StartStream(openni::VideoStream& stream, const openni::VideoMode& mode, const char* name)
+{
+	char modeText[64];
+	FormatVideoMode(mode, modeText, sizeof(modeText));
+	if(stream.setVideoMode(mode) != openni::STATUS_OK)
+	{
+		cerr << "Can't set the " << name << " mode to " << modeText << " : " << openni::OpenNI::getExtendedError() << endl;
+		return false;
+	}
+	if(stream.start() != openni::STATUS_OK)
+	{
+		cerr << "Can't start the " << name << " stream in mode " << modeText << " : " << openni::OpenNI::getExtendedError() << endl;
+		return false;
+	}
+	return true;
+}
+
+// Opens a device and starts its color and depth streams. The first time, the streams get the
+// supported modes closest to --color-mode / --depth-mode; when reopening after an unplug they get
+// exactly the modes they had before, and the device must have the same serial number. Returns false
+// if it can't be captured from.
+bool OpenDevice(DeviceCapture& capture, const CaptureOptions& options)
+{
+	openni::Device& device = capture.device;
+	openni::VideoStream& color = capture.color;
+	openni::VideoStream& depth = capture.depth;
+
+	// Open
+	openni::Status ret = device.open( capture.uri.empty() ? openni::ANY_DEVICE : capture.uri.c_str() );
+	if ( ret != openni::STATUS_OK )
+	{
+		cerr << "Device Open Failed : " << capture.uri << endl;
+		return false;
+	}
+
+	// Remember which device openni::ANY_DEVICE picked, and make sure a reopened device is the same sensor
+	capture.uri = device.getDeviceInfo().getUri();
+	capture.usbVendorId = device.getDeviceInfo().getUsbVendorId();
+	capture.usbProductId = device.getDeviceInfo().getUsbProductId();
+	char serial[RECORDING_SERIAL_LENGTH] = "";
+	GetSerialNumber(device, serial, sizeof(serial));
+	if(!capture.haveModes)
+	{
+		capture.serial = serial;
+	}
+	else if(capture.serial != serial)
+	{
+		cout << "Device " << capture.uri << " (serial " << serial << ") is not the device being recorded" << endl;
+		device.close();
+		return false;
+	}
+
+	// Set Depth and Color Synchronization, so frames can be paired by timestamp or index
+	ret = device.setDepthColorSyncEnabled(true);
+	if ( ret != openni::STATUS_OK )
+	{
+		cout << "Can't sync depth and color : " << openni::OpenNI::getExtendedError() << endl;
+	}
+
+	// Set Image Registration Mode (Depth to color), so each depth pixel lines up with the color pixel at the same position
+	if(options.pointCloud)
+	{
+		openni::ImageRegistrationMode imgRegMode = openni::IMAGE_REGISTRATION_DEPTH_TO_COLOR;
+		ret = device.setImageRegistrationMode(imgRegMode);
+		if ( ret != openni::STATUS_OK ){
+			cout << "Can't set depth to color registration, point cloud colors will be offset" << endl;
+		}
+	}
+
+	// Create Depth Image
+	ret = depth.create( device, openni::SENSOR_DEPTH );
+	openni::VideoMode dMode = capture.depthMode;
+	if ( ret == openni::STATUS_OK && !capture.haveModes && !SelectVideoMode(depth, options.depthMode, dMode) )
+	{
+		cerr << "No supported depth mode matches the one requested, see --list-modes" << endl;
+		ret = openni::STATUS_NOT_SUPPORTED;
+	}
+	if ( ret == openni::STATUS_OK && !StartStream(depth, dMode, "depth") )
+	{
+		CloseDevice(capture);
+		return false;
+	}
+
+	// Create Color Image
+	ret = color.create( device, openni::SENSOR_COLOR );	
+	openni::VideoMode cMode = capture.colorMode;
+	if ( ret == openni::STATUS_OK && !capture.haveModes && !SelectVideoMode(color, options.colorMode, cMode) )
+	{
+		cerr << "No supported color mode matches the one requested, see --list-modes" << endl;
+		ret = openni::STATUS_NOT_SUPPORTED;
+	}
+	if ( ret == openni::STATUS_OK && !StartStream(color, cMode, "color") )
+	{
+		CloseDevice(capture);
+		return false;
+	}
+
+	// Check Valid State
+	if ( !color.isValid() || !depth.isValid() || color.getVideoMode().getPixelFormat() != openni::PIXEL_FORMAT_RGB888 )
+	{
+		cout << "Image Invalid : " << capture.uri << endl;
+		CloseDevice(capture);
+		return false;
+	}
+	if(capture.haveModes)
+	{
+		return true;
+	}
+	capture.colorMode = color.getVideoMode();
+	capture.depthMode = depth.getVideoMode();
+	capture.haveModes = true;
+
+	// Get Color Stream Min-Max Value
+	int minColorValue = color.getMinPixelValue();
+	int maxColorValue = color.getMaxPixelValue();
+	cout << "Color min-Max Value : " << minColorValue << "-" << maxColorValue << endl;
+
+	// Get Depth Stream Min-Max Value
+	int minDepthValue = depth.getMinPixelValue();
+	int maxDepthValue = depth.getMaxPixelValue();
+	cout << "Depth min-Max Value : " << minDepthValue << "-" << maxDepthValue << endl;
+
+	// Get Sensor Resolution Information
+	char modeText[64];
+	FormatVideoMode(color.getVideoMode(), modeText, sizeof(modeText));
+	cout << "Color Mode : " << modeText << endl;
+	FormatVideoMode(depth.getVideoMode(), modeText, sizeof(modeText));
+	cout << "Depth Mode : " << modeText << endl;
+
+	// Get FPS Information
+	cout << "Color : " << color.getVideoMode().getFps() << "(fps) | Depth : " << depth.getVideoMode().getFps() << "(fps)" << endl;
+	if(color.getVideoMode().getFps() != depth.getVideoMode().getFps())
+	{
+		cout << "Color and depth run at different rates; only paired frames are recorded, so the faster stream is kept at the slower rate" << endl;
+	}
+	return true;
+}
+
+// Creates a device's output files and encoders and fills in its capture session. With more than one
+// device, each file name gets the device's label so the recordings of one session sit side by side.
+bool StartRecording(DeviceCapture& capture, int deviceNumber, bool multiDevice, const CaptureOptions& options, const char* CurrentDateTimeString)
+{
+	// Output color and depth, with their video modes, timestamps and a seek index, to the recording file
+	RecordingHeader recordingHeader;
+	DescribeRecording(recordingHeader, capture.device, capture.color, capture.depth);
+	capture.label = capture.serial.empty() ? "dev" + std::to_string(deviceNumber) : capture.serial;
+
+	// Generate output filenames using current date/time
+	std::string suffix = std::string(CurrentDateTimeString) + (multiDevice ? "_" + capture.label : "");
+	std::string recordingBase = "Output/Recording_" + suffix;
+	bool segmented = (options.segmentFrames > 0 || options.segmentBytes > 0);
+	capture.RecordingFileName = SegmentFileName(recordingBase, 1, segmented);
+	capture.PointCloudFileName = "Output/PointCloud_" + suffix + ".pcl";
+	std::string RGBFileName = "Output/ImageOutput_" + suffix + ".dat";
+	std::string DepthFileName = "Output/DepthOutput_" + suffix + ".dat";
+
+	// Segments are preallocated for their limit, here raw frame pairs plus index and footer, and only
+	// take their final names once complete. Whatever compression saves is trimmed when they close.
+	RecordingFileOptions fileOptions;
+	fileOptions.direct = options.directIo;
+	if(segmented)
+	{
+		uint64_t pairSize = 0;
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			const RecordingStreamInfo& stream = recordingHeader.streams[i];
+			pairSize += sizeof(RecordingFrameHeader) + RecordingPaddedSize((uint64_t)stream.width * stream.height * stream.bytesPerPixel);
+		}
+		uint64_t pairs = (options.segmentFrames > 0) ? options.segmentFrames : options.segmentBytes / pairSize + 1;
+		uint64_t bytes = pairs * pairSize;
+		if(options.segmentBytes > 0 && options.segmentBytes + pairSize < bytes)
+		{
+			bytes = options.segmentBytes + pairSize;
+		}
+		fileOptions.preallocate = sizeof(RecordingHeader) + bytes + pairs * RECORDING_MAX_STREAMS * sizeof(RecordingIndexEntry) + sizeof(RecordingFooter);
+		fileOptions.partialUntilClosed = true;
+	}
+
+	// Stamp every frame with its time on the host clock shared by all devices
+	capture.recording.setClock(&capture.clock);
+	if(!capture.recording.open(capture.RecordingFileName.c_str(), recordingHeader, fileOptions))
+	{
+		cerr << "Can't create " << capture.RecordingFileName << endl;
+		return false;
+	}
+	cout << "Recording to " << capture.RecordingFileName << " (serial " << recordingHeader.serialNumber << ", " << capture.recording.describe() << ")" << endl;
+	if(segmented)
+	{
+		cout << "New segment every";
+		if(options.segmentFrames > 0)
+		{
+			cout << " " << options.segmentFrames << " frame pairs" << (options.segmentBytes > 0 ? " or" : "");
+		}
+		if(options.segmentBytes > 0)
+		{
+			cout << " " << (options.segmentBytes >> 20) << " MB";
+		}
+		cout << ", " << (fileOptions.preallocate >> 20) << " MB preallocated each" << endl;
+	}
+
+	// Hold copies of the pre-trigger history in memory allocated now, and watch depth in its own
+	// units: 100um depth moves ten units per millimetre
+	if(options.preTrigger > 0)
+	{
+		openni::VideoMode colorMode = capture.color.getVideoMode();
+		openni::VideoMode depthMode = capture.depth.getVideoMode();
+		int threshold = options.triggerThreshold * (depthMode.getPixelFormat() == openni::PIXEL_FORMAT_DEPTH_100_UM ? 10 : 1);
+		capture.trigger.preTriggerPairs = (size_t)ceil(options.preTrigger * depthMode.getFps());
+		size_t colorBytes = (size_t)colorMode.getResolutionX() * colorMode.getResolutionY() * 3;
+		size_t depthBytes = (size_t)depthMode.getResolutionX() * depthMode.getResolutionY() * sizeof(openni::DepthPixel);
+		capture.trigger.history.resize(capture.trigger.preTriggerPairs);
+		for(size_t i = 0; i < capture.trigger.history.size(); i++)
+		{
+			capture.trigger.history[i].first.reserve(colorBytes);
+			capture.trigger.history[i].second.reserve(depthBytes);
+		}
+		capture.trigger.postTrigger = (uint64_t)(options.postTrigger * 1000000.0);
+		capture.trigger.useDepth = (options.triggerSource & TRIGGER_SOURCE_DEPTH) != 0;
+		capture.trigger.detector.configure(options.triggerRegion, threshold, options.triggerFraction);
+		cout << "Recording only around events, from " << options.preTrigger << " s (" << capture.trigger.preTriggerPairs << " frame pairs, "
+			<< (capture.trigger.preTriggerPairs * (colorBytes + depthBytes) >> 20) << " MB) before a trigger until " << options.postTrigger << " s after the last" << endl;
+	}
+
+	// Output depth map to file
+	capture.DepthFile = options.legacyDat ? fopen(DepthFileName.c_str(), "wb") : NULL;
+	// Output depth map to file
+	capture.ImageFile = options.legacyDat ? fopen(RGBFileName.c_str(), "wb") : NULL;
+
+	// Compress frames for the writer thread. Under --backpressure compress, streams stored raw get
+	// an encoder too (JPEG color, lossless depth), used only while the writer lags.
+	bool compressUnderLoad = (options.shedPolicy == SHED_POLICY_COMPRESS);
+	if(options.colorEncoding != RECORDING_ENCODING_RAW || compressUnderLoad)
+	{
+		RecordingEncoding colorEncoding = (options.colorEncoding != RECORDING_ENCODING_RAW) ? options.colorEncoding : RECORDING_ENCODING_JPEG;
+		capture.colorEncoder = new StreamEncoder(&capture.recording, RECORDING_STREAM_COLOR, colorEncoding, options.colorQuality, options.colorEncoderThreads, DEFAULT_RING_CAPACITY);
+	}
+	if(options.compressDepth || compressUnderLoad)
+	{
+		capture.depthEncoder = new StreamEncoder(&capture.recording, RECORDING_STREAM_DEPTH, RECORDING_ENCODING_DEPTH_RICE, 0, options.depthEncoderThreads, DEFAULT_RING_CAPACITY);
+	}
+
+	// Convert every frame pair to a colored point cloud for the writer thread
+	if(options.pointCloud)
+	{
+		DepthToWorld converter;
+		ConfigureDepthToWorld(converter, capture.depth);
+		capture.pointCloud = new PointCloudWriter(converter, !options.pointCloudDense, options.pointCloudThreads, DEFAULT_RING_CAPACITY);
+		if(!capture.pointCloud->open(capture.PointCloudFileName.c_str()))
+		{
+			cerr << "Can't create " << capture.PointCloudFileName << endl;
+			delete capture.pointCloud;
+			capture.pointCloud = NULL;
+		}
+		else
+		{
+			cout << "Point clouds to " << capture.PointCloudFileName << endl;
+		}
+	}
+
+	// Publish every frame, in the streams' own modes, for other local processes to read live
+	if(!options.frameBus.empty())
+	{
+		std::string name = (options.frameBus[0] == '/' ? "" : "/") + options.frameBus + (multiDevice ? "_" + capture.label : "");
+		FrameBusStreamInfo streams[RECORDING_MAX_STREAMS];
+		memset(streams, 0, sizeof(streams));
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			streams[i].pixelFormat = recordingHeader.streams[i].pixelFormat;
+			streams[i].width = recordingHeader.streams[i].width;
+			streams[i].height = recordingHeader.streams[i].height;
+			streams[i].bytesPerPixel = recordingHeader.streams[i].bytesPerPixel;
+		}
+		if(!capture.frameBus.create(name.c_str(), streams, options.frameBusSlots, recordingHeader.serialNumber))
+		{
+			cerr << "Can't create the frame bus " << name << " : " << strerror(errno) << endl;
+		}
+		else
+		{
+			cout << "Publishing frames to " << name << " (" << options.frameBusSlots << " per stream)" << endl;
+		}
+	}
+
+	CaptureSession& session = capture.session;
+	session.color = &capture.color;
+	session.depth = &capture.depth;
+	session.colorRing = &capture.colorRing;
+	session.depthRing = &capture.depthRing;
+	session.frameLimit = options.frameLimit;
+	session.pairer = &capture.pairer;
+	session.clock = &capture.clock;
+	session.streamsRemaining.store(2);
+	session.connected.store(true);
+	session.parked.store(false);
+	session.gapRequested.store(false);
+	session.stop.store(false);
+	session.writerDone.store(false);
+	session.framesWritten.store(0);
+	session.syncEvery = options.syncEvery;
+	session.segmentBase = recordingBase;
+	session.segmentFrames = options.segmentFrames;
+	session.segmentBytes = options.segmentBytes;
+	session.segment = 1;
+	session.segmentPairs = 0;
+	session.recordingFailed = false;
+	session.writeFailures[RECORDING_STREAM_COLOR] = 0;
+	session.writeFailures[RECORDING_STREAM_DEPTH] = 0;
+	session.trigger = (options.preTrigger > 0) ? &capture.trigger : NULL;
+	session.frameBus = capture.frameBus.isOpen() ? &capture.frameBus : NULL;
+	session.captureTuning = &options.captureTuning;
+	session.writerTuning = &options.writerTuning;
+	session.preview = &capture.preview;
+	session.recording = &capture.recording;
+	session.colorEncoder = capture.colorEncoder;
+	session.depthEncoder = capture.depthEncoder;
+	session.pointCloud = capture.pointCloud;
+	session.backpressure = &capture.backpressure;
+	session.colorEncodeUnderLoad = compressUnderLoad && options.colorEncoding == RECORDING_ENCODING_RAW;
+	session.depthEncodeUnderLoad = compressUnderLoad && !options.compressDepth;
+	session.ImageFile = capture.ImageFile;
+	session.DepthFile = capture.DepthFile;
+
+	// Pin the encoder and point cloud workers
+	std::vector<std::thread::native_handle_type> workers;
+	if(capture.colorEncoder != NULL)
+	{
+		workers = capture.colorEncoder->workerThreads();
+	}
+	if(capture.depthEncoder != NULL)
+	{
+		std::vector<std::thread::native_handle_type> threads = capture.depthEncoder->workerThreads();
+		workers.insert(workers.end(), threads.begin(), threads.end());
+	}
+	if(capture.pointCloud != NULL)
+	{
+		std::vector<std::thread::native_handle_type> threads = capture.pointCloud->workerThreads();
+		workers.insert(workers.end(), threads.begin(), threads.end());
+	}
+	for(size_t i = 0; i < workers.size(); i++)
+	{
+		if(!ApplyThreadTuning(workers[i], options.workerTuning))
+		{
+			cerr << "Can't set CPUs for the worker threads : " << strerror(errno) << endl;
+			break;
+		}
+	}
+	return true;
+}
+
+// Starts a device's writer thread and then its capture thread or stream listeners
+void StartCapture(DeviceCapture& capture, CaptureMode mode)
+{
+	capture.writer = std::thread(WriterThread, &capture.session);
+	if(mode == CAPTURE_MODE_EVENT)
+	{
+		capture.color.addNewFrameListener(&capture.colorListener);
+		capture.depth.addNewFrameListener(&capture.depthListener);
+	}
+	else
+	{
+		capture.capture = std::thread(CaptureThread, &capture.session);
+	}
+}
+
+// True until the device has captured its frame limit and the writer has drained its rings
+bool Capturing(DeviceCapture& capture)
+{
+	return capture.session.streamsRemaining.load(std::memory_order_acquire) > 0 || capture.colorRing.occupancy() > 0 || capture.depthRing.occupancy() > 0;
+}
+
+// Stops reading from a device and waits for its writer to finish
+void StopCapture(DeviceCapture& capture, CaptureMode mode)
+{
+	if(mode == CAPTURE_MODE_EVENT)
+	{
+		capture.color.removeNewFrameListener(&capture.colorListener);
+		capture.depth.removeNewFrameListener(&capture.depthListener);
+	}
+	else if(capture.capture.joinable())
+	{
+		capture.capture.join();
+	}
+	if(capture.writer.joinable())
+	{
+		capture.writer.join();
+	}
+}
+
+// A device appearing or disappearing, as reported by OpenNI
+struct DeviceEvent
+{
+	bool connected;
+	std::string uri;
+	uint64_t time;
+};
+
+// Watches for sensors dropping off USB and coming back, in the style of the EventBasedRead sample.
+// The callbacks run on OpenNI's own thread, so they only queue the event for the main loop.
+class DeviceMonitor : public openni::OpenNI::DeviceConnectedListener, public openni::OpenNI::DeviceDisconnectedListener
+{
+public:
+	void onDeviceConnected(const openni::DeviceInfo* info)
+	{
+		queue(true, info);
+	}
+
+	void onDeviceDisconnected(const openni::DeviceInfo* info)
+	{
+		queue(false, info);
+	}
+
+	// Takes the oldest event not yet handled. Returns false when there is none.
+	bool next(DeviceEvent& event)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_events.empty())
+		{
+			return false;
+		}
+		event = m_events.front();
+		m_events.pop_front();
+		return true;
+	}
+
+private:
+	void queue(bool connected, const openni::DeviceInfo* info)
+	{
+		DeviceEvent event;
+		event.connected = connected;
+		event.uri = info->getUri();
+		event.time = HostClockMicroseconds();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_events.push_back(event);
+	}
+
+	std::mutex m_mutex;
+	std::deque<DeviceEvent> m_events;
+};
+
+// Pauses a device's recording after it was unplugged: parks its capture side, has the writer finish
+// everything captured so far, and releases the dead streams. Its threads and files stay open.
+void PauseCapture(DeviceCapture& capture, CaptureMode mode, uint64_t unpluggedAt)
+{
+	cout << endl << "Device " << capture.label << " disconnected, pausing its recording" << endl;
+	CaptureSession& session = capture.session;
+	session.connected.store(false, std::memory_order_release);
+	if(mode == CAPTURE_MODE_EVENT)
+	{
+		capture.color.removeNewFrameListener(&capture.colorListener);
+		capture.depth.removeNewFrameListener(&capture.depthListener);
+		capture.colorListener.release();
+		capture.depthListener.release();
+	}
+	else
+	{
+		while(!session.parked.load(std::memory_order_acquire) && session.streamsRemaining.load(std::memory_order_acquire) > 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	// The writer may have finished the last frames and stopped before seeing the request
+	session.gapRequested.store(true, std::memory_order_release);
+	while(session.gapRequested.load(std::memory_order_acquire) && !session.writerDone.load(std::memory_order_acquire))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	CloseDevice(capture);
+	capture.unplugged = true;
+	capture.unpluggedAt = unpluggedAt;
+	capture.lastAttempt = 0;
+}
+
+// Looks for an unplugged device among those connected now, at its old URI or at a new USB address,
+// and resumes recording from it. The reconnect time is measured from the disconnect event to the
+// streams running again. Returns false if the device isn't back yet.
+bool ResumeCapture(DeviceCapture& capture, const std::vector<DeviceCapture*>& captures, const CaptureOptions& options)
+{
+	capture.lastAttempt = HostClockMicroseconds();
+
+	openni::Array< openni::DeviceInfo > devicesInfo;
+	openni::OpenNI::enumerateDevices( &devicesInfo );
+	std::string oldUri = capture.uri;
+	for(int pass = 0; pass < 2; pass++)
+	{
+		for ( int i = 0 ; i < devicesInfo.getSize() ; i++ )
+		{
+			// First try the device's own URI, then any other sensor of the same model nobody is recording from
+			const openni::DeviceInfo& info = devicesInfo[i];
+			bool sameUri = (oldUri == info.getUri());
+			if(pass == 0 ? !sameUri : (sameUri || info.getUsbVendorId() != capture.usbVendorId || info.getUsbProductId() != capture.usbProductId))
+			{
+				continue;
+			}
+			bool inUse = false;
+			for(size_t j = 0; j < captures.size(); j++)
+			{
+				inUse = inUse || (captures[j] != &capture && !captures[j]->unplugged && captures[j]->uri == info.getUri());
+			}
+			if(inUse)
+			{
+				continue;
+			}
+
+			capture.uri = info.getUri();
+			if(!OpenDevice(capture, options))
+			{
+				capture.uri = oldUri;
+				continue;
+			}
+
+			// The device restarts its clock after a reset, so its host clock mapping starts over too
+			capture.clock.reset();
+			CaptureSession& session = capture.session;
+			if(options.mode == CAPTURE_MODE_EVENT)
+			{
+				if(!capture.colorListener.finished())
+				{
+					capture.color.addNewFrameListener(&capture.colorListener);
+				}
+				if(!capture.depthListener.finished())
+				{
+					capture.depth.addNewFrameListener(&capture.depthListener);
+				}
+			}
+			session.parked.store(false, std::memory_order_relaxed);
+			session.connected.store(true, std::memory_order_release);
+
+			uint64_t downtime = HostClockMicroseconds() - capture.unpluggedAt;
+			capture.unplugged = false;
+			capture.reconnects++;
+			capture.downtime += downtime;
+			capture.longestDowntime = (downtime > capture.longestDowntime) ? downtime : capture.longestDowntime;
+			printf("\nDevice %s reconnected at %s after %.2f s, recording resumed\n", capture.label.c_str(), capture.uri.c_str(), downtime / 1000000.0);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Finishes the recording of a device that hasn't come back within the reconnect timeout
+void AbandonCapture(DeviceCapture& capture, CaptureMode mode)
+{
+	printf("\nDevice %s has not come back, finishing its recording\n", capture.label.c_str());
+	capture.session.stop.store(true, std::memory_order_release);
+	if(mode == CAPTURE_MODE_EVENT)
+	{
+		capture.session.streamsRemaining.store(0, std::memory_order_release);
+	}
+	capture.downtime += HostClockMicroseconds() - capture.unpluggedAt;
+	capture.unplugged = false;
+}
+
+// One timing histogram of a device's capture path, as printed and as named in --stats-file
+struct StageTiming
+{
+	const char* name;
+	const char* key;
+	const LatencyHistogram* histogram;
+	// Only runs with a preview, --pre-trigger, --frame-bus or --sync-every, so isn't printed without samples
+	bool optional;
+};
+
+// Lists a session's timing histograms in the order frames pass through them
+std::vector<StageTiming> GetStageTimings(const CaptureSession& session)
+{
+	StageTiming stages[] =
+	{
+		{ "Color read", "color_read", &session.readTime[RECORDING_STREAM_COLOR], false },
+		{ "Depth read", "depth_read", &session.readTime[RECORDING_STREAM_DEPTH], false },
+		{ "Color capture", "color_capture_latency", &session.captureLatency[RECORDING_STREAM_COLOR], false },
+		{ "Depth capture", "depth_capture_latency", &session.captureLatency[RECORDING_STREAM_DEPTH], false },
+		{ "Color frame bus publish", "color_bus_publish", &session.publishTime[RECORDING_STREAM_COLOR], true },
+		{ "Depth frame bus publish", "depth_bus_publish", &session.publishTime[RECORDING_STREAM_DEPTH], true },
+		{ "Color frame bus", "color_bus_latency", &session.busLatency[RECORDING_STREAM_COLOR], true },
+		{ "Depth frame bus", "depth_bus_latency", &session.busLatency[RECORDING_STREAM_DEPTH], true },
+		{ "Writer", "writer_latency", &session.writerLatency, false },
+		{ "Color convert", "color_convert", &session.preview->convertTime(), true },
+		{ "Depth colorize", "depth_colorize", &session.preview->colorizeTime(), true },
+		{ "Depth change", "depth_change", &session.detectTime, true },
+		{ "Pre-trigger copy", "pretrigger_copy", &session.historyTime, true },
+		{ "Color write", "color_write", &session.writeTime[RECORDING_STREAM_COLOR], false },
+		{ "Depth write", "depth_write", &session.writeTime[RECORDING_STREAM_DEPTH], false },
+		{ "Sync", "sync", &session.syncTime, true }
+	};
+	return std::vector<StageTiming>(stages, stages + sizeof(stages) / sizeof(stages[0]));
+}
+
+// Prints a device's statistics, appends its stage timings to the stats file if there is one,
+// closes its files and releases its streams and device
+void FinishRecording(DeviceCapture& capture, bool multiDevice, FILE* statsFile)
+{
+	// The writer has stopped, so the preview won't get any more frames
+	capture.preview.stop();
+	if(capture.writer.joinable() || capture.capture.joinable())
+	{
+		if(multiDevice)
+		{
+			cout << "[" << capture.label << "]" << endl;
+		}
+		cout << "Frame pairs written : " << capture.session.framesWritten.load() << " | Color frames dropped (ring full) : " << capture.colorRing.overruns() << " | Depth frames dropped (ring full) : " << capture.depthRing.overruns() << endl;
+		if(capture.session.segmentFrames > 0 || capture.session.segmentBytes > 0)
+		{
+			cout << "Recording segments : " << capture.session.segment << ", the last being " << capture.recording.fileName() << endl;
+		}
+		if(capture.session.trigger != NULL)
+		{
+			cout << "Triggered recording : " << capture.trigger.events.load() << " events, " << capture.trigger.pairsRecorded << " frame pairs recorded, "
+				<< capture.trigger.pairsDiscarded << " discarded before any trigger" << endl;
+		}
+		if(capture.frameBus.isOpen())
+		{
+			cout << "Frame bus " << capture.frameBus.name() << " : " << capture.frameBus.published(RECORDING_STREAM_COLOR) << " color, "
+				<< capture.frameBus.published(RECORDING_STREAM_DEPTH) << " depth frames published" << endl;
+		}
+		capture.backpressure.printStatistics(cout);
+		capture.pairer.printStatistics(cout);
+		uint64_t colorWriteFailures = capture.session.writeFailures[RECORDING_STREAM_COLOR] + (capture.colorEncoder != NULL ? capture.colorEncoder->writeFailures() : 0);
+		uint64_t depthWriteFailures = capture.session.writeFailures[RECORDING_STREAM_DEPTH] + (capture.depthEncoder != NULL ? capture.depthEncoder->writeFailures() : 0);
+		if(colorWriteFailures > 0 || depthWriteFailures > 0)
+		{
+			cout << "Color frames not written (write error) : " << colorWriteFailures << " | Depth frames not written (write error) : " << depthWriteFailures << endl;
+		}
+		capture.session.indexGaps[RECORDING_STREAM_COLOR].printStatistics(cout, "Color");
+		capture.session.indexGaps[RECORDING_STREAM_DEPTH].printStatistics(cout, "Depth");
+
+		std::vector<StageTiming> stages = GetStageTimings(capture.session);
+		for(size_t i = 0; i < stages.size(); i++)
+		{
+			if(!stages[i].optional || stages[i].histogram->count() > 0)
+			{
+				stages[i].histogram->printStatistics(cout, stages[i].name);
+			}
+			if(statsFile != NULL)
+			{
+				stages[i].histogram->writeCsv(statsFile, capture.label.c_str(), stages[i].key);
+			}
+		}
+	}
+	if(capture.reconnects > 0 || capture.downtime > 0)
+	{
+		printf("Reconnects : %u, %.2f s without the device, longest reconnect %.2f s\n", capture.reconnects, capture.downtime / 1000000.0, capture.longestDowntime / 1000000.0);
+	}
+	if(capture.colorEncoder != NULL)
+	{
+		capture.colorEncoder->printStatistics(cout, "Color");
+		delete capture.colorEncoder;
+		capture.colorEncoder = NULL;
+	}
+	if(capture.depthEncoder != NULL)
+	{
+		capture.depthEncoder->printStatistics(cout, "Depth");
+		delete capture.depthEncoder;
+		capture.depthEncoder = NULL;
+	}
+	if(capture.pointCloud != NULL)
+	{
+		capture.pointCloud->printStatistics(cout);
+		if(!capture.pointCloud->close())
+		{
+			cerr << "Error writing " << capture.PointCloudFileName << endl;
+		}
+		delete capture.pointCloud;
+		capture.pointCloud = NULL;
+	}
+
+	// Tell frame bus readers nothing more is coming
+	capture.frameBus.close();
+
+	// Close File streams
+	if(!capture.recording.close())
+	{
+		cerr << "Error writing " << capture.recording.fileName() << endl;
+	}
+	if(capture.ImageFile != NULL)
+	{
+		fclose(capture.ImageFile);
+	}
+	if(capture.DepthFile != NULL)
+	{
+		fclose(capture.DepthFile);
+	}
+
+	CloseDevice(capture);
+}
+
+int main( const int argc, const char* argv[] )
+{	
+	// Determine the frame limit and capture mode. If no frame limit was specified via command argument, use the default defined above
+	CaptureOptions options;
+	if(!ParseArguments(argc, argv, options))
+	{
+		cerr << "Usage: " << argv[0] << " [FrameLimit] [--poll|--event] [--pair-tolerance N] [--pair-by-index] [--legacy-dat] [--compress-depth] [--depth-threads N]" << endl;
+		cerr << "       [--color-codec jpeg|png] [--color-quality N] [--color-threads N] [--preview] [--preview-every N]" << endl;
+		cerr << "       [--colormap rainbow|gray] [--colormap-scale N] [--point-cloud] [--point-cloud-dense] [--point-cloud-threads N]" << endl;
+		cerr << "       [--device URI]... [--all-devices] [--reconnect-timeout S] [--color-mode WxH@FPS:FORMAT] [--depth-mode WxH@FPS:FORMAT] [--list-modes]" << endl;
+		cerr << "       [--rt fifo|rr] [--rt-priority N] [--capture-cpus LIST] [--writer-cpus LIST] [--worker-cpus LIST] [--mlock]" << endl;
+		cerr << "       [--backpressure none|drop-color|decimate[:N]|compress] [--sync-every N] [--stats-file PATH] [--direct-io]" << endl;
+		cerr << "       [--segment-frames N] [--segment-size MB] [--pre-trigger S] [--post-trigger S] [--trigger depth|socket|any]" << endl;
+		cerr << "       [--trigger-roi X,Y,W,H] [--trigger-threshold MM] [--trigger-fraction PCT] [--trigger-socket PATH]" << endl;
+		cerr << "       [--frame-bus NAME] [--frame-bus-slots N]" << endl;
+		return EXIT_FAILURE;
+	}
+	int FrameLimit = options.frameLimit;
+
+	// Lock memory before OpenNI allocates its frame buffers, so those are locked as well
+	if(options.lockMemory && !LockProcessMemory())
+	{
+		cerr << "Can't lock memory : " << strerror(errno) << endl;
+	}
+
+	// Initialize OpenNI Module
+	openni::OpenNI::initialize();
+	cout << "OpenNI Initialization Error : " << openni::OpenNI::getExtendedError() << endl;
+
+	// Hear about sensors dropping off USB and coming back while recording
+	DeviceMonitor monitor;
+	openni::OpenNI::addDeviceConnectedListener(&monitor);
+	openni::OpenNI::addDeviceDisconnectedListener(&monitor);
+
+	// Device Counts & Informations
+	openni::Array< openni::DeviceInfo > devicesInfo;
+	openni::OpenNI::enumerateDevices( &devicesInfo );
+	cout << "Device Counts : " << devicesInfo.getSize() << endl;
+	for ( int i = 0 ; i < devicesInfo.getSize() ; i++ )
+	{
+		cout << "Device Info [ " << i << " ] : " << devicesInfo[i].getName() << " (" << devicesInfo[i].getUri() << ")" << endl;
+	}
+
+	// Target Device URIs: the ones given, every enumerated device, or whichever device OpenNI picks
+	std::vector<std::string> deviceUris = options.deviceUris;
+	if(options.allDevices)
+	{
+		for ( int i = 0 ; i < devicesInfo.getSize() ; i++ )
+		{
+			deviceUris.push_back(devicesInfo[i].getUri());
+		}
+	}
+	bool multiDevice = deviceUris.size() > 1;
+
+	// Only list what each sensor of each device can do
+	if(options.listModes)
+	{
+		if(deviceUris.empty())
+		{
+			deviceUris.push_back("");
+		}
+		for(size_t i = 0; i < deviceUris.size(); i++)
+		{
+			openni::Device device;
+			if(device.open(deviceUris[i].empty() ? openni::ANY_DEVICE : deviceUris[i].c_str()) != openni::STATUS_OK)
+			{
+				cerr << "Device Open Failed : " << deviceUris[i] << endl;
+				continue;
+			}
+			cout << "Device " << device.getDeviceInfo().getUri() << endl;
+			PrintSupportedVideoModes(cout, device);
+			device.close();
+		}
+		openni::OpenNI::removeDeviceConnectedListener(&monitor);
+		openni::OpenNI::removeDeviceDisconnectedListener(&monitor);
+		openni::OpenNI::shutdown();
+		return EXIT_SUCCESS;
+	}
+
+	// Stage timings are dumped as histogram bins, one row per device, stage and non-empty bin
+	FILE* statsFile = NULL;
+	if(!options.statsFile.empty())
+	{
+		statsFile = fopen(options.statsFile.c_str(), "w");
+		if(statsFile == NULL)
+		{
+			cerr << "Can't create " << options.statsFile << " : " << strerror(errno) << endl;
+			openni::OpenNI::removeDeviceConnectedListener(&monitor);
+			openni::OpenNI::removeDeviceDisconnectedListener(&monitor);
+			openni::OpenNI::shutdown();
+			return EXIT_FAILURE;
+		}
+		fprintf(statsFile, "device,stage,bin_low_us,bin_high_us,count\n");
+	}
+
+	// Other programs fire the trigger of every device by sending a datagram to this socket
+	TriggerSocket triggerSocket;
+	if(options.preTrigger > 0 && (options.triggerSource & TRIGGER_SOURCE_SOCKET) != 0)
+	{
+		if(!triggerSocket.open(options.triggerSocket.c_str()))
+		{
+			cerr << "Can't create the trigger socket " << options.triggerSocket << " : " << strerror(errno) << endl;
+			if(statsFile != NULL)
+			{
+				fclose(statsFile);
+			}
+			openni::OpenNI::removeDeviceConnectedListener(&monitor);
+			openni::OpenNI::removeDeviceDisconnectedListener(&monitor);
+			openni::OpenNI::shutdown();
+			return EXIT_FAILURE;
+		}
+		cout << "Listening for triggers on " << options.triggerSocket << endl;
+	}
+
+	std::vector<DeviceCapture*> captures;
+	if(deviceUris.empty())
+	{
+		captures.push_back(new DeviceCapture(openni::ANY_DEVICE, options));
+	}
+	for(size_t i = 0; i < deviceUris.size(); i++)
+	{
+		captures.push_back(new DeviceCapture(deviceUris[i].c_str(), options));
+	}
+
+	// Generate output filenames using current date/time
+	time_t RawTime;
+	struct tm * CurrentDateTime;
+	char CurrentDateTimeString [100];
+
+	time(&RawTime);
+	CurrentDateTime = localtime(&RawTime);
+	strftime(CurrentDateTimeString, 20, "%Y-%m-%d_%H%M%S", CurrentDateTime);
+
+	// Open every device before any starts recording, so all their recordings begin together
+	bool ok = true;
+	for(size_t i = 0; ok && i < captures.size(); i++)
+	{
+		ok = OpenDevice(*captures[i], options);
+	}
+	for(size_t i = 0; ok && i < captures.size(); i++)
+	{
+		ok = StartRecording(*captures[i], (int)i, multiDevice, options, CurrentDateTimeString);
+	}
+	if(!ok)
+	{
+		for(size_t i = 0; i < captures.size(); i++)
+		{
+			FinishRecording(*captures[i], multiDevice, NULL);
+			delete captures[i];
+		}
+		if(statsFile != NULL)
+		{
+			fclose(statsFile);
+		}
+		// Shutdown
+		openni::OpenNI::removeDeviceConnectedListener(&monitor);
+		openni::OpenNI::removeDeviceDisconnectedListener(&monitor);
+		openni::OpenNI::shutdown();
+		return EXIT_FAILURE;
+	}
+
+	// The preview window shows the first device
+	WindowPreview windowPreview;
+	if(options.preview)
+	{
+		captures[0]->preview.attach(&windowPreview, options.previewEvery);
+		// The colormap scale is in millimetres, so it spans ten times as many 100um depth units
+		bool tenthMillimetres = captures[0]->depth.getVideoMode().getPixelFormat() == openni::PIXEL_FORMAT_DEPTH_100_UM;
+		captures[0]->preview.setColormap(options.colormap, tenthMillimetres ? options.colormapScale * 10 : options.colormapScale);
+	}
+
+	// Main data capture loop: frames are read by a capture thread or by the stream listeners of each device and written by that device's writer thread
+	cout << "Capturing " << FrameLimit << " frames of data from " << captures.size() << " device(s) (" << (options.mode == CAPTURE_MODE_EVENT ? "event" : "poll") << " mode)..." << endl;
+	for(size_t i = 0; i < captures.size(); i++)
+	{
+		StartCapture(*captures[i], options.mode);
+	}
+
+	// Report progress and ring occupancy until every writer has drained everything, and keep
+	// recording through devices being unplugged and plugged back in
+	bool capturing = true;
+	while(capturing)
+	{
+		// Pause the recording of any device that has gone; look for gone devices when anything appears
+		DeviceEvent event;
+		bool arrived = false;
+		while(monitor.next(event))
+		{
+			arrived = arrived || event.connected;
+			for(size_t i = 0; !event.connected && i < captures.size(); i++)
+			{
+				DeviceCapture& capture = *captures[i];
+				if(!capture.unplugged && capture.uri == event.uri && capture.session.streamsRemaining.load(std::memory_order_acquire) > 0)
+				{
+					PauseCapture(capture, options.mode, event.time);
+				}
+			}
+		}
+
+		capturing = false;
+		for(size_t i = 0; i < captures.size(); i++)
+		{
+			DeviceCapture& capture = *captures[i];
+			if(capture.unplugged)
+			{
+				uint64_t now = HostClockMicroseconds();
+				bool retry = arrived || now - capture.lastAttempt >= RECONNECT_RETRY_MS * 1000ull;
+				if(!(retry && ResumeCapture(capture, captures, options)) && options.reconnectTimeout > 0 && now - capture.unpluggedAt >= options.reconnectTimeout * 1000000ull)
+				{
+					AbandonCapture(capture, options.mode);
+				}
+			}
+			capturing = Capturing(capture) || capturing;
+			if(multiDevice)
+			{
+				printf("[%s] ", capture.label.c_str());
+			}
+			if(capture.unplugged)
+			{
+				printf("Waiting for device (%.0f s, frame #%d)  ", (HostClockMicroseconds() - capture.unpluggedAt) / 1000000.0, capture.session.framesWritten.load(std::memory_order_relaxed));
+				continue;
+			}
+			if(capture.session.trigger != NULL)
+			{
+				if(capture.trigger.active.load(std::memory_order_relaxed))
+				{
+					printf("[event #%u] ", capture.trigger.events.load(std::memory_order_relaxed));
+				}
+				else
+				{
+					printf("[armed] ");
+				}
+			}
+			printf("Recording frame #%d (color ring %u/%u, depth ring %u/%u)  ", capture.session.framesWritten.load(std::memory_order_relaxed),
+				capture.colorRing.occupancy(), capture.colorRing.capacity(), capture.depthRing.occupancy(), capture.depthRing.capacity());
+		}
+		printf("\r");
+		fflush(stdout);
+
+		// Wait for the next round, handing any triggers that arrive meanwhile to every device
+		if(triggerSocket.isOpen())
+		{
+			int triggers = triggerSocket.wait(250);
+			for(size_t i = 0; triggers > 0 && i < captures.size(); i++)
+			{
+				captures[i]->trigger.externalTriggers.fetch_add(triggers, std::memory_order_release);
+			}
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		}
+	}
+
+	for(size_t i = 0; i < captures.size(); i++)
+	{
+		StopCapture(*captures[i], options.mode);
+	}
+
+	printf("\n");
+	for(size_t i = 0; i < captures.size(); i++)
+	{
+		DeviceCapture& capture = *captures[i];
+		cout << "Ring high-water marks" << (multiDevice ? " [" + capture.label + "]" : "") << " : color " << capture.colorRing.highWater() << "/" << capture.colorRing.capacity()
+			<< ", depth " << capture.depthRing.highWater() << "/" << capture.depthRing.capacity() << endl;
+	}
+	cout << "All finished, closing streams and exiting gracefully" << endl;
+
+	for(size_t i = 0; i < captures.size(); i++)
+	{
+		FinishRecording(*captures[i], multiDevice, statsFile);
+		delete captures[i];
+	}
+	if(statsFile != NULL && fclose(statsFile) != 0)
+	{
+		cerr << "Error writing " << options.statsFile << endl;
+	}
+	// Shutdown OpenNI
+	openni::OpenNI::removeDeviceConnectedListener(&monitor);
+	openni::OpenNI::removeDeviceDisconnectedListener(&monitor);
+	openni::OpenNI::shutdown();
+
+	// Return
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#ifndef _COLOR_SWIZZLE_H_
+#define _COLOR_SWIZZLE_H_
+
+// Header Includes
+#include <immintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Kernels for SwizzleRgbToBgr
+enum SwizzleKernel
+{
+	SWIZZLE_KERNEL_AUTO,	// The fastest one this CPU runs
+	SWIZZLE_KERNEL_SCALAR,
+	SWIZZLE_KERNEL_SSSE3,
+	SWIZZLE_KERNEL_AVX2
+};
+
+// Reverses each 3-byte pixel of a 16-byte block; the last 4 bytes are passed through and
+// overwritten by the next block, so blocks advance 12 bytes (4 pixels) at a time
+#define SWIZZLE_RGB_TO_BGR_MASK 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15
+
+inline void SwizzleRowScalar(const uint8_t* rgb, uint8_t* bgr, int x, int width)
+{
+	for(; x < width; x++)
+	{
+		uint8_t r = rgb[x * 3 + 0];
+		bgr[x * 3 + 0] = rgb[x * 3 + 2];
+		bgr[x * 3 + 1] = rgb[x * 3 + 1];
+		bgr[x * 3 + 2] = r;
+	}
+}
+
+// Four pixels per shuffle, 16 per step. Every load and store touches 4 bytes past the pixels
+// it converts, so the vector loop leaves at least 2 pixels of the row to the scalar tail.
+__attribute__((target("ssse3")))
+inline void SwizzleRowSsse3(const uint8_t* rgb, uint8_t* bgr, int width)
+{
+	const __m128i mask = _mm_setr_epi8(SWIZZLE_RGB_TO_BGR_MASK);
+	int x = 0;
+	for(; x + 18 <= width; x += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(rgb + x * 3));
+		__m128i b = _mm_loadu_si128((const __m128i*)(rgb + x * 3 + 12));
+		__m128i c = _mm_loadu_si128((const __m128i*)(rgb + x * 3 + 24));
+		__m128i d = _mm_loadu_si128((const __m128i*)(rgb + x * 3 + 36));
+		_mm_storeu_si128((__m128i*)(bgr + x * 3), _mm_shuffle_epi8(a, mask));
+		_mm_storeu_si128((__m128i*)(bgr + x * 3 + 12), _mm_shuffle_epi8(b, mask));
+		_mm_storeu_si128((__m128i*)(bgr + x * 3 + 24), _mm_shuffle_epi8(c, mask));
+		_mm_storeu_si128((__m128i*)(bgr + x * 3 + 36), _mm_shuffle_epi8(d, mask));
+	}
+	for(; x + 6 <= width; x += 4)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(rgb + x * 3));
+		_mm_storeu_si128((__m128i*)(bgr + x * 3), _mm_shuffle_epi8(a, mask));
+	}
+	SwizzleRowScalar(rgb, bgr, x, width);
+}
+
+// Eight pixels per 32-byte load: a dword permute gives each 128-bit lane its own 4-pixel block,
+// one shuffle reverses both, and a second permute packs the 24 converted bytes back together for
+// a single 32-byte store. Loads and stores overhang by 8 bytes, so the SSSE3 kernel finishes the row.
+__attribute__((target("avx2")))
+inline void SwizzleRowAvx2(const uint8_t* rgb, uint8_t* bgr, int width)
+{
+	const __m256i mask = _mm256_setr_epi8(SWIZZLE_RGB_TO_BGR_MASK, SWIZZLE_RGB_TO_BGR_MASK);
+	const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+	int x = 0;
+	for(; x + 19 <= width; x += 16)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(rgb + x * 3));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(rgb + x * 3 + 24));
+		a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(a, spread), mask), gather);
+		b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(b, spread), mask), gather);
+		_mm256_storeu_si256((__m256i*)(bgr + x * 3), a);
+		_mm256_storeu_si256((__m256i*)(bgr + x * 3 + 24), b);
+	}
+	SwizzleRowSsse3(rgb + x * 3, bgr + x * 3, width - x);
+}
+
+// Converts a width x height block of RGB888 pixels to BGR, row by row. The strides let the source
+// be a frame with padded rows and the destination a region of a larger image, e.g. a cropped frame
+// placed at its crop origin. Returns false if the CPU can't run the requested kernel.
+inline bool SwizzleRgbToBgr(const uint8_t* rgb, int width, int height, int rgbStrideInBytes, uint8_t* bgr, int bgrStrideInBytes,
+	SwizzleKernel kernel = SWIZZLE_KERNEL_AUTO)
+{
+	bool avx2 = __builtin_cpu_supports("avx2");
+	bool ssse3 = __builtin_cpu_supports("ssse3");
+	if(kernel == SWIZZLE_KERNEL_AUTO)
+	{
+		kernel = avx2 ? SWIZZLE_KERNEL_AVX2 : ssse3 ? SWIZZLE_KERNEL_SSSE3 : SWIZZLE_KERNEL_SCALAR;
+	}
+	if((kernel == SWIZZLE_KERNEL_AVX2 && !avx2) || (kernel == SWIZZLE_KERNEL_SSSE3 && !ssse3))
+	{
+		return false;
+	}
+
+	for(int y = 0; y < height; y++)
+	{
+		const uint8_t* rgbRow = rgb + (size_t)y * rgbStrideInBytes;
+		uint8_t* bgrRow = bgr + (size_t)y * bgrStrideInBytes;
+		switch(kernel)
+		{
+			case SWIZZLE_KERNEL_AVX2:
+				SwizzleRowAvx2(rgbRow, bgrRow, width);
+				break;
+			case SWIZZLE_KERNEL_SSSE3:
+				SwizzleRowSsse3(rgbRow, bgrRow, width);
+				break;
+			default:
+				SwizzleRowScalar(rgbRow, bgrRow, 0, width);
+				break;
+		}
+	}
+	return true;
+}
+
+#endif // _COLOR_SWIZZLE_H_
@@ -0,0 +1,130 @@
+// Header Includes
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "BenchFrames.h"
+#include "ColorSwizzle.h"
+
+#define DEFAULT_ITERATIONS 200
+
+// Namespaces
+using namespace std;
+
+// The per-pixel copy the preview used before the swizzle kernels, kept as the reference
+void ConvertReference(const uint8_t* colorImgRaw, int pixels, uint8_t* cImg)
+{
+	for ( int i = 0 ; i < pixels ; i++ )
+	{
+		int idx = i * 3; // cv::Mat is BGR
+		unsigned char* data = &cImg[idx];
+		data[0] = colorImgRaw[i * 3 + 2];
+		data[1] = colorImgRaw[i * 3 + 1];
+		data[2] = colorImgRaw[i * 3 + 0];
+	}
+}
+
+// Converts a block with padded source rows into the middle of a larger image, at every width up
+// to 40 so each kernel's tail is exercised, and checks the pixels and the bytes around them.
+// Returns the number of widths that went wrong.
+unsigned long CheckStrides(SwizzleKernel kernel)
+{
+	const int height = 3;
+	const int imageWidth = 64;
+	unsigned long mismatches = 0;
+	for(int width = 1; width <= 40; width++)
+	{
+		int rgbStride = width * 3 + 5;
+		std::vector<uint8_t> rgb(rgbStride * height);
+		for(size_t i = 0; i < rgb.size(); i++)
+		{
+			rgb[i] = rand();
+		}
+
+		std::vector<uint8_t> expected(imageWidth * 3 * (height + 2), 0xA5);
+		std::vector<uint8_t> actual(expected);
+		uint8_t* origin = &actual[imageWidth * 3 + 7 * 3];
+		SwizzleRgbToBgr(&rgb[0], width, height, rgbStride, origin, imageWidth * 3, kernel);
+		for(int y = 0; y < height; y++)
+		{
+			ConvertReference(&rgb[y * rgbStride], width, &expected[(y + 1) * imageWidth * 3 + 7 * 3]);
+		}
+		mismatches += (expected != actual);
+	}
+	return mismatches;
+}
+
+// Compares the swizzle kernels with the original RGB to BGR loop: ns per frame, a bit-exact check
+// of every benchmark frame, and a check of padded strides and offsets. Uses the raw color frames
+// of a recording if one is given, otherwise synthetic frames.
+int main( const int argc, const char* argv[] )
+{
+	RecordingReader reader;
+	int iterations = DEFAULT_ITERATIONS;
+	if(!OpenBenchRecording(argc, argv, reader, iterations))
+	{
+		return EXIT_FAILURE;
+	}
+
+	// Benchmark frames, packed without row padding
+	int width = BENCH_LEGACY_RES_X;
+	int height = BENCH_LEGACY_RES_Y;
+	std::vector< std::vector<uint8_t> > frames;
+	ReadBenchFrames(reader, RECORDING_STREAM_COLOR, width, height, frames);
+	if(frames.empty())
+	{
+		SyntheticColorFrames(width, height, frames);
+	}
+	int pixels = width * height;
+	cout << "Color frames : " << frames.size() << " (" << width << "x" << height << "), " << iterations << " iterations" << endl;
+
+	std::vector<uint8_t> expected(pixels * 3 * frames.size());
+	std::vector<uint8_t> actual(pixels * 3);
+
+	// Original loop
+	double start = Seconds();
+	for(int i = 0; i < iterations; i++)
+	{
+		for(size_t f = 0; f < frames.size(); f++)
+		{
+			ConvertReference(&frames[f][0], pixels, &expected[pixels * 3 * f]);
+		}
+	}
+	double referenceNs = 1e9 * (Seconds() - start) / (iterations * frames.size());
+	printf("Per-pixel loop : %8.0f ns/frame\n", referenceNs);
+
+	static const SwizzleKernel kernels[] = { SWIZZLE_KERNEL_SCALAR, SWIZZLE_KERNEL_SSSE3, SWIZZLE_KERNEL_AVX2 };
+	static const char* kernelNames[] = { "Scalar rows", "SSSE3", "AVX2" };
+	bool exact = true;
+	for(size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	{
+		if(!SwizzleRgbToBgr(&frames[0][0], width, height, width * 3, &actual[0], width * 3, kernels[k]))
+		{
+			printf("%-14s : not supported by this CPU\n", kernelNames[k]);
+			continue;
+		}
+
+		unsigned long mismatches = CheckStrides(kernels[k]);
+		start = Seconds();
+		for(int i = 0; i < iterations; i++)
+		{
+			for(size_t f = 0; f < frames.size(); f++)
+			{
+				SwizzleRgbToBgr(&frames[f][0], width, height, width * 3, &actual[0], width * 3, kernels[k]);
+			}
+		}
+		double ns = 1e9 * (Seconds() - start) / (iterations * frames.size());
+		for(size_t f = 0; f < frames.size(); f++)
+		{
+			SwizzleRgbToBgr(&frames[f][0], width, height, width * 3, &actual[0], width * 3, kernels[k]);
+			mismatches += (memcmp(&actual[0], &expected[pixels * 3 * f], pixels * 3) != 0);
+		}
+
+		printf("%-14s : %8.0f ns/frame (%.1fx) %s\n", kernelNames[k], ns, referenceNs / ns, mismatches == 0 ? "bit-exact" : "MISMATCH");
+		exact = exact && mismatches == 0;
+	}
+
+	return exact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
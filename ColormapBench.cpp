@@ -0,0 +1,170 @@
+// Header Includes
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "BenchFrames.h"
+#include "DepthColormap.h"
+
+#define DEFAULT_ITERATIONS 200
+
+// Namespaces
+using namespace std;
+
+// The per-pixel rainbow loop the preview used before the lookup table, kept as the reference
+void ColorizeReference(const uint16_t* depthImgRaw, int pixels, uint8_t* dImg)
+{
+	int lb, ub;
+	for ( int i = 0 ; i < pixels ; i++ )
+	{
+		int idx = i * 3;
+		unsigned char* data = &dImg[idx];
+
+		lb = (depthImgRaw[i]/5) % 256;
+		ub = depthImgRaw[i]/5 / 256;
+
+		switch (ub) {
+			case 0:
+				data[2] = 255;
+				data[1] = 255-lb;
+				data[0] = 255-lb;
+				break;
+			case 1:
+				data[2] = 255;
+				data[1] = lb;
+				data[0] = 0;
+				break;
+			case 2:
+				data[2] = 255-lb;
+				data[1] = 255;
+				data[0] = 0;
+				break;
+			case 3:
+				data[2] = 0;
+				data[1] = 255;
+				data[0] = lb;
+				break;
+			case 4:
+				data[2] = 0;
+				data[1] = 255-lb;
+				data[0] = 255;
+				break;
+			case 5:
+				data[2] = 0;
+				data[1] = 0;
+				data[0] = 255-lb;
+				break;
+			default:
+				data[2] = 0;
+				data[1] = 0;
+				data[0] = 0;
+				break;
+		}
+	}
+}
+
+// Colorizes every depth value from 0 to 65535 at a few widths, so the vector loops and their
+// scalar tails are all compared against the reference. Returns the number of differing pixels.
+unsigned long CheckAllDepths(const DepthColorizer& colorizer)
+{
+	static const int widths[] = { 256, 255, 13, 9, 1 };
+	std::vector<uint16_t> depth(65536);
+	for(int d = 0; d < 65536; d++)
+	{
+		depth[d] = d;
+	}
+
+	unsigned long mismatches = 0;
+	for(size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+	{
+		int width = widths[w];
+		int height = 65536 / width;
+		std::vector<uint8_t> expected(width * height * 3);
+		std::vector<uint8_t> actual(width * height * 3);
+		ColorizeReference(&depth[0], width * height, &expected[0]);
+		colorizer.colorize(&depth[0], width, height, width * sizeof(uint16_t), &actual[0], width * 3);
+		for(size_t i = 0; i < actual.size(); i++)
+		{
+			mismatches += (actual[i] != expected[i]);
+		}
+	}
+	return mismatches;
+}
+
+// Compares the lookup table kernels with the original rainbow loop: ns per frame, and a
+// bit-exact check over every depth value and every benchmark frame. Uses the depth frames of
+// a recording if one is given, otherwise synthetic frames.
+int main( const int argc, const char* argv[] )
+{
+	RecordingReader reader;
+	int iterations = DEFAULT_ITERATIONS;
+	if(!OpenBenchRecording(argc, argv, reader, iterations))
+	{
+		return EXIT_FAILURE;
+	}
+
+	// Benchmark frames, packed without row padding
+	int width = BENCH_LEGACY_RES_X;
+	int height = BENCH_LEGACY_RES_Y;
+	std::vector< std::vector<uint16_t> > frames;
+	ReadBenchFrames(reader, RECORDING_STREAM_DEPTH, width, height, frames);
+	if(frames.empty())
+	{
+		SyntheticDepthFrames(width, height, frames);
+	}
+	int pixels = width * height;
+	cout << "Depth frames : " << frames.size() << " (" << width << "x" << height << "), " << iterations << " iterations" << endl;
+
+	std::vector<uint8_t> expected(pixels * 3 * frames.size());
+	std::vector<uint8_t> actual(pixels * 3);
+
+	// Original loop
+	double start = Seconds();
+	for(int i = 0; i < iterations; i++)
+	{
+		for(size_t f = 0; f < frames.size(); f++)
+		{
+			ColorizeReference(&frames[f][0], pixels, &expected[pixels * 3 * f]);
+		}
+	}
+	double referenceTime = Seconds() - start;
+	double referenceNs = 1e9 * referenceTime / (iterations * frames.size());
+	printf("Scalar switch : %8.0f ns/frame\n", referenceNs);
+
+	static const DepthColorizer::Kernel kernels[] = { DepthColorizer::KERNEL_SCALAR, DepthColorizer::KERNEL_SSSE3, DepthColorizer::KERNEL_AVX2 };
+	static const char* kernelNames[] = { "LUT scalar", "LUT SSSE3", "LUT AVX2" };
+	bool exact = true;
+	for(size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	{
+		DepthColorizer colorizer;
+		if(!colorizer.setKernel(kernels[k]))
+		{
+			printf("%-13s : not supported by this CPU\n", kernelNames[k]);
+			continue;
+		}
+
+		unsigned long mismatches = CheckAllDepths(colorizer);
+		start = Seconds();
+		for(int i = 0; i < iterations; i++)
+		{
+			for(size_t f = 0; f < frames.size(); f++)
+			{
+				colorizer.colorize(&frames[f][0], width, height, width * sizeof(uint16_t), &actual[0], width * 3);
+			}
+		}
+		double time = Seconds() - start;
+		for(size_t f = 0; f < frames.size(); f++)
+		{
+			colorizer.colorize(&frames[f][0], width, height, width * sizeof(uint16_t), &actual[0], width * 3);
+			mismatches += (memcmp(&actual[0], &expected[pixels * 3 * f], pixels * 3) != 0);
+		}
+
+		double ns = 1e9 * time / (iterations * frames.size());
+		printf("%-13s : %8.0f ns/frame (%.1fx) %s\n", kernelNames[k], ns, referenceNs / ns, mismatches == 0 ? "bit-exact" : "MISMATCH");
+		exact = exact && mismatches == 0;
+	}
+
+	return exact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
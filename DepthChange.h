@@ -0,0 +1,245 @@
+#ifndef _DEPTH_CHANGE_H_
+#define _DEPTH_CHANGE_H_
+
+// Header Includes
+#include <immintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Kernels for DetectDepthChange
+enum DepthChangeKernel
+{
+	DEPTH_CHANGE_KERNEL_AUTO,	// The fastest one this CPU runs
+	DEPTH_CHANGE_KERNEL_SCALAR,
+	DEPTH_CHANGE_KERNEL_SSE2,
+	DEPTH_CHANGE_KERNEL_AVX2
+};
+
+// The change threshold grows by 1/32 of the background depth (about 3%), as sensor noise grows with distance
+#define DEPTH_CHANGE_RELATIVE_SHIFT 5
+
+// Depth is compared on a grid of every other pixel of every other row
+inline int DepthChangeSamples(int pixels)
+{
+	return (pixels + 1) / 2;
+}
+
+// What DetectDepthChange found: how many grid samples changed out of how many, and the bounding
+// box of the changed ones in image pixels, with a zero width and height when none did
+struct DepthChange
+{
+	DepthChange() : changed(0), samples(0), x(0), y(0), width(0), height(0)
+	{
+	}
+
+	unsigned int changed;
+	unsigned int samples;
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+// (a + b + 1) / 2, as _mm_avg_epu16 rounds
+inline int DepthChangeAverage(int a, int b)
+{
+	return (a + b + 1) >> 1;
+}
+
+// One row of samples from index i on. depth points at the row's first pixel in the region and holds
+// pixels of them; sample i is pixel 2 * i. Compares each sample with its background value and moves
+// the background 1/16 of the way towards it, four rounding averages deep so the vector kernels match
+// exactly. Samples without a reading in either are never a change; the background takes the first
+// reading and keeps its value through dropouts. Returns the changed count and widens [first, last]
+// to the changed sample indices.
+inline unsigned int DepthChangeRowScalar(const uint16_t* depth, uint16_t* background, int i, int pixels, int threshold, int& first, int& last)
+{
+	unsigned int changed = 0;
+	for(; 2 * i < pixels; i++)
+	{
+		int now = depth[2 * i];
+		int before = background[i];
+		int difference = (now > before) ? now - before : before - now;
+		if(now != 0 && before != 0 && difference > threshold + (before >> DEPTH_CHANGE_RELATIVE_SHIFT))
+		{
+			changed++;
+			first = (i < first) ? i : first;
+			last = (i > last) ? i : last;
+		}
+
+		if(before == 0)
+		{
+			background[i] = (uint16_t)now;
+		}
+		else if(now != 0)
+		{
+			int average = DepthChangeAverage(before, now);
+			average = DepthChangeAverage(before, average);
+			average = DepthChangeAverage(before, average);
+			background[i] = (uint16_t)DepthChangeAverage(before, average);
+		}
+	}
+	return changed;
+}
+
+// Eight samples from 16 pixels per step: each pixel pair's dword is shifted so the even pixel sign
+// extends back down, and a signed pack then restores its bits exactly. Loads never reach past the
+// row's pixels, so up to 15 of them are left to the scalar tail.
+__attribute__((target("sse2")))
+inline unsigned int DepthChangeRowSse2(const uint16_t* depth, uint16_t* background, int i, int pixels, int threshold, int& first, int& last)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(-1);
+	const __m128i base = _mm_set1_epi16((short)(threshold < 0xFFFF ? threshold : 0xFFFF));
+	__m128i counts = zero;
+	for(; 2 * i + 16 <= pixels; i += 8)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(depth + 2 * i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(depth + 2 * i + 8));
+		__m128i now = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+		__m128i before = _mm_loadu_si128((const __m128i*)(background + i));
+
+		__m128i nowZero = _mm_cmpeq_epi16(now, zero);
+		__m128i beforeZero = _mm_cmpeq_epi16(before, zero);
+		__m128i limit = _mm_adds_epu16(base, _mm_srli_epi16(before, DEPTH_CHANGE_RELATIVE_SHIFT));
+		__m128i difference = _mm_or_si128(_mm_subs_epu16(now, before), _mm_subs_epu16(before, now));
+		__m128i within = _mm_cmpeq_epi16(_mm_subs_epu16(difference, limit), zero);
+		__m128i changed = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(nowZero, beforeZero), within), ones);
+		counts = _mm_sub_epi16(counts, changed);
+		int mask = _mm_movemask_epi8(changed);
+		if(mask != 0)
+		{
+			int lo = i + __builtin_ctz(mask) / 2;
+			int hi = i + (31 - __builtin_clz(mask)) / 2;
+			first = (lo < first) ? lo : first;
+			last = (hi > last) ? hi : last;
+		}
+
+		__m128i average = _mm_avg_epu16(before, now);
+		average = _mm_avg_epu16(before, average);
+		average = _mm_avg_epu16(before, average);
+		average = _mm_avg_epu16(before, average);
+		average = _mm_or_si128(_mm_and_si128(beforeZero, now), _mm_andnot_si128(beforeZero, average));
+		average = _mm_or_si128(_mm_and_si128(nowZero, before), _mm_andnot_si128(nowZero, average));
+		_mm_storeu_si128((__m128i*)(background + i), average);
+	}
+
+	__m128i sums = _mm_madd_epi16(counts, _mm_set1_epi16(1));
+	sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+	sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (unsigned int)_mm_cvtsi128_si32(sums) + DepthChangeRowScalar(depth, background, i, pixels, threshold, first, last);
+}
+
+// Sixteen samples from 32 pixels per step. The pack works within 128-bit lanes, so a qword permute
+// puts the samples back in order. The SSE2 kernel finishes the row.
+__attribute__((target("avx2")))
+inline unsigned int DepthChangeRowAvx2(const uint16_t* depth, uint16_t* background, int i, int pixels, int threshold, int& first, int& last)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(-1);
+	const __m256i base = _mm256_set1_epi16((short)(threshold < 0xFFFF ? threshold : 0xFFFF));
+	__m256i counts = zero;
+	for(; 2 * i + 32 <= pixels; i += 16)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(depth + 2 * i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(depth + 2 * i + 16));
+		__m256i now = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16), _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16));
+		now = _mm256_permute4x64_epi64(now, _MM_SHUFFLE(3, 1, 2, 0));
+		__m256i before = _mm256_loadu_si256((const __m256i*)(background + i));
+
+		__m256i nowZero = _mm256_cmpeq_epi16(now, zero);
+		__m256i beforeZero = _mm256_cmpeq_epi16(before, zero);
+		__m256i limit = _mm256_adds_epu16(base, _mm256_srli_epi16(before, DEPTH_CHANGE_RELATIVE_SHIFT));
+		__m256i difference = _mm256_or_si256(_mm256_subs_epu16(now, before), _mm256_subs_epu16(before, now));
+		__m256i within = _mm256_cmpeq_epi16(_mm256_subs_epu16(difference, limit), zero);
+		__m256i changed = _mm256_andnot_si256(_mm256_or_si256(_mm256_or_si256(nowZero, beforeZero), within), ones);
+		counts = _mm256_sub_epi16(counts, changed);
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(changed);
+		if(mask != 0)
+		{
+			int lo = i + __builtin_ctz(mask) / 2;
+			int hi = i + (31 - __builtin_clz(mask)) / 2;
+			first = (lo < first) ? lo : first;
+			last = (hi > last) ? hi : last;
+		}
+
+		__m256i average = _mm256_avg_epu16(before, now);
+		average = _mm256_avg_epu16(before, average);
+		average = _mm256_avg_epu16(before, average);
+		average = _mm256_avg_epu16(before, average);
+		average = _mm256_blendv_epi8(average, now, beforeZero);
+		average = _mm256_blendv_epi8(average, before, nowZero);
+		_mm256_storeu_si256((__m256i*)(background + i), average);
+	}
+
+	__m256i sums = _mm256_madd_epi16(counts, _mm256_set1_epi16(1));
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (unsigned int)_mm_cvtsi128_si32(half) + DepthChangeRowSse2(depth, background, i, pixels, threshold, first, last);
+}
+
+// Compares a width x height region at (x, y) of a depth image with its running background, on the
+// grid of every other pixel of every other row, and updates the background. A sample changed when
+// it moved further than threshold plus the depth-dependent allowance, in depth units. background
+// holds DepthChangeSamples(width) * DepthChangeSamples(height) values, zero where there is no
+// background yet. Works on the frame in place, e.g. a driver buffer. Returns false if the CPU can't
+// run the requested kernel.
+inline bool DetectDepthChange(const uint16_t* depth, int strideInBytes, int x, int y, int width, int height, uint16_t* background, int threshold,
+	DepthChange& change, DepthChangeKernel kernel = DEPTH_CHANGE_KERNEL_AUTO)
+{
+	bool avx2 = __builtin_cpu_supports("avx2");
+	bool sse2 = __builtin_cpu_supports("sse2");
+	if(kernel == DEPTH_CHANGE_KERNEL_AUTO)
+	{
+		kernel = avx2 ? DEPTH_CHANGE_KERNEL_AVX2 : sse2 ? DEPTH_CHANGE_KERNEL_SSE2 : DEPTH_CHANGE_KERNEL_SCALAR;
+	}
+	if((kernel == DEPTH_CHANGE_KERNEL_AVX2 && !avx2) || (kernel == DEPTH_CHANGE_KERNEL_SSE2 && !sse2))
+	{
+		return false;
+	}
+
+	int columns = DepthChangeSamples(width);
+	int rows = DepthChangeSamples(height);
+	change = DepthChange();
+	change.samples = (unsigned int)columns * rows;
+	int first = columns;
+	int last = -1;
+	int top = -1;
+	int bottom = -1;
+	for(int row = 0; row < rows; row++)
+	{
+		const uint16_t* pixels = (const uint16_t*)((const uint8_t*)depth + (size_t)(y + 2 * row) * strideInBytes) + x;
+		uint16_t* samples = background + (size_t)row * columns;
+		unsigned int changed;
+		switch(kernel)
+		{
+			case DEPTH_CHANGE_KERNEL_AVX2:
+				changed = DepthChangeRowAvx2(pixels, samples, 0, width, threshold, first, last);
+				break;
+			case DEPTH_CHANGE_KERNEL_SSE2:
+				changed = DepthChangeRowSse2(pixels, samples, 0, width, threshold, first, last);
+				break;
+			default:
+				changed = DepthChangeRowScalar(pixels, samples, 0, width, threshold, first, last);
+				break;
+		}
+		if(changed > 0)
+		{
+			top = (top < 0) ? row : top;
+			bottom = row;
+			change.changed += changed;
+		}
+	}
+
+	if(change.changed > 0)
+	{
+		change.x = x + 2 * first;
+		change.y = y + 2 * top;
+		change.width = 2 * (last - first) + 1;
+		change.height = 2 * (bottom - top) + 1;
+	}
+	return true;
+}
+
+#endif // _DEPTH_CHANGE_H_
@@ -0,0 +1,146 @@
+// Header Includes
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "BenchFrames.h"
+#include "DepthChange.h"
+
+#define DEFAULT_ITERATIONS 200
+// Change threshold in millimetres, as for --trigger-threshold
+#define DEFAULT_THRESHOLD 50
+
+// Namespaces
+using namespace std;
+
+// True if two kernels found the same change
+bool SameChange(const DepthChange& a, const DepthChange& b)
+{
+	return a.changed == b.changed && a.samples == b.samples && a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+// Runs a kernel and the scalar one over regions of every width up to 80 at odd offsets into frames
+// with padded rows, so the vector loops and their tails all see changes, dropouts and fresh
+// background. Returns the number of frames whose change or background differed.
+unsigned long CheckRegions(DepthChangeKernel kernel)
+{
+	const int imageWidth = 96;
+	const int imageHeight = 9;
+	const int stride = imageWidth + 5;
+	unsigned long mismatches = 0;
+	for(int width = 1; width <= 80; width++)
+	{
+		int x = width % 7;
+		int y = 1;
+		int height = imageHeight - 2;
+		std::vector<uint16_t> expected(DepthChangeSamples(width) * DepthChangeSamples(height), 0);
+		std::vector<uint16_t> actual(expected);
+		std::vector<uint16_t> depth(stride * imageHeight);
+		for(int f = 0; f < 8; f++)
+		{
+			for(size_t i = 0; i < depth.size(); i++)
+			{
+				depth[i] = (rand() % 10 == 0) ? 0 : 800 + rand() % ((f % 2 == 0) ? 100 : 4000);
+			}
+			DepthChange expectedChange;
+			DepthChange actualChange;
+			DetectDepthChange(&depth[0], stride * sizeof(uint16_t), x, y, width, height, &expected[0], 20, expectedChange, DEPTH_CHANGE_KERNEL_SCALAR);
+			DetectDepthChange(&depth[0], stride * sizeof(uint16_t), x, y, width, height, &actual[0], 20, actualChange, kernel);
+			mismatches += (expected != actual || !SameChange(expectedChange, actualChange));
+		}
+	}
+	return mismatches;
+}
+
+// Compares the depth change kernels with each other: ns per frame against a running background, a
+// bit-exact check of the changes found and the background left after the benchmark frames, and a
+// check of regions at every width and offset. Uses the depth frames of a recording if one is given,
+// otherwise synthetic frames with an object moving across a still scene.
+int main( const int argc, const char* argv[] )
+{
+	RecordingReader reader;
+	int iterations = DEFAULT_ITERATIONS;
+	if(!OpenBenchRecording(argc, argv, reader, iterations))
+	{
+		return EXIT_FAILURE;
+	}
+
+	// Benchmark frames, packed without row padding
+	int width = BENCH_LEGACY_RES_X;
+	int height = BENCH_LEGACY_RES_Y;
+	std::vector< std::vector<uint16_t> > frames;
+	ReadBenchFrames(reader, RECORDING_STREAM_DEPTH, width, height, frames);
+	if(frames.empty())
+	{
+		SyntheticDepthFrames(width, height, frames);
+	}
+	int samples = DepthChangeSamples(width) * DepthChangeSamples(height);
+	cout << "Depth frames : " << frames.size() << " (" << width << "x" << height << "), " << iterations << " iterations" << endl;
+
+	static const DepthChangeKernel kernels[] = { DEPTH_CHANGE_KERNEL_SCALAR, DEPTH_CHANGE_KERNEL_SSE2, DEPTH_CHANGE_KERNEL_AVX2 };
+	static const char* kernelNames[] = { "Scalar", "SSE2", "AVX2" };
+	std::vector<DepthChange> expected(frames.size());
+	std::vector<uint16_t> expectedBackground;
+	double scalarNs = 0;
+	bool exact = true;
+	for(size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	{
+		std::vector<uint16_t> background(samples, 0);
+		DepthChange change;
+		if(!DetectDepthChange(&frames[0][0], width * sizeof(uint16_t), 0, 0, width, height, &background[0], DEFAULT_THRESHOLD, change, kernels[k]))
+		{
+			printf("%-8s : not supported by this CPU\n", kernelNames[k]);
+			continue;
+		}
+
+		// One pass from an empty background for the comparison, then the timed passes
+		unsigned long mismatches = (k == 0) ? 0 : CheckRegions(kernels[k]);
+		background.assign(samples, 0);
+		unsigned long changed = 0;
+		for(size_t f = 0; f < frames.size(); f++)
+		{
+			DetectDepthChange(&frames[f][0], width * sizeof(uint16_t), 0, 0, width, height, &background[0], DEFAULT_THRESHOLD, change, kernels[k]);
+			changed += change.changed;
+			if(k == 0)
+			{
+				expected[f] = change;
+			}
+			else
+			{
+				mismatches += !SameChange(change, expected[f]);
+			}
+		}
+		if(k == 0)
+		{
+			expectedBackground = background;
+		}
+		else
+		{
+			mismatches += (background != expectedBackground);
+		}
+
+		double start = Seconds();
+		for(int i = 0; i < iterations; i++)
+		{
+			for(size_t f = 0; f < frames.size(); f++)
+			{
+				DetectDepthChange(&frames[f][0], width * sizeof(uint16_t), 0, 0, width, height, &background[0], DEFAULT_THRESHOLD, change, kernels[k]);
+			}
+		}
+		double ns = 1e9 * (Seconds() - start) / (iterations * frames.size());
+		if(k == 0)
+		{
+			scalarNs = ns;
+			printf("%-8s : %8.0f ns/frame, %.2f%% of samples changed per frame\n", kernelNames[k], ns, 100.0 * changed / ((double)samples * frames.size()));
+		}
+		else
+		{
+			printf("%-8s : %8.0f ns/frame (%.1fx) %s\n", kernelNames[k], ns, scalarNs / ns, mismatches == 0 ? "bit-exact" : "MISMATCH");
+		}
+		exact = exact && mismatches == 0;
+	}
+
+	return exact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,327 @@
+#ifndef _DEPTH_CODEC_H_
+#define _DEPTH_CODEC_H_
+
+// Header Includes
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Lossless codec for 16 bit depth frames.
+//
+// Each pixel is predicted from the last non-zero pixel to its left (the first non-zero pixel
+// of the row above at the start of a row), and the zigzagged prediction error is written with
+// an adaptive Rice code whose parameter follows the running mean of recent errors, as in
+// LOCO-I. Runs of zero (invalid) pixels, which are common in structured-light depth, are
+// written as a single escape symbol plus an Exp-Golomb run length. Zero pixels don't move the
+// predictor, so the surface either side of a hole predicts well.
+//
+// Encoded frame layout: uint32 width, uint32 height (little-endian), then the bit stream MSB first.
+
+#define DEPTH_CODEC_HEADER_SIZE 8
+// Rice quotients at or above this are escaped and the symbol is written verbatim
+#define DEPTH_CODEC_ESCAPE_QUOTIENT 20
+#define DEPTH_CODEC_LITERAL_BITS 17
+// The adaptive statistics are halved every this many symbols
+#define DEPTH_CODEC_RESET_COUNT 64
+
+// Running statistics that choose the Rice parameter; the decoder keeps an identical copy
+class DepthCodecContext
+{
+public:
+	DepthCodecContext() : m_sum(4), m_count(1)
+	{
+	}
+
+	int riceParameter() const
+	{
+		int k = 0;
+		while((m_count << k) < m_sum && k < DEPTH_CODEC_LITERAL_BITS)
+		{
+			k++;
+		}
+		return k;
+	}
+
+	void update(uint32_t symbol)
+	{
+		m_sum += symbol;
+		if(++m_count == DEPTH_CODEC_RESET_COUNT)
+		{
+			m_sum >>= 1;
+			m_count >>= 1;
+		}
+	}
+
+private:
+	uint32_t m_sum;
+	uint32_t m_count;
+};
+
+class DepthBitWriter
+{
+public:
+	DepthBitWriter(std::vector<uint8_t>& out) : m_out(out), m_acc(0), m_bits(0)
+	{
+	}
+
+	// Appends the low count bits of value, count <= 32
+	void put(uint32_t value, int count)
+	{
+		m_acc = (m_acc << count) | value;
+		m_bits += count;
+		while(m_bits >= 8)
+		{
+			m_bits -= 8;
+			m_out.push_back((uint8_t)(m_acc >> m_bits));
+		}
+	}
+
+	void flush()
+	{
+		if(m_bits > 0)
+		{
+			m_out.push_back((uint8_t)(m_acc << (8 - m_bits)));
+			m_bits = 0;
+		}
+	}
+
+private:
+	std::vector<uint8_t>& m_out;
+	uint64_t m_acc;
+	int m_bits;
+};
+
+class DepthBitReader
+{
+public:
+	DepthBitReader(const uint8_t* data, size_t size) : m_start(data), m_next(data), m_end(data + size), m_acc(0), m_bits(0)
+	{
+	}
+
+	uint32_t get(int count)
+	{
+		if(count == 0)
+		{
+			return 0;
+		}
+		refill();
+		uint32_t value = (uint32_t)(m_acc >> (64 - count));
+		m_acc <<= count;
+		m_bits -= count;
+		return value;
+	}
+
+	// Counts (and consumes) identical leading bits, up to limit
+	int run(bool ones, int limit)
+	{
+		refill();
+		uint64_t bits = ones ? ~m_acc : m_acc;
+		int count = (bits == 0) ? 64 : __builtin_clzll(bits);
+		if(count > limit)
+		{
+			count = limit;
+		}
+		m_acc <<= count;
+		m_bits -= count;
+		return count;
+	}
+
+	void skip(int count)
+	{
+		m_acc <<= count;
+		m_bits -= count;
+	}
+
+	// False once more bits have been consumed than the buffer holds
+	bool valid() const
+	{
+		return (uint64_t)(m_next - m_start) * 8 - m_bits <= (uint64_t)(m_end - m_start) * 8;
+	}
+
+private:
+	// Keeps at least 57 bits in the left-aligned accumulator, padding with zeros past the end
+	void refill()
+	{
+		while(m_bits <= 56)
+		{
+			uint64_t byte = (m_next < m_end) ? *m_next : 0;
+			m_next++;
+			m_acc |= byte << (56 - m_bits);
+			m_bits += 8;
+		}
+	}
+
+	const uint8_t* m_start;
+	const uint8_t* m_next;
+	const uint8_t* m_end;
+	uint64_t m_acc;
+	int m_bits;
+};
+
+inline void DepthCodecPutSymbol(DepthBitWriter& writer, DepthCodecContext& context, uint32_t symbol)
+{
+	int k = context.riceParameter();
+	uint32_t quotient = symbol >> k;
+	if(quotient < DEPTH_CODEC_ESCAPE_QUOTIENT)
+	{
+		// Unary quotient as ones terminated by a zero, then the k remainder bits
+		writer.put(((1u << quotient) - 1) << 1, quotient + 1);
+		writer.put(symbol & ((1u << k) - 1), k);
+	}
+	else
+	{
+		writer.put((1u << DEPTH_CODEC_ESCAPE_QUOTIENT) - 1, DEPTH_CODEC_ESCAPE_QUOTIENT);
+		writer.put(symbol, DEPTH_CODEC_LITERAL_BITS);
+	}
+	context.update(symbol);
+}
+
+inline uint32_t DepthCodecGetSymbol(DepthBitReader& reader, DepthCodecContext& context)
+{
+	int k = context.riceParameter();
+	uint32_t symbol;
+	int quotient = reader.run(true, DEPTH_CODEC_ESCAPE_QUOTIENT);
+	if(quotient < DEPTH_CODEC_ESCAPE_QUOTIENT)
+	{
+		reader.skip(1);
+		symbol = ((uint32_t)quotient << k) | reader.get(k);
+	}
+	else
+	{
+		symbol = reader.get(DEPTH_CODEC_LITERAL_BITS);
+	}
+	context.update(symbol);
+	return symbol;
+}
+
+// Appends the encoding of a width x height depth frame to out and returns its size in bytes
+inline size_t EncodeDepth(const uint16_t* pixels, int width, int height, int strideInBytes, std::vector<uint8_t>& out)
+{
+	size_t start = out.size();
+	uint32_t dimensions[2] = { (uint32_t)width, (uint32_t)height };
+	const uint8_t* header = (const uint8_t*)dimensions;
+	out.insert(out.end(), header, header + DEPTH_CODEC_HEADER_SIZE);
+
+	DepthBitWriter writer(out);
+	DepthCodecContext context;
+	int rowStart = 0;
+
+	for(int y = 0; y < height; y++)
+	{
+		const uint16_t* row = (const uint16_t*)((const uint8_t*)pixels + (size_t)y * strideInBytes);
+		int predictor = rowStart;
+		bool seenValid = false;
+
+		int x = 0;
+		while(x < width)
+		{
+			if(row[x] == 0)
+			{
+				// Symbol 0 starts a run of invalid pixels, limited to the current row
+				int run = 1;
+				while(x + run < width && row[x + run] == 0)
+				{
+					run++;
+				}
+				DepthCodecPutSymbol(writer, context, 0);
+				int bits = 32 - __builtin_clz(run);
+				writer.put(0, bits - 1);
+				writer.put(run, bits);
+				x += run;
+				continue;
+			}
+
+			int error = (int)row[x] - predictor;
+			uint32_t zigzag = (uint32_t)((error << 1) ^ (error >> 31));
+			DepthCodecPutSymbol(writer, context, zigzag + 1);
+
+			predictor = row[x];
+			if(!seenValid)
+			{
+				rowStart = row[x];
+				seenValid = true;
+			}
+			x++;
+		}
+	}
+
+	writer.flush();
+	return out.size() - start;
+}
+
+// Decodes a frame produced by EncodeDepth into pixels, which must hold the frame's height rows
+// of strideInBytes. Returns false if the data is damaged or doesn't match the expected size.
+inline bool DecodeDepth(const uint8_t* data, size_t size, uint16_t* pixels, int width, int height, int strideInBytes)
+{
+	if(size < DEPTH_CODEC_HEADER_SIZE)
+	{
+		return false;
+	}
+	uint32_t dimensions[2];
+	const uint8_t* header = data;
+	for(int i = 0; i < DEPTH_CODEC_HEADER_SIZE; i++)
+	{
+		((uint8_t*)dimensions)[i] = header[i];
+	}
+	if(dimensions[0] != (uint32_t)width || dimensions[1] != (uint32_t)height)
+	{
+		return false;
+	}
+
+	DepthBitReader reader(data + DEPTH_CODEC_HEADER_SIZE, size - DEPTH_CODEC_HEADER_SIZE);
+	DepthCodecContext context;
+	int rowStart = 0;
+
+	for(int y = 0; y < height; y++)
+	{
+		uint16_t* row = (uint16_t*)((uint8_t*)pixels + (size_t)y * strideInBytes);
+		int predictor = rowStart;
+		bool seenValid = false;
+
+		int x = 0;
+		while(x < width)
+		{
+			uint32_t symbol = DepthCodecGetSymbol(reader, context);
+			if(symbol == 0)
+			{
+				int zeros = reader.run(false, 16);
+				int run = (int)reader.get(zeros + 1);
+				if(run == 0 || run > width - x)
+				{
+					return false;
+				}
+				for(int i = 0; i < run; i++)
+				{
+					row[x + i] = 0;
+				}
+				x += run;
+				continue;
+			}
+
+			uint32_t zigzag = symbol - 1;
+			int error = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+			int value = predictor + error;
+			if(value <= 0 || value > 0xFFFF)
+			{
+				return false;
+			}
+			row[x] = (uint16_t)value;
+
+			predictor = value;
+			if(!seenValid)
+			{
+				rowStart = value;
+				seenValid = true;
+			}
+			x++;
+		}
+
+		if(!reader.valid())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+#endif // _DEPTH_CODEC_H_
@@ -0,0 +1,125 @@
+// Header Includes
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "BenchFrames.h"
+#include "DepthCodec.h"
+#include "WorkerPool.h"
+
+#define DEFAULT_THREADS 4
+
+// Namespaces
+using namespace std;
+
+// One depth frame being compressed on the pool
+struct BenchJob
+{
+	const uint16_t* depth;
+	int width;
+	int height;
+	std::vector<uint8_t> encoded;
+};
+
+void EncodeBenchJob(BenchJob& job)
+{
+	job.encoded.clear();
+	EncodeDepth(job.depth, job.width, job.height, job.width * sizeof(uint16_t), job.encoded);
+}
+
+// Measures the lossless depth codec on a recorded session, or on synthetic frames without one:
+// compression ratio, single-threaded encode and decode speed, pooled encode speed, and a bit-exact
+// round trip of every frame.
+int main( const int argc, const char* argv[] )
+{
+	RecordingReader reader;
+	int threads = DEFAULT_THREADS;
+	if(!OpenBenchRecording(argc, argv, reader, threads, "Threads"))
+	{
+		return EXIT_FAILURE;
+	}
+
+	// Benchmark frames, packed without row padding
+	int width = BENCH_LEGACY_RES_X;
+	int height = BENCH_LEGACY_RES_Y;
+	std::vector< std::vector<uint16_t> > frames;
+	ReadBenchFrames(reader, RECORDING_STREAM_DEPTH, width, height, frames);
+	if(frames.empty())
+	{
+		SyntheticDepthFrames(width, height, frames);
+	}
+	cout << "Depth frames : " << frames.size() << " (" << width << "x" << height << ")" << endl;
+
+	uint64_t rawBytes = (uint64_t)frames.size() * width * height * sizeof(uint16_t);
+	unsigned long zeros = 0;
+	for(size_t i = 0; i < frames.size(); i++)
+	{
+		for(size_t p = 0; p < frames[i].size(); p++)
+		{
+			zeros += (frames[i][p] == 0);
+		}
+	}
+
+	// Single-threaded encode
+	std::vector< std::vector<uint8_t> > encoded(frames.size());
+	uint64_t encodedBytes = 0;
+	double start = Seconds();
+	for(size_t i = 0; i < frames.size(); i++)
+	{
+		encodedBytes += EncodeDepth(&frames[i][0], width, height, width * sizeof(uint16_t), encoded[i]);
+	}
+	double encodeTime = Seconds() - start;
+
+	// Single-threaded decode, checked against the original
+	std::vector<uint16_t> decoded(width * height);
+	unsigned long mismatches = 0;
+	double decodeTime = 0;
+	for(size_t i = 0; i < frames.size(); i++)
+	{
+		start = Seconds();
+		bool ok = DecodeDepth(&encoded[i][0], encoded[i].size(), &decoded[0], width, height, width * sizeof(uint16_t));
+		decodeTime += Seconds() - start;
+
+		if(!ok || decoded != frames[i])
+		{
+			mismatches++;
+		}
+	}
+
+	// Pooled encode, as used by CaptureImageDepthData --compress-depth
+	start = Seconds();
+	{
+		OrderedWorkerPool<BenchJob> pool(threads, threads * 4, EncodeBenchJob);
+		size_t submitted = 0;
+		BenchJob job;
+		while(submitted < frames.size())
+		{
+			if(pool.full())
+			{
+				pool.next(job, true);
+			}
+			BenchJob next;
+			next.depth = &frames[submitted++][0];
+			next.width = width;
+			next.height = height;
+			pool.submit(std::move(next));
+		}
+		while(pool.next(job, true))
+		{
+		}
+	}
+	double poolTime = Seconds() - start;
+
+	double rawMB = rawBytes / 1048576.0;
+	printf("Invalid (zero) pixels : %.1f%%\n", 100.0 * zeros / (rawBytes / sizeof(uint16_t)));
+	printf("Compressed %.1f MB to %.1f MB : ratio %.2fx, %.2f bits/pixel\n", rawMB, encodedBytes / 1048576.0,
+		(double)rawBytes / encodedBytes, 8.0 * encodedBytes / (rawBytes / sizeof(uint16_t)));
+	printf("Encode, 1 thread : %.1f MB/s (%.2f ms/frame)\n", rawMB / encodeTime, 1000.0 * encodeTime / frames.size());
+	printf("Decode, 1 thread : %.1f MB/s (%.2f ms/frame)\n", rawMB / decodeTime, 1000.0 * decodeTime / frames.size());
+	printf("Encode, %d threads : %.1f MB/s (%.1f frames/s)\n", threads, rawMB / poolTime, frames.size() / poolTime);
+	printf("Round trip : %s (%lu of %lu frames differ)\n", mismatches == 0 ? "bit-exact" : "FAILED", mismatches, (unsigned long)frames.size());
+
+	return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
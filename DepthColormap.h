@@ -0,0 +1,180 @@
+#ifndef _DEPTH_COLORMAP_H_
+#define _DEPTH_COLORMAP_H_
+
+// Header Includes
+#include <immintrin.h>
+#include <stdint.h>
+#include <vector>
+
+// Colormaps for depth display
+enum DepthColormap
+{
+	DEPTH_COLORMAP_RAINBOW,	// White through red, yellow, green, cyan, blue to black, 256 steps per band
+	DEPTH_COLORMAP_GRAY	// Near is bright, fading to black over 256 steps; invalid pixels are black
+};
+
+#define DEFAULT_DEPTH_COLORMAP_SCALE 5
+
+// Turns depth frames into BGR display images through a 64K-entry lookup table, so each pixel
+// costs one table load instead of two divisions and a branch. The table is rebuilt whenever the
+// colormap or scale (millimetres per colormap step) changes. Rows are converted by an AVX2
+// gather kernel, an SSSE3 shuffle kernel or plain C, picked at runtime from what the CPU has.
+class DepthColorizer
+{
+public:
+	enum Kernel
+	{
+		KERNEL_AUTO,
+		KERNEL_SCALAR,
+		KERNEL_SSSE3,
+		KERNEL_AVX2
+	};
+
+	DepthColorizer(DepthColormap colormap = DEPTH_COLORMAP_RAINBOW, int scale = DEFAULT_DEPTH_COLORMAP_SCALE) : m_lut(65536)
+	{
+		configure(colormap, scale);
+		setKernel(KERNEL_AUTO);
+	}
+
+	void configure(DepthColormap colormap, int scale)
+	{
+		if(scale < 1)
+		{
+			scale = 1;
+		}
+		m_colormap = colormap;
+		m_scale = scale;
+		for(int depth = 0; depth < 65536; depth++)
+		{
+			m_lut[depth] = (colormap == DEPTH_COLORMAP_GRAY) ? grayEntry(depth, scale) : rainbowEntry(depth, scale);
+		}
+	}
+
+	// Forces a particular kernel, e.g. for benchmarking. Returns false if the CPU can't run it.
+	bool setKernel(Kernel kernel)
+	{
+		bool avx2 = __builtin_cpu_supports("avx2");
+		bool ssse3 = __builtin_cpu_supports("ssse3");
+		if(kernel == KERNEL_AUTO)
+		{
+			kernel = avx2 ? KERNEL_AVX2 : ssse3 ? KERNEL_SSSE3 : KERNEL_SCALAR;
+		}
+		if((kernel == KERNEL_AVX2 && !avx2) || (kernel == KERNEL_SSSE3 && !ssse3))
+		{
+			return false;
+		}
+		m_kernel = kernel;
+		return true;
+	}
+
+	// Colorizes a width x height depth image into packed BGR rows
+	void colorize(const uint16_t* depth, int width, int height, int depthStrideInBytes, uint8_t* bgr, int bgrStrideInBytes) const
+	{
+		for(int y = 0; y < height; y++)
+		{
+			const uint16_t* depthRow = (const uint16_t*)((const uint8_t*)depth + (size_t)y * depthStrideInBytes);
+			uint8_t* bgrRow = bgr + (size_t)y * bgrStrideInBytes;
+			switch(m_kernel)
+			{
+				case KERNEL_AVX2:
+					colorizeRowAvx2(&m_lut[0], depthRow, bgrRow, width);
+					break;
+				case KERNEL_SSSE3:
+					colorizeRowSsse3(&m_lut[0], depthRow, bgrRow, width);
+					break;
+				default:
+					colorizeRowScalar(&m_lut[0], depthRow, bgrRow, 0, width);
+					break;
+			}
+		}
+	}
+
+	DepthColormap colormap() const { return m_colormap; }
+	int scale() const { return m_scale; }
+	Kernel kernel() const { return m_kernel; }
+
+private:
+	// Table entries are little-endian B, G, R, 0 so a 4-byte load yields one pixel
+	static uint32_t pack(int b, int g, int r)
+	{
+		return (uint32_t)b | ((uint32_t)g << 8) | ((uint32_t)r << 16);
+	}
+
+	static uint32_t rainbowEntry(int depth, int scale)
+	{
+		int lb = (depth / scale) % 256;
+		int ub = depth / scale / 256;
+		switch(ub)
+		{
+			case 0: return pack(255 - lb, 255 - lb, 255);
+			case 1: return pack(0, lb, 255);
+			case 2: return pack(0, 255, 255 - lb);
+			case 3: return pack(lb, 255, 0);
+			case 4: return pack(255, 255 - lb, 0);
+			case 5: return pack(255 - lb, 0, 0);
+			default: return pack(0, 0, 0);
+		}
+	}
+
+	static uint32_t grayEntry(int depth, int scale)
+	{
+		if(depth == 0)
+		{
+			return pack(0, 0, 0);
+		}
+		int step = depth / scale;
+		int gray = 255 - (step > 255 ? 255 : step);
+		return pack(gray, gray, gray);
+	}
+
+	static void colorizeRowScalar(const uint32_t* lut, const uint16_t* depth, uint8_t* bgr, int x, int width)
+	{
+		for(; x < width; x++)
+		{
+			uint32_t pixel = lut[depth[x]];
+			bgr[x * 3 + 0] = (uint8_t)pixel;
+			bgr[x * 3 + 1] = (uint8_t)(pixel >> 8);
+			bgr[x * 3 + 2] = (uint8_t)(pixel >> 16);
+		}
+	}
+
+	// Four table loads packed from 16 to 12 bytes with pshufb. Each store writes 4 bytes past
+	// the pixels it covers, so the vector loop stops early enough to stay inside the row.
+	__attribute__((target("ssse3")))
+	static void colorizeRowSsse3(const uint32_t* lut, const uint16_t* depth, uint8_t* bgr, int width)
+	{
+		const __m128i squeeze = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		int x = 0;
+		for(; x + 6 <= width; x += 4)
+		{
+			__m128i pixels = _mm_setr_epi32(lut[depth[x]], lut[depth[x + 1]], lut[depth[x + 2]], lut[depth[x + 3]]);
+			_mm_storeu_si128((__m128i*)(bgr + x * 3), _mm_shuffle_epi8(pixels, squeeze));
+		}
+		colorizeRowScalar(lut, depth, bgr, x, width);
+	}
+
+	// Eight pixels per step: widen the depth values to indices, gather the table entries, then
+	// squeeze each 128-bit lane to 12 bytes. Same overhang rule as the SSSE3 kernel.
+	__attribute__((target("avx2")))
+	static void colorizeRowAvx2(const uint32_t* lut, const uint16_t* depth, uint8_t* bgr, int width)
+	{
+		const __m256i squeeze = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		int x = 0;
+		for(; x + 10 <= width; x += 8)
+		{
+			__m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(depth + x)));
+			__m256i pixels = _mm256_shuffle_epi8(_mm256_i32gather_epi32((const int*)lut, index, 4), squeeze);
+			_mm_storeu_si128((__m128i*)(bgr + x * 3), _mm256_castsi256_si128(pixels));
+			_mm_storeu_si128((__m128i*)(bgr + x * 3 + 12), _mm256_extracti128_si256(pixels, 1));
+		}
+		colorizeRowScalar(lut, depth, bgr, x, width);
+	}
+
+	std::vector<uint32_t> m_lut;
+	DepthColormap m_colormap;
+	int m_scale;
+	Kernel m_kernel;
+};
+
+#endif // _DEPTH_COLORMAP_H_
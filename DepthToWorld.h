@@ -0,0 +1,196 @@
+#ifndef _DEPTH_TO_WORLD_H_
+#define _DEPTH_TO_WORLD_H_
+
+// Header Includes
+#include <emmintrin.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "PointCloudFormat.h"
+#include "RecordingFormat.h"
+
+// Field of view of the PrimeSense depth camera, in radians, for drivers that don't report one
+#define DEFAULT_DEPTH_FOV_H 1.022600
+#define DEFAULT_DEPTH_FOV_V 0.796616
+
+// The zero plane pixel size is given for the 1280 pixel wide sensor grid
+#define ZERO_PLANE_REFERENCE_WIDTH 1280
+
+// Converts whole depth frames to XYZ points in millimetres, matching
+// openni::CoordinateConverter::convertDepthToWorld without a call per pixel. Depth in other
+// units, e.g. 100um, is scaled to millimetres by the depth unit.
+// A pinhole camera's ray through pixel (u, v) has direction (rayX[u], rayY[v], 1), so the
+// tables are one entry per column and one per row, built once per video mode; each point is
+// then just its depth times the ray. Invalid (zero) depth gives the point (0, 0, 0).
+class DepthToWorld
+{
+public:
+	DepthToWorld() : m_width(0), m_height(0), m_depthUnit(1)
+	{
+	}
+
+	// Millimetres per depth value, 1 for PIXEL_FORMAT_DEPTH_1_MM and 0.1 for PIXEL_FORMAT_DEPTH_100_UM
+	void setDepthUnit(float millimetres)
+	{
+		m_depthUnit = millimetres;
+	}
+
+	// Builds the ray tables from the horizontal and vertical field of view in radians
+	void configure(int width, int height, double horizontalFov, double verticalFov)
+	{
+		m_width = width;
+		m_height = height;
+		m_rayX.resize(width);
+		m_rayY.resize(height);
+
+		// The same single precision steps as OpenNI's converter
+		float xzFactor = (float)(tan(horizontalFov / 2) * 2);
+		float yzFactor = (float)(tan(verticalFov / 2) * 2);
+		for(int u = 0; u < width; u++)
+		{
+			m_rayX[u] = ((float)u / width - .5f) * xzFactor;
+		}
+		for(int v = 0; v < height; v++)
+		{
+			m_rayY[v] = (.5f - (float)v / height) * yzFactor;
+		}
+	}
+
+	// Builds the ray tables from the PS1080 ZERO_PLANE_DISTANCE (mm) and ZERO_PLANE_PIXEL_SIZE
+	// (mm per pixel on the full sensor grid) properties. Returns false if they are missing.
+	bool configureZeroPlane(int width, int height, double zeroPlaneDistance, double zeroPlanePixelSize)
+	{
+		if(zeroPlaneDistance <= 0 || zeroPlanePixelSize <= 0)
+		{
+			return false;
+		}
+		double pixelSize = zeroPlanePixelSize * ZERO_PLANE_REFERENCE_WIDTH / width;
+		configure(width, height, 2 * atan(pixelSize * width / 2 / zeroPlaneDistance), 2 * atan(pixelSize * height / 2 / zeroPlaneDistance));
+		return true;
+	}
+
+	// Builds the ray tables for the depth stream of a recording: its field of view if the driver
+	// reported one, else the zero plane intrinsics, else the PrimeSense defaults. Takes the depth
+	// unit from the stream's pixel format.
+	void configure(const RecordingHeader& header)
+	{
+		const RecordingStreamInfo& depth = header.streams[RECORDING_STREAM_DEPTH];
+		setDepthUnit(depth.pixelFormat == RECORDING_PIXEL_FORMAT_DEPTH_100_UM ? 0.1f : 1.0f);
+		if(depth.horizontalFov > 0 && depth.verticalFov > 0)
+		{
+			configure(depth.width, depth.height, depth.horizontalFov, depth.verticalFov);
+		}
+		else if(!configureZeroPlane(depth.width, depth.height, header.zeroPlaneDistance, header.zeroPlanePixelSize))
+		{
+			configure(depth.width, depth.height, DEFAULT_DEPTH_FOV_H, DEFAULT_DEPTH_FOV_V);
+		}
+	}
+
+	// Converts a frame of the configured size into width * height packed x, y, z triples
+	void convert(const uint16_t* depth, int depthStrideInBytes, float* xyz) const
+	{
+		for(int v = 0; v < m_height; v++)
+		{
+			const uint16_t* depthRow = (const uint16_t*)((const uint8_t*)depth + (size_t)v * depthStrideInBytes);
+			convertRow(v, depthRow, xyz + (size_t)v * m_width * 3);
+		}
+	}
+
+	// Converts row v of a frame into width packed x, y, z triples. Four points per step: x and y
+	// are the depths times the ray components, then the three vectors are interleaved into
+	// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 for three stores.
+	void convertRow(int v, const uint16_t* depth, float* xyz) const
+	{
+		const float rayY = m_rayY[v];
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 ry = _mm_set1_ps(rayY);
+		const __m128 unit = _mm_set1_ps(m_depthUnit);
+		int u = 0;
+		for(; u + 4 <= m_width; u += 4)
+		{
+			__m128 z = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(depth + u)), zero)), unit);
+			__m128 x = _mm_mul_ps(_mm_loadu_ps(&m_rayX[u]), z);
+			__m128 y = _mm_mul_ps(ry, z);
+
+			__m128 xyLow = _mm_unpacklo_ps(x, y);	// x0 y0 x1 y1
+			__m128 xyHigh = _mm_unpackhi_ps(x, y);	// x2 y2 x3 y3
+			__m128 z0x1 = _mm_shuffle_ps(z, xyLow, _MM_SHUFFLE(2, 2, 0, 0));
+			__m128 y1z1 = _mm_shuffle_ps(xyLow, z, _MM_SHUFFLE(1, 1, 3, 3));
+			__m128 z2x3 = _mm_shuffle_ps(z, xyHigh, _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 y3z3 = _mm_shuffle_ps(xyHigh, z, _MM_SHUFFLE(3, 3, 3, 3));
+			_mm_storeu_ps(xyz + u * 3, _mm_shuffle_ps(xyLow, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(xyz + u * 3 + 4, _mm_shuffle_ps(y1z1, xyHigh, _MM_SHUFFLE(1, 0, 2, 0)));
+			_mm_storeu_ps(xyz + u * 3 + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+		}
+		for(; u < m_width; u++)
+		{
+			float z = depth[u] * m_depthUnit;
+			xyz[u * 3 + 0] = m_rayX[u] * z;
+			xyz[u * 3 + 1] = rayY * z;
+			xyz[u * 3 + 2] = z;
+		}
+	}
+
+	// One point, for spot checks and sparse lookups
+	void point(int u, int v, uint16_t depth, float* x, float* y, float* z) const
+	{
+		float millimetres = depth * m_depthUnit;
+		*x = m_rayX[u] * millimetres;
+		*y = m_rayY[v] * millimetres;
+		*z = millimetres;
+	}
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	float depthUnit() const { return m_depthUnit; }
+
+private:
+	int m_width;
+	int m_height;
+	float m_depthUnit;
+	std::vector<float> m_rayX;
+	std::vector<float> m_rayY;
+};
+
+// Builds the colored points of one frame pair into points, which must hold width * height
+// entries, and returns how many were written. Organized clouds keep every pixel in row-major
+// order, with NaN coordinates where depth is invalid; otherwise invalid pixels are left out.
+// Colors are taken from the RGB888 color image at the same relative position as each depth
+// pixel, which is exact when the device registers depth to color.
+inline uint32_t BuildColoredCloud(const DepthToWorld& converter, const uint16_t* depth, int depthStrideInBytes,
+	const uint8_t* rgb, int colorWidth, int colorHeight, int colorStrideInBytes, bool organized, PointXYZRGB* points)
+{
+	int width = converter.width();
+	int height = converter.height();
+	std::vector<float> xyz(width * 3);
+	uint32_t count = 0;
+	for(int v = 0; v < height; v++)
+	{
+		const uint16_t* depthRow = (const uint16_t*)((const uint8_t*)depth + (size_t)v * depthStrideInBytes);
+		const uint8_t* colorRow = rgb + (size_t)(v * colorHeight / height) * colorStrideInBytes;
+		converter.convertRow(v, depthRow, &xyz[0]);
+		for(int u = 0; u < width; u++)
+		{
+			if(depthRow[u] == 0)
+			{
+				if(!organized)
+				{
+					continue;
+				}
+				xyz[u * 3 + 0] = xyz[u * 3 + 1] = xyz[u * 3 + 2] = NAN;
+			}
+			const uint8_t* color = colorRow + (u * colorWidth / width) * 3;
+			PointXYZRGB& point = points[count++];
+			point.x = xyz[u * 3 + 0];
+			point.y = xyz[u * 3 + 1];
+			point.z = xyz[u * 3 + 2];
+			point.r = color[0];
+			point.g = color[1];
+			point.b = color[2];
+		}
+	}
+	return count;
+}
+
+#endif // _DEPTH_TO_WORLD_H_
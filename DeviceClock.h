@@ -0,0 +1,55 @@
+#ifndef _DEVICE_CLOCK_H_
+#define _DEVICE_CLOCK_H_
+
+// Header Includes
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+// The host's monotonic clock (CLOCK_MONOTONIC on Linux) in microseconds. Every device, thread and
+// process on the machine reads the same clock, so it is the common timeline for multi-sensor rigs.
+inline uint64_t HostClockMicroseconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Maps one device's frame timestamps onto the host clock. Each sensor counts time from its own
+// power-on, so raw timestamps can't be compared across devices. A frame can only reach the host
+// after the device stamped it, so host arrival time minus device timestamp is the clock offset
+// plus some transfer and scheduling delay; the smallest difference seen is the best estimate of
+// the offset, and converting with it gives host times free of USB and thread jitter.
+class DeviceClock
+{
+public:
+	DeviceClock() : m_offset(INT64_MAX)
+	{
+	}
+
+	// Call as soon as a frame has been read from the driver. Safe from any thread.
+	void observe(uint64_t deviceTimestamp)
+	{
+		int64_t offset = (int64_t)(HostClockMicroseconds() - deviceTimestamp);
+		int64_t current = m_offset.load(std::memory_order_relaxed);
+		while(offset < current && !m_offset.compare_exchange_weak(current, offset, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	// Host time of a device timestamp, or 0 before any frame has been observed
+	uint64_t toHost(uint64_t deviceTimestamp) const
+	{
+		int64_t offset = m_offset.load(std::memory_order_relaxed);
+		return (offset == INT64_MAX) ? 0 : (uint64_t)(deviceTimestamp + offset);
+	}
+
+	// Forgets the offset, e.g. when the device has been reset and its timestamps start over
+	void reset()
+	{
+		m_offset.store(INT64_MAX, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<int64_t> m_offset;
+};
+
+#endif // _DEVICE_CLOCK_H_
@@ -0,0 +1,510 @@
+#ifndef _DIRECT_FILE_H_
+#define _DIRECT_FILE_H_
+
+// Header Includes
+#include <atomic>
+#include <condition_variable>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// io_uring is used when the kernel headers know it and the running kernel allows it; older
+// systems, and sandboxes that filter the syscalls, get the I/O thread instead
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define DIRECT_FILE_HAVE_IO_URING 1
+#endif
+#endif
+
+// O_DIRECT needs the memory, file offset and length of every write aligned to the device's
+// logical block size; 4 KiB covers every current disk
+#define DIRECT_FILE_ALIGNMENT 4096
+// Each buffer holds a couple of VGA frame pairs, so one submission carries several frames
+#define DIRECT_FILE_BUFFER_SIZE (4 << 20)
+#define DIRECT_FILE_BUFFERS 8
+
+// A sequentially written output file that bypasses the page cache. Data is copied once into a
+// pool of aligned buffers; every full buffer is written asynchronously (io_uring, else a
+// dedicated I/O thread) while the caller fills the next one, so the caller only waits when the
+// disk is a whole pool behind. Falls back to cached I/O on filesystems without O_DIRECT
+// (e.g. tmpfs). Used from a single thread.
+class DirectFile
+{
+public:
+	DirectFile() :
+		m_fd(-1), m_direct(false), m_bufferSize(0), m_current(-1), m_fill(0), m_fileOffset(0), m_inflight(0), m_error(0), m_stopping(false)
+#ifdef DIRECT_FILE_HAVE_IO_URING
+		, m_ringFd(-1), m_sqRing(NULL), m_cqRing(NULL), m_sqes(NULL)
+#endif
+	{
+	}
+
+	~DirectFile()
+	{
+		close();
+	}
+
+	// Creates (or truncates) the file and sets up the buffers and the write backend. Returns
+	// false with errno set if the file can't be created.
+	bool open(const char* fileName, size_t bufferSize = DIRECT_FILE_BUFFER_SIZE, int buffers = DIRECT_FILE_BUFFERS)
+	{
+		m_fd = ::open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+		m_direct = (m_fd >= 0);
+		if(m_fd < 0 && errno == EINVAL)
+		{
+			m_fd = ::open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		}
+		if(m_fd < 0)
+		{
+			return false;
+		}
+
+		m_bufferSize = (bufferSize + DIRECT_FILE_ALIGNMENT - 1) & ~(size_t)(DIRECT_FILE_ALIGNMENT - 1);
+		m_buffers.resize(buffers > 1 ? buffers : 2);
+		m_lengths.resize(m_buffers.size());
+		m_iovecs.resize(m_buffers.size());
+		for(size_t i = 0; i < m_buffers.size(); i++)
+		{
+			if(posix_memalign(&m_buffers[i], DIRECT_FILE_ALIGNMENT, m_bufferSize) != 0)
+			{
+				m_buffers.resize(i);
+				close();
+				errno = ENOMEM;
+				return false;
+			}
+			m_free.push_back((int)i);
+		}
+
+		m_current = -1;
+		m_fill = 0;
+		m_fileOffset = 0;
+		m_inflight = 0;
+		m_error = 0;
+#ifdef DIRECT_FILE_HAVE_IO_URING
+		if(setupRing((unsigned)m_buffers.size()))
+		{
+			return true;
+		}
+#endif
+		m_stopping = false;
+		m_thread = std::thread(&DirectFile::writeLoop, this);
+		return true;
+	}
+
+	// Appends data. Returns false with errno set once any write has failed.
+	bool write(const void* data, size_t size)
+	{
+		const char* p = (const char*)data;
+		while(size > 0)
+		{
+			if(m_error != 0)
+			{
+				errno = m_error;
+				return false;
+			}
+			if(m_current < 0)
+			{
+				m_current = acquireBuffer();
+				m_fill = 0;
+			}
+
+			size_t chunk = (size < m_bufferSize - m_fill) ? size : m_bufferSize - m_fill;
+			memcpy((char*)m_buffers[m_current] + m_fill, p, chunk);
+			m_fill += chunk;
+			p += chunk;
+			size -= chunk;
+
+			if(m_fill == m_bufferSize)
+			{
+				submit(m_current, m_fileOffset, m_bufferSize);
+				m_fileOffset += m_bufferSize;
+				m_current = -1;
+				m_fill = 0;
+			}
+		}
+		return true;
+	}
+
+	// Waits for every write, writes the partly filled buffer and flushes the file to the disk.
+	// The partial block is written again, complete, once the buffer fills.
+	bool sync()
+	{
+		if(m_fd < 0)
+		{
+			return true;
+		}
+		return writeTail() && fdatasync(m_fd) == 0;
+	}
+
+	// Writes what is left, trims the block padding off the end and closes the file. Safe to
+	// call more than once.
+	bool close()
+	{
+		if(m_fd < 0)
+		{
+			freeBuffers();
+			return true;
+		}
+
+		bool ok = !m_buffers.empty() && writeTail() && ftruncate(m_fd, size()) == 0;
+		stopBackend();
+		ok = (::close(m_fd) == 0) && ok;
+		m_fd = -1;
+		freeBuffers();
+		return ok;
+	}
+
+	// Bytes written so far, including those still in the buffers
+	uint64_t size() const { return m_fileOffset + m_fill; }
+	bool direct() const { return m_direct; }
+	int descriptor() const { return m_fd; }
+
+	// How the file is being written, e.g. "O_DIRECT, io_uring"
+	const char* describe() const
+	{
+#ifdef DIRECT_FILE_HAVE_IO_URING
+		if(m_ringFd >= 0)
+		{
+			return m_direct ? "O_DIRECT, io_uring" : "cached, io_uring";
+		}
+#endif
+		return m_direct ? "O_DIRECT, I/O thread" : "cached, I/O thread";
+	}
+
+private:
+	DirectFile(const DirectFile&);
+	DirectFile& operator=(const DirectFile&);
+
+	// Waits for every submitted buffer, then writes the current one padded to whole blocks
+	bool writeTail()
+	{
+		waitAll();
+		if(m_error == 0 && m_current >= 0 && m_fill > 0)
+		{
+			size_t length = (m_fill + DIRECT_FILE_ALIGNMENT - 1) & ~(size_t)(DIRECT_FILE_ALIGNMENT - 1);
+			memset((char*)m_buffers[m_current] + m_fill, 0, length - m_fill);
+			writeAll(m_buffers[m_current], length, m_fileOffset);
+		}
+		errno = m_error;
+		return m_error == 0;
+	}
+
+	// pwrite()s a whole buffer, recording the first error
+	void writeAll(const void* buffer, size_t length, uint64_t offset)
+	{
+		const char* p = (const char*)buffer;
+		while(length > 0)
+		{
+			ssize_t written = pwrite(m_fd, p, length, offset);
+			if(written < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if(written <= 0)
+			{
+				int expected = 0;
+				m_error.compare_exchange_strong(expected, written < 0 ? errno : ENOSPC);
+				return;
+			}
+			p += written;
+			offset += written;
+			length -= written;
+		}
+	}
+
+	// Takes a free buffer, waiting for the oldest write to finish if there is none
+	int acquireBuffer()
+	{
+#ifdef DIRECT_FILE_HAVE_IO_URING
+		if(m_ringFd >= 0)
+		{
+			while(m_free.empty())
+			{
+				reapRing(true);
+			}
+			int buffer = m_free.back();
+			m_free.pop_back();
+			return buffer;
+		}
+#endif
+		std::unique_lock<std::mutex> lock(m_lock);
+		while(m_free.empty())
+		{
+			m_done.wait(lock);
+		}
+		int buffer = m_free.back();
+		m_free.pop_back();
+		return buffer;
+	}
+
+	void submit(int buffer, uint64_t offset, size_t length)
+	{
+		m_lengths[buffer] = length;
+#ifdef DIRECT_FILE_HAVE_IO_URING
+		if(m_ringFd >= 0)
+		{
+			submitRing(buffer, offset, length);
+			return;
+		}
+#endif
+		std::lock_guard<std::mutex> lock(m_lock);
+		WriteJob job = { buffer, offset };
+		m_queue.push_back(job);
+		m_inflight++;
+		m_queued.notify_one();
+	}
+
+	void waitAll()
+	{
+#ifdef DIRECT_FILE_HAVE_IO_URING
+		if(m_ringFd >= 0)
+		{
+			while(m_inflight > 0)
+			{
+				reapRing(true);
+			}
+			return;
+		}
+#endif
+		std::unique_lock<std::mutex> lock(m_lock);
+		while(m_inflight > 0)
+		{
+			m_done.wait(lock);
+		}
+	}
+
+	// I/O thread backend: writes queued buffers in order and hands them back
+	void writeLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		while(true)
+		{
+			while(m_queue.empty() && !m_stopping)
+			{
+				m_queued.wait(lock);
+			}
+			if(m_queue.empty())
+			{
+				return;
+			}
+			WriteJob job = m_queue.front();
+			m_queue.erase(m_queue.begin());
+			bool failed = (m_error != 0);
+			lock.unlock();
+
+			// Once a write has failed the rest of the file is useless; just recycle the buffers
+			if(!failed)
+			{
+				writeAll(m_buffers[job.buffer], m_lengths[job.buffer], job.offset);
+			}
+
+			lock.lock();
+			m_free.push_back(job.buffer);
+			m_inflight--;
+			m_done.notify_all();
+		}
+	}
+
+	void stopBackend()
+	{
+#ifdef DIRECT_FILE_HAVE_IO_URING
+		if(m_ringFd >= 0)
+		{
+			waitAll();
+			closeRing();
+			return;
+		}
+#endif
+		if(m_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				m_stopping = true;
+				m_queued.notify_one();
+			}
+			m_thread.join();
+		}
+	}
+
+	void freeBuffers()
+	{
+		for(size_t i = 0; i < m_buffers.size(); i++)
+		{
+			free(m_buffers[i]);
+		}
+		m_buffers.clear();
+		m_free.clear();
+		m_current = -1;
+	}
+
+#ifdef DIRECT_FILE_HAVE_IO_URING
+	// Creates a ring with one entry per buffer and maps its queues. Returns false if the kernel
+	// has no io_uring or doesn't let this process use it.
+	bool setupRing(unsigned entries)
+	{
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		m_ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+		if(m_ringFd < 0)
+		{
+			return false;
+		}
+
+		m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+		m_sqRing = mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+		m_cqRing = mmap(NULL, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+		m_sqes = (struct io_uring_sqe*)mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+		if(m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || m_sqes == (struct io_uring_sqe*)MAP_FAILED)
+		{
+			closeRing();
+			return false;
+		}
+
+		char* sq = (char*)m_sqRing;
+		char* cq = (char*)m_cqRing;
+		m_sqTail = (unsigned*)(sq + params.sq_off.tail);
+		m_sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+		m_sqArray = (unsigned*)(sq + params.sq_off.array);
+		m_cqHead = (unsigned*)(cq + params.cq_off.head);
+		m_cqTail = (unsigned*)(cq + params.cq_off.tail);
+		m_cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+		m_cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+		return true;
+	}
+
+	void closeRing()
+	{
+		if(m_sqRing != NULL && m_sqRing != MAP_FAILED)
+		{
+			munmap(m_sqRing, m_sqRingSize);
+		}
+		if(m_cqRing != NULL && m_cqRing != MAP_FAILED)
+		{
+			munmap(m_cqRing, m_cqRingSize);
+		}
+		if(m_sqes != NULL && m_sqes != (struct io_uring_sqe*)MAP_FAILED)
+		{
+			munmap(m_sqes, m_sqesSize);
+		}
+		m_sqRing = m_cqRing = NULL;
+		m_sqes = NULL;
+		::close(m_ringFd);
+		m_ringFd = -1;
+	}
+
+	// Queues one buffer write and tells the kernel. There are as many entries as buffers, so
+	// the submission queue can't overflow.
+	void submitRing(int buffer, uint64_t offset, size_t length)
+	{
+		m_iovecs[buffer].iov_base = m_buffers[buffer];
+		m_iovecs[buffer].iov_len = length;
+
+		unsigned tail = *m_sqTail;
+		unsigned index = tail & m_sqMask;
+		struct io_uring_sqe* sqe = &m_sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_WRITEV;
+		sqe->fd = m_fd;
+		sqe->addr = (uint64_t)(uintptr_t)&m_iovecs[buffer];
+		sqe->len = 1;
+		sqe->off = offset;
+		sqe->user_data = (uint64_t)buffer;
+		m_sqArray[index] = index;
+		__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+		m_inflight++;
+
+		while(syscall(__NR_io_uring_enter, m_ringFd, 1, 0, 0, NULL, 0) < 0 && errno == EINTR)
+		{
+		}
+	}
+
+	// Hands back the buffers of finished writes, optionally waiting for at least one
+	void reapRing(bool wait)
+	{
+		unsigned head = *m_cqHead;
+		if(wait && head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+		{
+			syscall(__NR_io_uring_enter, m_ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		}
+		while(head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+		{
+			struct io_uring_cqe* cqe = &m_cqes[head & m_cqMask];
+			int buffer = (int)cqe->user_data;
+			if(m_error == 0 && cqe->res < 0)
+			{
+				m_error = -cqe->res;
+			}
+			else if(m_error == 0 && (size_t)cqe->res != m_lengths[buffer])
+			{
+				// A short write only happens when the disk is full
+				m_error = ENOSPC;
+			}
+			m_free.push_back(buffer);
+			m_inflight--;
+			head++;
+		}
+		__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+	}
+#endif
+
+	struct WriteJob
+	{
+		int buffer;
+		uint64_t offset;
+	};
+
+	int m_fd;
+	bool m_direct;
+	size_t m_bufferSize;
+	std::vector<void*> m_buffers;
+	std::vector<size_t> m_lengths;
+	std::vector<struct iovec> m_iovecs;
+	// Buffer being filled, -1 for none, and how full it is
+	int m_current;
+	size_t m_fill;
+	// Where the buffer being filled goes in the file
+	uint64_t m_fileOffset;
+
+	// Shared with the I/O thread
+	std::mutex m_lock;
+	std::condition_variable m_queued;
+	std::condition_variable m_done;
+	std::vector<int> m_free;
+	std::vector<WriteJob> m_queue;
+	int m_inflight;
+	// First write error (errno), set by whichever thread hit it
+	std::atomic<int> m_error;
+	bool m_stopping;
+	std::thread m_thread;
+
+#ifdef DIRECT_FILE_HAVE_IO_URING
+	int m_ringFd;
+	void* m_sqRing;
+	void* m_cqRing;
+	struct io_uring_sqe* m_sqes;
+	size_t m_sqRingSize;
+	size_t m_cqRingSize;
+	size_t m_sqesSize;
+	unsigned* m_sqTail;
+	unsigned m_sqMask;
+	unsigned* m_sqArray;
+	unsigned* m_cqHead;
+	unsigned* m_cqTail;
+	unsigned m_cqMask;
+	struct io_uring_cqe* m_cqes;
+#endif
+};
+
+#endif // _DIRECT_FILE_H_
@@ -0,0 +1,193 @@
+#ifndef _EVENT_TRIGGER_H_
+#define _EVENT_TRIGGER_H_
+
+// Header Includes
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "DepthChange.h"
+
+// Part of the depth image the change detector watches; a zero width or height means the whole image
+struct TriggerRegion
+{
+	TriggerRegion() : x(0), y(0), width(0), height(0)
+	{
+	}
+
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+// Parses "X,Y,W,H" in pixels. Returns false on a malformed or empty region.
+inline bool ParseTriggerRegion(const char* text, TriggerRegion& region)
+{
+	char end;
+	if(sscanf(text, "%d,%d,%d,%d%c", &region.x, &region.y, &region.width, &region.height, &end) != 4)
+	{
+		return false;
+	}
+	return region.x >= 0 && region.y >= 0 && region.width > 0 && region.height > 0;
+}
+
+// Detects movement in a region of the depth image by comparing each frame with a running background
+// of the scene, on a grid of every other pixel of every other row (see DepthChange.h). A sample has
+// changed when its depth moved from the background by more than the threshold plus about 3% of the
+// distance; samples without a reading are ignored, so flickering holes and shadows don't count. The
+// frame changed when at least the given fraction of the region's samples did. Whatever stays put
+// fades into the background within a second or two.
+class DepthChangeDetector
+{
+public:
+	DepthChangeDetector() : m_threshold(0), m_fraction(0), m_width(0), m_height(0)
+	{
+	}
+
+	// Threshold in depth units (mm, or 100 um for DEPTH_100_UM); fraction from 0 to 1
+	void configure(const TriggerRegion& region, int threshold, double fraction)
+	{
+		m_region = region;
+		m_threshold = threshold;
+		m_fraction = fraction;
+		m_background.clear();
+	}
+
+	// Compares a frame with the background, in place, and folds it into the background. The first
+	// frame, and the first after the image size changes, only start a new background.
+	bool update(const uint16_t* depth, int width, int height, int strideInBytes)
+	{
+		// Clip the region to the image
+		int x0 = (m_region.width > 0) ? m_region.x : 0;
+		int y0 = (m_region.height > 0) ? m_region.y : 0;
+		int x1 = (m_region.width > 0) ? m_region.x + m_region.width : width;
+		int y1 = (m_region.height > 0) ? m_region.y + m_region.height : height;
+		x1 = (x1 < width) ? x1 : width;
+		y1 = (y1 < height) ? y1 : height;
+		if(x0 >= x1 || y0 >= y1)
+		{
+			m_change = DepthChange();
+			return false;
+		}
+
+		size_t samples = (size_t)DepthChangeSamples(x1 - x0) * DepthChangeSamples(y1 - y0);
+		if(m_background.size() != samples || m_width != width || m_height != height)
+		{
+			m_background.assign(samples, 0);
+			m_width = width;
+			m_height = height;
+		}
+
+		DetectDepthChange(depth, strideInBytes, x0, y0, x1 - x0, y1 - y0, &m_background[0], m_threshold, m_change);
+		return m_change.changed > 0 && m_change.changed >= m_fraction * m_change.samples;
+	}
+
+	// Samples that changed in the last frame, out of how many watched, and where
+	const DepthChange& lastChange() const { return m_change; }
+
+private:
+	TriggerRegion m_region;
+	int m_threshold;
+	double m_fraction;
+	std::vector<uint16_t> m_background;
+	int m_width;
+	int m_height;
+	DepthChange m_change;
+};
+
+// A local (Unix domain) datagram socket that other programs fire the trigger through: every
+// datagram sent to its path is one trigger, whatever it holds, e.g.
+//   echo | socat - UNIX-SENDTO:/tmp/CaptureImageDepthData.trigger
+class TriggerSocket
+{
+public:
+	TriggerSocket() : m_fd(-1)
+	{
+	}
+
+	~TriggerSocket()
+	{
+		close();
+	}
+
+	// Creates the socket at path, replacing a stale one. Returns false with errno set on failure.
+	bool open(const char* path)
+	{
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if(strlen(path) >= sizeof(address.sun_path))
+		{
+			errno = ENAMETOOLONG;
+			return false;
+		}
+		strcpy(address.sun_path, path);
+
+		m_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(m_fd < 0)
+		{
+			return false;
+		}
+		unlink(path);
+		if(bind(m_fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+		{
+			int error = errno;
+			::close(m_fd);
+			m_fd = -1;
+			errno = error;
+			return false;
+		}
+		m_path = path;
+		return true;
+	}
+
+	// Waits up to timeoutMs for triggers and returns how many arrived, 0 on timeout
+	int wait(int timeoutMs)
+	{
+		struct pollfd descriptor;
+		descriptor.fd = m_fd;
+		descriptor.events = POLLIN;
+		descriptor.revents = 0;
+		if(m_fd < 0 || poll(&descriptor, 1, timeoutMs) <= 0)
+		{
+			return 0;
+		}
+
+		int triggers = 0;
+		char message[256];
+		while(recv(m_fd, message, sizeof(message), MSG_DONTWAIT) >= 0)
+		{
+			triggers++;
+		}
+		return triggers;
+	}
+
+	void close()
+	{
+		if(m_fd >= 0)
+		{
+			::close(m_fd);
+			unlink(m_path.c_str());
+			m_fd = -1;
+		}
+	}
+
+	bool isOpen() const { return m_fd >= 0; }
+
+private:
+	TriggerSocket(const TriggerSocket&);
+	TriggerSocket& operator=(const TriggerSocket&);
+
+	int m_fd;
+	std::string m_path;
+};
+
+#endif // _EVENT_TRIGGER_H_
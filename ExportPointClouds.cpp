@@ -0,0 +1,263 @@
+// Header Includes
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "BenchFrames.h"
+#include "ColorSwizzle.h"
+#include "DepthToWorld.h"
+#include "PointCloudExport.h"
+#include "RecordingReader.h"
+#include "WorkerPool.h"
+
+#define DEFAULT_THREADS 4
+
+// Color for points whose color frame is missing or can't be decoded in this build
+#define MISSING_COLOR 128
+
+// Namespaces
+using namespace std;
+
+// Export settings shared by every job
+struct ExportSettings
+{
+	DepthToWorld converter;
+	PointCloudFileFormat format;
+	bool organized;
+	const char* outputDirectory;
+};
+
+// One frame pair being exported on the pool
+struct ExportJob
+{
+	const ExportSettings* settings;
+	uint64_t frameNumber;
+	FrameView depth;
+	FrameView color;
+	bool hasColor;
+
+	bool ok;
+	uint32_t pointCount;
+};
+
+// Microseconds between two frames
+uint64_t TimestampDistance(const FrameView& a, const FrameView& b)
+{
+	return (a.timestamp > b.timestamp) ? a.timestamp - b.timestamp : b.timestamp - a.timestamp;
+}
+
+// Runs on the pool threads: decodes the pair, builds its cloud and writes the file
+void ExportFrame(ExportJob& job)
+{
+	const ExportSettings& settings = *job.settings;
+	int width = settings.converter.width();
+	int height = settings.converter.height();
+	job.ok = false;
+	job.pointCount = 0;
+	if(job.depth.width != width || job.depth.height != height)
+	{
+		return;
+	}
+
+	std::vector<uint16_t> depth(width * height);
+	if(!RecordingReader::decode(job.depth, &depth[0]))
+	{
+		return;
+	}
+
+	// RGB888 color, from the recording when it's raw, decoded when this build has OpenCV
+	const uint8_t* rgb = NULL;
+	int colorWidth = width;
+	int colorHeight = height;
+	int colorStride = width * 3;
+	std::vector<uint8_t> decodedColor;
+	if(job.hasColor && job.color.encoding == RECORDING_ENCODING_RAW)
+	{
+		rgb = (const uint8_t*)job.color.data;
+		colorWidth = job.color.width;
+		colorHeight = job.color.height;
+		colorStride = job.color.strideInBytes;
+	}
+#ifdef RECORDING_READER_OPENCV
+	else if(job.hasColor)
+	{
+		cv::Mat bgr = RecordingReader::decodeColor(job.color);
+		if(!bgr.empty())
+		{
+			colorWidth = bgr.cols;
+			colorHeight = bgr.rows;
+			colorStride = colorWidth * 3;
+			decodedColor.resize(colorStride * colorHeight);
+			SwizzleRgbToBgr(bgr.data, colorWidth, colorHeight, bgr.step, &decodedColor[0], colorStride);
+			rgb = &decodedColor[0];
+		}
+	}
+#endif
+	if(rgb == NULL)
+	{
+		decodedColor.assign(colorStride * colorHeight, MISSING_COLOR);
+		rgb = &decodedColor[0];
+	}
+
+	std::vector<PointXYZRGB> points(width * height);
+	job.pointCount = BuildColoredCloud(settings.converter, &depth[0], width * sizeof(uint16_t), rgb, colorWidth, colorHeight, colorStride, settings.organized, &points[0]);
+
+	char fileName[1024];
+	snprintf(fileName, sizeof(fileName), "%s/Cloud_%06llu.%s", settings.outputDirectory, (unsigned long long)job.frameNumber, PointCloudFileExtension(settings.format));
+	job.ok = WritePointCloudFile(settings.format, fileName, &points[0], job.pointCount, width, height, settings.organized);
+}
+
+// Exports every depth frame of a recorded session, with the color frame captured alongside it,
+// as one PLY or PCD file per frame. Frames are exported in parallel on a pool of threads.
+int main( const int argc, const char* argv[] )
+{
+	RecordingReader reader;
+	bool opened = false;
+	int argi = 1;
+
+	if(argc >= 5 && strcmp(argv[1], "--split") == 0)
+	{
+		opened = reader.openSplit(argv[2], argv[3], BENCH_LEGACY_RES_X, BENCH_LEGACY_RES_Y);
+		argi = 4;
+	}
+	else if(argc >= 3 && argv[1][0] != '-')
+	{
+		opened = reader.openRecording(argv[1]);
+		argi = 2;
+	}
+	else
+	{
+		cerr << "Usage: " << argv[0] << " Recording.rgbd OutputDirectory [--format ply|pcd] [--organized] [--threads N]" << endl;
+		cerr << "       " << argv[0] << " --split ImageOutput.dat DepthOutput.dat OutputDirectory [--format ply|pcd] [--organized] [--threads N]" << endl;
+		return EXIT_FAILURE;
+	}
+	if(!opened)
+	{
+		cerr << "Can't open recording" << endl;
+		return EXIT_FAILURE;
+	}
+
+	ExportSettings settings;
+	settings.format = POINT_CLOUD_FILE_PLY;
+	settings.organized = false;
+	settings.outputDirectory = argv[argi++];
+	int threads = DEFAULT_THREADS;
+	for(; argi < argc; argi++)
+	{
+		if(strcmp(argv[argi], "--format") == 0 && argi + 1 < argc)
+		{
+			argi++;
+			if(strcmp(argv[argi], "pcd") == 0)
+			{
+				settings.format = POINT_CLOUD_FILE_PCD;
+			}
+			else if(strcmp(argv[argi], "ply") != 0)
+			{
+				cerr << "Unknown format " << argv[argi] << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if(strcmp(argv[argi], "--organized") == 0)
+		{
+			settings.organized = true;
+		}
+		else if(strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc)
+		{
+			threads = atoi(argv[++argi]);
+		}
+		else
+		{
+			cerr << "Unknown option " << argv[argi] << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	uint64_t frameCount = reader.frameCount(RECORDING_STREAM_DEPTH);
+	FrameView first;
+	if(frameCount == 0 || !reader.frame(RECORDING_STREAM_DEPTH, 0, first))
+	{
+		cerr << "No depth frames in recording" << endl;
+		return EXIT_FAILURE;
+	}
+	if(reader.header() != NULL)
+	{
+		settings.converter.configure(*reader.header());
+	}
+	else
+	{
+		settings.converter.configure(first.width, first.height, DEFAULT_DEPTH_FOV_H, DEFAULT_DEPTH_FOV_V);
+	}
+	reader.advise(RecordingReader::ACCESS_SEQUENTIAL);
+#ifndef RECORDING_READER_OPENCV
+	FrameView firstColor;
+	if(reader.frameCount(RECORDING_STREAM_COLOR) > 0 && reader.frame(RECORDING_STREAM_COLOR, 0, firstColor) && firstColor.encoding != RECORDING_ENCODING_RAW)
+	{
+		cerr << "Color is compressed in this recording and this build can't decode it, points will be gray. Use ExportPointCloudsOpenCV for colored points." << endl;
+	}
+#endif
+
+	cout << "Exporting " << frameCount << " frames (" << first.width << "x" << first.height << ", " << (settings.converter.depthUnit() == 1 ? "1mm" : "100um") << " depth) as " << (settings.organized ? "organized " : "unorganized ")
+		<< PointCloudFileExtension(settings.format) << " on " << threads << " threads to " << settings.outputDirectory << endl;
+
+	// Color frames are paired with depth in capture order, as the capture program writes them. If depth
+	// was also written alone, while color was shed under load, a color frame goes with the depth frame
+	// nearest it in time.
+	uint64_t colorCount = reader.frameCount(RECORDING_STREAM_COLOR);
+	bool aligned = colorCount == frameCount;
+	uint64_t nextColor = 0;
+	uint64_t exported = 0;
+	uint64_t failed = 0;
+	uint64_t points = 0;
+	double start = Seconds();
+	{
+		OrderedWorkerPool<ExportJob> pool(threads, threads * 2, ExportFrame);
+		ExportJob done;
+		for(uint64_t n = 0; n < frameCount; n++)
+		{
+			ExportJob job;
+			job.settings = &settings;
+			job.frameNumber = n;
+			if(!reader.frame(RECORDING_STREAM_DEPTH, n, job.depth))
+			{
+				failed++;
+				continue;
+			}
+			if(aligned)
+			{
+				job.hasColor = reader.frame(RECORDING_STREAM_COLOR, n, job.color);
+			}
+			else
+			{
+				FrameView following;
+				job.hasColor = nextColor < colorCount && reader.frame(RECORDING_STREAM_COLOR, nextColor, job.color) &&
+					!(n + 1 < frameCount && reader.frame(RECORDING_STREAM_DEPTH, n + 1, following) &&
+					TimestampDistance(following, job.color) < TimestampDistance(job.depth, job.color));
+				nextColor += job.hasColor;
+			}
+
+			while(pool.full() && pool.next(done, true))
+			{
+				exported += done.ok;
+				failed += !done.ok;
+				points += done.pointCount;
+			}
+			pool.submit(std::move(job));
+		}
+		while(pool.next(done, true))
+		{
+			exported += done.ok;
+			failed += !done.ok;
+			points += done.pointCount;
+		}
+	}
+	double time = Seconds() - start;
+
+	double pointMB = points * (settings.format == POINT_CLOUD_FILE_PCD ? 16.0 : sizeof(PointXYZRGB)) / 1048576.0;
+	printf("Exported %llu frames (%llu failed) in %.2f s : %.1f frames/s, %.1f Mpoints/s, %.1f MB/s\n", (unsigned long long)exported, (unsigned long long)failed,
+		time, exported / time, points / time / 1e6, pointMB / time);
+	printf("Average %.0f points per frame\n", exported ? (double)points / exported : 0.0);
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,448 @@
+#ifndef _FRAME_BUS_H_
+#define _FRAME_BUS_H_
+
+// Header Includes
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RecordingFormat.h"
+
+// Layout of a frame bus, a POSIX shared memory object that one capture process publishes its
+// frames to as they arrive, for any number of local processes to read in place.
+//
+//   FrameBusHeader
+//   FrameBusSlot + pixel data, slotCount times for each stream
+//
+// Each stream is a ring of slots overwritten oldest first; the producer never waits for readers.
+// A slot's sequence number is odd while the producer writes it and 2n once it holds the stream's
+// n'th frame, so a reader knows a frame was complete, and still there once it was done with it,
+// when the sequence number is 2n before and after. A reader that falls more than a ring behind
+// skips ahead to the oldest frame still on the bus. Fields are in host byte order, as the bus never
+// leaves the machine. This header has no OpenNI dependency so consumers can include it on its own.
+
+#define FRAME_BUS_MAGIC 0x53554246	// "FBUS"
+#define FRAME_BUS_VERSION 1
+
+// Slots and their pixel data start on cache lines
+#define FRAME_BUS_ALIGNMENT 64
+
+// The sequence numbers are shared between processes, so must be plain lock-free words
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "frame bus needs lock-free 64-bit atomics");
+
+// Nanoseconds on the steady clock, which every process on the host shares
+inline uint64_t FrameBusClockNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct FrameBusStreamInfo
+{
+	uint32_t pixelFormat;	// openni::PixelFormat, 0 if the stream is absent
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytesPerPixel;
+	uint32_t slotCount;
+	uint32_t reserved;
+	uint64_t slotSize;	// Bytes from one slot to the next, FrameBusSlot included
+	uint64_t offset;	// Of the stream's first slot from the start of the bus
+};
+
+// Frames published on a stream, each on its own cache line so the producer's stores to one
+// stream don't disturb readers polling the other
+struct alignas(FRAME_BUS_ALIGNMENT) FrameBusCursor
+{
+	std::atomic<uint64_t> published;
+};
+
+struct FrameBusHeader
+{
+	uint32_t magic;	// FRAME_BUS_MAGIC, written last once the bus is ready
+	uint32_t version;	// FRAME_BUS_VERSION
+	uint32_t headerSize;	// sizeof(FrameBusHeader)
+	uint32_t streamCount;
+	uint64_t size;	// Bytes in the whole bus
+	char serialNumber[RECORDING_SERIAL_LENGTH];	// Of the device publishing, NUL terminated
+	FrameBusStreamInfo streams[RECORDING_MAX_STREAMS];	// Indexed by RecordingStream
+	// Set once the producer has finished; the name may already belong to a new bus
+	std::atomic<uint32_t> closed;
+	FrameBusCursor cursors[RECORDING_MAX_STREAMS];
+};
+
+struct alignas(FRAME_BUS_ALIGNMENT) FrameBusSlot
+{
+	std::atomic<uint64_t> sequence;	// 2n while holding frame n (from 1), odd while being written, 0 before the first
+	uint64_t timestamp;	// Device timestamp, microseconds
+	uint64_t hostTimestamp;	// Microseconds on the capture process's host clock (DeviceClock.h), 0 if unknown
+	uint64_t publishTime;	// FrameBusClockNanoseconds() when the frame was published
+	uint32_t frameIndex;
+	uint32_t width;
+	uint32_t height;
+	uint32_t strideInBytes;
+	uint32_t dataSize;	// Bytes of pixel data following the slot header
+};
+
+static_assert(sizeof(FrameBusSlot) == FRAME_BUS_ALIGNMENT, "frame bus slot header must be one cache line");
+
+// One frame, published or read. When read, data points into the bus and the frame is only good
+// for as long as FrameBusReader::valid() says so.
+struct FrameBusFrame
+{
+	FrameBusFrame() : stream(0), sequence(0), timestamp(0), hostTimestamp(0), publishTime(0), frameIndex(0), width(0), height(0), strideInBytes(0), dataSize(0), data(NULL)
+	{
+	}
+
+	int stream;
+	uint64_t sequence;	// Frames of the stream published before, plus one
+	uint64_t timestamp;
+	uint64_t hostTimestamp;
+	uint64_t publishTime;
+	uint32_t frameIndex;
+	uint32_t width;
+	uint32_t height;
+	uint32_t strideInBytes;
+	uint32_t dataSize;
+	const void* data;
+};
+
+// Slot that frame n (from 1) of a stream goes in
+inline FrameBusSlot* FrameBusSlotOf(const void* bus, const FrameBusStreamInfo& stream, uint64_t n)
+{
+	return (FrameBusSlot*)((const uint8_t*)bus + stream.offset + ((n - 1) % stream.slotCount) * stream.slotSize);
+}
+
+// Publishes frames to a bus. Only one process may publish to a bus, and one thread to each of its
+// streams, as the streams share nothing the publisher writes.
+class FrameBusWriter
+{
+public:
+	FrameBusWriter() : m_header(NULL)
+	{
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			m_published[i] = 0;
+		}
+	}
+
+	~FrameBusWriter()
+	{
+		close();
+	}
+
+	// Creates the bus under a shared memory name such as "/CaptureImageDepthData", replacing a stale
+	// one, with slotCount slots for each stream whose pixelFormat is set, each large enough for a
+	// width x height frame. The pages are populated up front, so publishing never faults. Returns
+	// false with errno set on failure.
+	bool create(const char* name, const FrameBusStreamInfo (&streams)[RECORDING_MAX_STREAMS], int slotCount, const char* serialNumber)
+	{
+		if(slotCount < 1)
+		{
+			errno = EINVAL;
+			return false;
+		}
+		FrameBusStreamInfo layout[RECORDING_MAX_STREAMS];
+		uint64_t size = RoundUp(sizeof(FrameBusHeader));
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			layout[i] = streams[i];
+			layout[i].slotCount = (streams[i].pixelFormat != 0) ? slotCount : 0;
+			layout[i].reserved = 0;
+			layout[i].slotSize = sizeof(FrameBusSlot) + RoundUp((uint64_t)streams[i].width * streams[i].height * streams[i].bytesPerPixel);
+			layout[i].offset = size;
+			size += layout[i].slotCount * layout[i].slotSize;
+		}
+
+		shm_unlink(name);
+		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+		if(fd < 0)
+		{
+			return false;
+		}
+		void* bus = MAP_FAILED;
+		if(ftruncate(fd, size) == 0)
+		{
+			bus = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+		}
+		int error = errno;
+		::close(fd);
+		if(bus == MAP_FAILED)
+		{
+			shm_unlink(name);
+			errno = error;
+			return false;
+		}
+
+		// The new object is zero filled: every slot is empty and nothing is published. Readers
+		// ignore the bus until the magic number shows the rest of the header is there.
+		m_header = (FrameBusHeader*)bus;
+		m_header->version = FRAME_BUS_VERSION;
+		m_header->headerSize = sizeof(FrameBusHeader);
+		m_header->streamCount = RECORDING_MAX_STREAMS;
+		m_header->size = size;
+		snprintf(m_header->serialNumber, sizeof(m_header->serialNumber), "%s", serialNumber);
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			m_header->streams[i] = layout[i];
+			m_published[i] = 0;
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		m_header->magic = FRAME_BUS_MAGIC;
+		m_name = name;
+		return true;
+	}
+
+	// Copies a frame into the next slot of its stream, overwriting the oldest frame. Returns false if
+	// the bus isn't open, the stream isn't on it or the frame is bigger than its slots.
+	bool publish(const FrameBusFrame& frame)
+	{
+		if(m_header == NULL || frame.stream < 0 || frame.stream >= RECORDING_MAX_STREAMS)
+		{
+			return false;
+		}
+		const FrameBusStreamInfo& stream = m_header->streams[frame.stream];
+		if(stream.slotCount == 0 || sizeof(FrameBusSlot) + frame.dataSize > stream.slotSize)
+		{
+			return false;
+		}
+
+		uint64_t n = ++m_published[frame.stream];
+		FrameBusSlot* slot = FrameBusSlotOf(m_header, stream, n);
+		slot->sequence.store(2 * n - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot->timestamp = frame.timestamp;
+		slot->hostTimestamp = frame.hostTimestamp;
+		slot->frameIndex = frame.frameIndex;
+		slot->width = frame.width;
+		slot->height = frame.height;
+		slot->strideInBytes = frame.strideInBytes;
+		slot->dataSize = frame.dataSize;
+		memcpy((void*)(slot + 1), frame.data, frame.dataSize);
+		slot->publishTime = FrameBusClockNanoseconds();
+		slot->sequence.store(2 * n, std::memory_order_release);
+		m_header->cursors[frame.stream].published.store(n, std::memory_order_release);
+		return true;
+	}
+
+	// Tells readers the bus is finished and removes its name; readers keep what they have mapped
+	void close()
+	{
+		if(m_header != NULL)
+		{
+			m_header->closed.store(1, std::memory_order_release);
+			shm_unlink(m_name.c_str());
+			munmap(m_header, m_header->size);
+			m_header = NULL;
+		}
+	}
+
+	bool isOpen() const { return m_header != NULL; }
+	const std::string& name() const { return m_name; }
+	uint64_t published(int stream) const { return m_published[stream]; }
+
+private:
+	FrameBusWriter(const FrameBusWriter&);
+	FrameBusWriter& operator=(const FrameBusWriter&);
+
+	static uint64_t RoundUp(uint64_t bytes)
+	{
+		return (bytes + FRAME_BUS_ALIGNMENT - 1) & ~(uint64_t)(FRAME_BUS_ALIGNMENT - 1);
+	}
+
+	FrameBusHeader* m_header;
+	std::string m_name;
+	uint64_t m_published[RECORDING_MAX_STREAMS];
+};
+
+// Reads frames from a bus without ever holding up the producer or other readers: the bus is
+// mapped read-only and a reader only keeps its own position in each stream. Readers poll;
+// next() and latest() return at once when there is nothing new.
+class FrameBusReader
+{
+public:
+	FrameBusReader() : m_header(NULL), m_size(0)
+	{
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			m_next[i] = 0;
+			m_skipped[i] = 0;
+		}
+	}
+
+	~FrameBusReader()
+	{
+		close();
+	}
+
+	// Maps the bus of that name. Reading starts with the frames published after it was opened.
+	// Returns false with errno set if it doesn't exist or isn't a bus this reader understands.
+	bool open(const char* name)
+	{
+		close();
+		int fd = shm_open(name, O_RDONLY, 0);
+		if(fd < 0)
+		{
+			return false;
+		}
+		struct stat status;
+		void* bus = MAP_FAILED;
+		if(fstat(fd, &status) == 0 && (uint64_t)status.st_size >= sizeof(FrameBusHeader))
+		{
+			bus = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		else
+		{
+			errno = EINVAL;
+		}
+		int error = errno;
+		::close(fd);
+		if(bus == MAP_FAILED)
+		{
+			errno = error;
+			return false;
+		}
+
+		FrameBusHeader* header = (FrameBusHeader*)bus;
+		bool valid = header->magic == FRAME_BUS_MAGIC;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(!valid || header->version != FRAME_BUS_VERSION || header->headerSize != sizeof(FrameBusHeader) || header->size > (uint64_t)status.st_size)
+		{
+			munmap(bus, status.st_size);
+			errno = EINVAL;
+			return false;
+		}
+		m_header = header;
+		m_size = status.st_size;
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			m_next[i] = m_header->cursors[i].published.load(std::memory_order_acquire) + 1;
+			m_skipped[i] = 0;
+		}
+		return true;
+	}
+
+	void close()
+	{
+		if(m_header != NULL)
+		{
+			munmap(m_header, m_size);
+			m_header = NULL;
+		}
+	}
+
+	// The oldest frame of a stream not yet read that is still on the bus, skipping over any that
+	// were overwritten first. Returns false if there is no new frame.
+	bool next(int stream, FrameBusFrame& frame)
+	{
+		if(m_header == NULL || stream < 0 || stream >= RECORDING_MAX_STREAMS || m_header->streams[stream].slotCount == 0)
+		{
+			return false;
+		}
+		const FrameBusStreamInfo& info = m_header->streams[stream];
+		uint64_t published = m_header->cursors[stream].published.load(std::memory_order_acquire);
+		while(m_next[stream] <= published)
+		{
+			// Frames more than a ring behind are gone
+			if(published - m_next[stream] >= info.slotCount)
+			{
+				uint64_t oldest = published - info.slotCount + 1;
+				m_skipped[stream] += oldest - m_next[stream];
+				m_next[stream] = oldest;
+			}
+
+			uint64_t n = m_next[stream]++;
+			if(readSlot(stream, n, frame))
+			{
+				return true;
+			}
+			// Overwritten while we looked: the producer has moved on
+			m_skipped[stream]++;
+			published = m_header->cursors[stream].published.load(std::memory_order_acquire);
+		}
+		return false;
+	}
+
+	// The newest frame of a stream, skipping all older ones not read yet. Returns false if nothing
+	// new has been published.
+	bool latest(int stream, FrameBusFrame& frame)
+	{
+		if(m_header == NULL || stream < 0 || stream >= RECORDING_MAX_STREAMS)
+		{
+			return false;
+		}
+		uint64_t published = m_header->cursors[stream].published.load(std::memory_order_acquire);
+		if(published > m_next[stream])
+		{
+			m_skipped[stream] += published - m_next[stream];
+			m_next[stream] = published;
+		}
+		return next(stream, frame);
+	}
+
+	// True if the frame's slot hasn't been reused since it was read, i.e. whatever was read from its
+	// pixels so far is the frame as published. Check after using the pixels in place.
+	bool valid(const FrameBusFrame& frame) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const FrameBusSlot* slot = FrameBusSlotOf(m_header, m_header->streams[frame.stream], frame.sequence);
+		return slot->sequence.load(std::memory_order_relaxed) == 2 * frame.sequence;
+	}
+
+	// Copies a frame's pixels out of the bus. Returns false if it was overwritten meanwhile.
+	bool copy(const FrameBusFrame& frame, void* pixels) const
+	{
+		memcpy(pixels, frame.data, frame.dataSize);
+		return valid(frame);
+	}
+
+	// True once the producer has finished with the bus
+	bool closed() const
+	{
+		return m_header == NULL || m_header->closed.load(std::memory_order_acquire) != 0;
+	}
+
+	bool isOpen() const { return m_header != NULL; }
+	const FrameBusHeader& header() const { return *m_header; }
+	// Frames of a stream that were overwritten before this reader got to them
+	uint64_t skipped(int stream) const { return m_skipped[stream]; }
+
+private:
+	FrameBusReader(const FrameBusReader&);
+	FrameBusReader& operator=(const FrameBusReader&);
+
+	// Reads frame n's details if its slot still holds it
+	bool readSlot(int stream, uint64_t n, FrameBusFrame& frame)
+	{
+		const FrameBusSlot* slot = FrameBusSlotOf(m_header, m_header->streams[stream], n);
+		if(slot->sequence.load(std::memory_order_acquire) != 2 * n)
+		{
+			return false;
+		}
+		frame.stream = stream;
+		frame.sequence = n;
+		frame.timestamp = slot->timestamp;
+		frame.hostTimestamp = slot->hostTimestamp;
+		frame.publishTime = slot->publishTime;
+		frame.frameIndex = slot->frameIndex;
+		frame.width = slot->width;
+		frame.height = slot->height;
+		frame.strideInBytes = slot->strideInBytes;
+		frame.dataSize = slot->dataSize;
+		frame.data = slot + 1;
+		return valid(frame);
+	}
+
+	FrameBusHeader* m_header;
+	uint64_t m_size;
+	uint64_t m_next[RECORDING_MAX_STREAMS];
+	uint64_t m_skipped[RECORDING_MAX_STREAMS];
+};
+
+#endif // _FRAME_BUS_H_
@@ -0,0 +1,257 @@
+// Header Includes
+#include <algorithm>
+#include <iostream>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "FrameBus.h"
+
+#define BENCH_RES_X 640
+#define BENCH_RES_Y 480
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_FPS 30
+#define DEFAULT_READERS 2
+#define DEFAULT_SLOTS 8
+
+// openni::PIXEL_FORMAT_RGB888 and PIXEL_FORMAT_DEPTH_1_MM, without OpenNI
+#define BENCH_PIXEL_FORMAT_RGB888 200
+#define BENCH_PIXEL_FORMAT_DEPTH_1_MM 100
+
+// Namespaces
+using namespace std;
+
+// Nanoseconds below which the given fraction of sorted latencies fall
+uint64_t Percentile(const std::vector<uint64_t>& sorted, double fraction)
+{
+	if(sorted.empty())
+	{
+		return 0;
+	}
+	size_t i = (size_t)(fraction * sorted.size());
+	return sorted[(i < sorted.size()) ? i : sorted.size() - 1];
+}
+
+// Every 32-bit word of frame n holds n, so a reader can tell a torn frame from a whole one
+void FillFrame(std::vector<uint8_t>& frame, uint32_t n)
+{
+	uint32_t* words = (uint32_t*)&frame[0];
+	for(size_t i = 0; i < frame.size() / 4; i++)
+	{
+		words[i] = n;
+	}
+}
+
+// Reader process: takes every frame of both streams as soon as it is published, in place, and
+// checks its first and last words. With slowMs set it dawdles over each frame, to show a reader
+// that can't keep up skipping ahead without slowing the producer or the other readers.
+int RunReader(const char* name, int number, int slowMs, int ready)
+{
+	FrameBusReader reader;
+	if(!reader.open(name))
+	{
+		cerr << "Reader " << number << " can't open " << name << " : " << strerror(errno) << endl;
+		return EXIT_FAILURE;
+	}
+	char byte = 0;
+	if(write(ready, &byte, 1) != 1)
+	{
+		return EXIT_FAILURE;
+	}
+	close(ready);
+
+	std::vector<uint64_t> latencies;
+	uint64_t frames[RECORDING_MAX_STREAMS] = { 0, 0 };
+	uint64_t torn = 0;
+	uint64_t wrong = 0;
+	bool finished = false;
+	while(!finished)
+	{
+		// Look once more after the producer has finished, for the frames published just before
+		finished = reader.closed();
+		bool idle = true;
+		for(int stream = 0; stream < RECORDING_MAX_STREAMS; stream++)
+		{
+			FrameBusFrame frame;
+			while(reader.next(stream, frame))
+			{
+				latencies.push_back(FrameBusClockNanoseconds() - frame.publishTime);
+				const uint32_t* words = (const uint32_t*)frame.data;
+				bool whole = words[0] == frame.frameIndex && words[frame.dataSize / 4 - 1] == frame.frameIndex;
+				if(!reader.valid(frame))
+				{
+					torn++;
+				}
+				else
+				{
+					wrong += !whole;
+				}
+				frames[stream]++;
+				idle = false;
+				if(slowMs > 0)
+				{
+					usleep(slowMs * 1000);
+				}
+			}
+		}
+		// Poll without hogging a CPU the producer may need
+		if(idle && !finished)
+		{
+			sched_yield();
+		}
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	printf("Reader %d%s : %llu color, %llu depth frames, %llu skipped, %llu overwritten while read, %llu corrupt | latency 50%% < %llu ns, 99%% < %llu ns, 99.9%% < %llu ns, max %llu ns\n",
+		number, slowMs > 0 ? " (slow)" : "", (unsigned long long)frames[RECORDING_STREAM_COLOR], (unsigned long long)frames[RECORDING_STREAM_DEPTH],
+		(unsigned long long)(reader.skipped(RECORDING_STREAM_COLOR) + reader.skipped(RECORDING_STREAM_DEPTH)), (unsigned long long)torn, (unsigned long long)wrong,
+		(unsigned long long)Percentile(latencies, 0.5), (unsigned long long)Percentile(latencies, 0.99), (unsigned long long)Percentile(latencies, 0.999),
+		(unsigned long long)(latencies.empty() ? 0 : latencies.back()));
+	fflush(stdout);
+	return (wrong == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Publishes VGA color and depth frames at a sensor's rate to reader processes and reports how long
+// publishing takes and how long each frame takes to reach every reader
+int main( const int argc, const char* argv[] )
+{
+	int frameCount = DEFAULT_FRAMES;
+	int fps = DEFAULT_FPS;
+	int readers = DEFAULT_READERS;
+	int slots = DEFAULT_SLOTS;
+	int slowMs = 0;
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+		{
+			fps = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--readers") == 0 && i + 1 < argc)
+		{
+			readers = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--slots") == 0 && i + 1 < argc)
+		{
+			slots = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--slow-reader") == 0 && i + 1 < argc)
+		{
+			slowMs = atoi(argv[++i]);
+		}
+		else if(argv[i][0] != '-')
+		{
+			frameCount = atoi(argv[i]);
+		}
+		else
+		{
+			cerr << "Usage: " << argv[0] << " [Frames] [--fps N] [--readers N] [--slots N] [--slow-reader MS]" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	FrameBusStreamInfo streams[RECORDING_MAX_STREAMS];
+	memset(streams, 0, sizeof(streams));
+	streams[RECORDING_STREAM_COLOR].pixelFormat = BENCH_PIXEL_FORMAT_RGB888;
+	streams[RECORDING_STREAM_COLOR].bytesPerPixel = 3;
+	streams[RECORDING_STREAM_DEPTH].pixelFormat = BENCH_PIXEL_FORMAT_DEPTH_1_MM;
+	streams[RECORDING_STREAM_DEPTH].bytesPerPixel = 2;
+	for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+	{
+		streams[i].width = BENCH_RES_X;
+		streams[i].height = BENCH_RES_Y;
+	}
+
+	std::string name = "/FrameBusBench_" + std::to_string(getpid());
+	FrameBusWriter bus;
+	if(!bus.create(name.c_str(), streams, slots, "bench"))
+	{
+		cerr << "Can't create " << name << " : " << strerror(errno) << endl;
+		return EXIT_FAILURE;
+	}
+	cout << "Frame bus " << name << " : " << frameCount << " color and depth frames (" << BENCH_RES_X << "x" << BENCH_RES_Y << ") at " << fps << " fps, "
+		<< slots << " slots per stream, " << readers << " reader processes" << endl;
+
+	// Start the readers and wait until each has the bus open
+	int ready[2];
+	if(pipe(ready) != 0)
+	{
+		return EXIT_FAILURE;
+	}
+	std::vector<pid_t> children;
+	for(int r = 0; r < readers; r++)
+	{
+		pid_t child = fork();
+		if(child == 0)
+		{
+			close(ready[0]);
+			_exit(RunReader(name.c_str(), r + 1, (r == 0) ? slowMs : 0, ready[1]));
+		}
+		children.push_back(child);
+	}
+	close(ready[1]);
+	for(int r = 0; r < readers; r++)
+	{
+		char byte;
+		if(read(ready[0], &byte, 1) != 1)
+		{
+			break;
+		}
+	}
+	close(ready[0]);
+
+	std::vector<uint8_t> pixels[RECORDING_MAX_STREAMS];
+	std::vector<uint64_t> publishTimes;
+	for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+	{
+		pixels[i].resize(streams[i].width * streams[i].height * streams[i].bytesPerPixel);
+	}
+	uint64_t period = (fps > 0) ? 1000000000ull / fps : 0;
+	uint64_t next = FrameBusClockNanoseconds();
+	for(int n = 1; n <= frameCount; n++)
+	{
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			FillFrame(pixels[i], n);
+			FrameBusFrame frame;
+			frame.stream = i;
+			frame.timestamp = next / 1000;
+			frame.frameIndex = n;
+			frame.width = streams[i].width;
+			frame.height = streams[i].height;
+			frame.strideInBytes = streams[i].width * streams[i].bytesPerPixel;
+			frame.dataSize = pixels[i].size();
+			frame.data = &pixels[i][0];
+			uint64_t start = FrameBusClockNanoseconds();
+			bus.publish(frame);
+			publishTimes.push_back(FrameBusClockNanoseconds() - start);
+		}
+
+		next += period;
+		uint64_t now = FrameBusClockNanoseconds();
+		if(next > now)
+		{
+			struct timespec wait = { (time_t)((next - now) / 1000000000ull), (long)((next - now) % 1000000000ull) };
+			nanosleep(&wait, NULL);
+		}
+	}
+	bus.close();
+
+	bool ok = true;
+	for(size_t r = 0; r < children.size(); r++)
+	{
+		int status = 0;
+		waitpid(children[r], &status, 0);
+		ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+	}
+	std::sort(publishTimes.begin(), publishTimes.end());
+	printf("Publish : 50%% < %llu ns, 99%% < %llu ns, max %llu ns per frame\n", (unsigned long long)Percentile(publishTimes, 0.5),
+		(unsigned long long)Percentile(publishTimes, 0.99), (unsigned long long)(publishTimes.empty() ? 0 : publishTimes.back()));
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
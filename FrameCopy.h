@@ -0,0 +1,115 @@
+#ifndef _FRAME_COPY_H_
+#define _FRAME_COPY_H_
+
+// Header Includes
+#include <OpenNI.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// A frame's pixels and what the recording stores about it, copied out of its driver buffer so the
+// buffer can go straight back to the driver. Has the VideoFrameRef accessors the writers use. A
+// copy keeps its buffer when released or assigned again, so once reserved it never allocates.
+class FrameCopy
+{
+public:
+	FrameCopy() : m_valid(false), m_timestamp(0), m_frameIndex(0), m_width(0), m_height(0), m_strideInBytes(0), m_dataSize(0)
+	{
+	}
+
+	// Makes room for frames of up to this many bytes
+	void reserve(size_t dataSize)
+	{
+		m_data.reserve(dataSize);
+	}
+
+	// Copies a frame, or becomes empty if it isn't valid
+	void assign(const openni::VideoFrameRef& frame)
+	{
+		m_valid = frame.isValid();
+		if(!m_valid)
+		{
+			return;
+		}
+		m_timestamp = frame.getTimestamp();
+		m_frameIndex = frame.getFrameIndex();
+		m_width = frame.getWidth();
+		m_height = frame.getHeight();
+		m_strideInBytes = frame.getStrideInBytes();
+		m_dataSize = frame.getDataSize();
+		if(m_data.size() < (size_t)m_dataSize)
+		{
+			m_data.resize(m_dataSize);
+		}
+		memcpy(&m_data[0], frame.getData(), m_dataSize);
+	}
+
+	void release() { m_valid = false; }
+
+	bool isValid() const { return m_valid; }
+	const void* getData() const { return m_data.empty() ? NULL : &m_data[0]; }
+	int getDataSize() const { return m_dataSize; }
+	uint64_t getTimestamp() const { return m_timestamp; }
+	int getFrameIndex() const { return m_frameIndex; }
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+	int getStrideInBytes() const { return m_strideInBytes; }
+
+private:
+	bool m_valid;
+	uint64_t m_timestamp;
+	int m_frameIndex;
+	int m_width;
+	int m_height;
+	int m_strideInBytes;
+	int m_dataSize;
+	std::vector<uint8_t> m_data;
+};
+
+// A frame a worker pool job holds on to: a reference to a driver buffer, or a FrameCopy of its own
+class HeldFrame
+{
+public:
+	HeldFrame() : m_copied(false)
+	{
+	}
+
+	HeldFrame& operator=(const openni::VideoFrameRef& frame)
+	{
+		m_ref = frame;
+		m_copy.release();
+		m_copied = false;
+		return *this;
+	}
+
+	HeldFrame& operator=(const FrameCopy& frame)
+	{
+		m_ref.release();
+		m_copy = frame;
+		m_copied = true;
+		return *this;
+	}
+
+	void release()
+	{
+		m_ref.release();
+		m_copy.release();
+		m_copied = false;
+	}
+
+	bool isValid() const { return m_copied ? m_copy.isValid() : m_ref.isValid(); }
+	const void* getData() const { return m_copied ? m_copy.getData() : m_ref.getData(); }
+	int getDataSize() const { return m_copied ? m_copy.getDataSize() : m_ref.getDataSize(); }
+	uint64_t getTimestamp() const { return m_copied ? m_copy.getTimestamp() : m_ref.getTimestamp(); }
+	int getFrameIndex() const { return m_copied ? m_copy.getFrameIndex() : m_ref.getFrameIndex(); }
+	int getWidth() const { return m_copied ? m_copy.getWidth() : m_ref.getWidth(); }
+	int getHeight() const { return m_copied ? m_copy.getHeight() : m_ref.getHeight(); }
+	int getStrideInBytes() const { return m_copied ? m_copy.getStrideInBytes() : m_ref.getStrideInBytes(); }
+
+private:
+	openni::VideoFrameRef m_ref;
+	FrameCopy m_copy;
+	bool m_copied;
+};
+
+#endif // _FRAME_COPY_H_
@@ -0,0 +1,154 @@
+#ifndef _FRAME_ENCODER_H_
+#define _FRAME_ENCODER_H_
+
+// Header Includes
+#include <opencv2/opencv.hpp>
+#include <OpenNI.h>
+#include <chrono>
+#include <errno.h>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "DepthCodec.h"
+#include "FrameCopy.h"
+#include "LatencyStats.h"
+#include "RecordingWriter.h"
+#include "WorkerPool.h"
+
+// A frame being compressed on an encoder pool
+struct EncodeJob
+{
+	HeldFrame frame;
+	RecordingEncoding encoding;
+	int quality;	// JPEG quality (0-100) or PNG compression level (0-9)
+	std::vector<uint8_t> encoded;
+
+	std::chrono::steady_clock::time_point submitted;
+	// Microseconds spent encoding, and from submission until the encoded frame was ready
+	uint64_t encodeTime;
+	uint64_t latency;
+};
+
+// Runs on the encoder pool threads
+inline void EncodeFrame(EncodeJob& job)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	job.encoded.clear();
+	if(job.encoding == RECORDING_ENCODING_DEPTH_RICE)
+	{
+		job.encoded.reserve(job.frame.getDataSize());
+		EncodeDepth((const uint16_t*)job.frame.getData(), job.frame.getWidth(), job.frame.getHeight(), job.frame.getStrideInBytes(), job.encoded);
+	}
+	else
+	{
+		// OpenCV's encoders expect BGR
+		cv::Mat rgb(job.frame.getHeight(), job.frame.getWidth(), CV_8UC3, (void*)job.frame.getData(), job.frame.getStrideInBytes());
+		cv::Mat bgr;
+		cv::cvtColor(rgb, bgr, cv::COLOR_RGB2BGR);
+
+		std::vector<int> params;
+		params.push_back(job.encoding == RECORDING_ENCODING_JPEG ? cv::IMWRITE_JPEG_QUALITY : cv::IMWRITE_PNG_COMPRESSION);
+		params.push_back(job.quality);
+		cv::imencode(job.encoding == RECORDING_ENCODING_JPEG ? ".jpg" : ".png", bgr, job.encoded, params);
+	}
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	job.encodeTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	job.latency = std::chrono::duration_cast<std::chrono::microseconds>(end - job.submitted).count();
+}
+
+// Compresses one stream's frames on a pool of worker threads and writes them to the recording
+// in the order they were submitted. Keeps histograms of the frame timings so the pool can be sized.
+class StreamEncoder
+{
+public:
+	StreamEncoder(RecordingWriter* recording, RecordingStream stream, RecordingEncoding encoding, int quality, unsigned int threads, unsigned int maxQueued) :
+		m_pool(threads, maxQueued, EncodeFrame), m_recording(recording), m_stream(stream), m_encoding(encoding), m_quality(quality),
+		m_rawBytes(0), m_encodedBytes(0), m_writeFailures(0)
+	{
+	}
+
+	// Queues a driver frame, or a FrameCopy which the job copies in turn. If the pool is backed up,
+	// waits for its oldest frame first so the caller (and then the capture rings) take the strain
+	// instead of memory growing.
+	template<typename Frame>
+	void submit(const Frame& frame)
+	{
+		if(m_pool.full())
+		{
+			drain(false, true);
+		}
+
+		EncodeJob job;
+		job.frame = frame;
+		job.encoding = m_encoding;
+		job.quality = m_quality;
+		job.submitted = std::chrono::steady_clock::now();
+		m_pool.submit(std::move(job));
+	}
+
+	// Writes frames that have finished encoding. With wait, blocks until every submitted frame is
+	// written; with waitForOne, blocks for the oldest one before taking any others that are ready.
+	void drain(bool wait, bool waitForOne = false)
+	{
+		EncodeJob job;
+		while(m_pool.next(job, wait || waitForOne))
+		{
+			waitForOne = false;
+			if(!m_recording->writeFrame(m_stream, job.frame, m_encoding, job.encoded.empty() ? NULL : &job.encoded[0], job.encoded.size()) && m_writeFailures++ == 0)
+			{
+				std::cerr << "Error writing encoded " << (m_stream == RECORDING_STREAM_COLOR ? "color" : "depth") << " frame to " << m_recording->fileName() << " : " << strerror(errno) << std::endl;
+			}
+
+			m_rawBytes += job.frame.getDataSize();
+			m_encodedBytes += job.encoded.size();
+			m_encodeTimes.add(job.encodeTime);
+			m_latencies.add(job.latency);
+			job.frame.release();
+		}
+	}
+
+	// Prints compression ratio and encode time / latency percentiles
+	void printStatistics(std::ostream& out, const char* name) const
+	{
+		if(m_encodedBytes == 0)
+		{
+			return;
+		}
+
+		char line[256];
+		snprintf(line, sizeof(line), "%s compressed %.1f MB to %.1f MB (%.2fx) on %u threads", name,
+			m_rawBytes / 1048576.0, m_encodedBytes / 1048576.0, (double)m_rawBytes / m_encodedBytes, m_pool.threads());
+		out << line << std::endl;
+		m_encodeTimes.printStatistics(out, (std::string(name) + " encode").c_str());
+		m_latencies.printStatistics(out, (std::string(name) + " encoder").c_str());
+	}
+
+	RecordingStream stream() const { return m_stream; }
+	// Encoded frames the recording failed to write
+	uint64_t writeFailures() const { return m_writeFailures; }
+	std::vector<std::thread::native_handle_type> workerThreads() { return m_pool.threadHandles(); }
+
+private:
+	StreamEncoder(const StreamEncoder&);
+	StreamEncoder& operator=(const StreamEncoder&);
+
+	OrderedWorkerPool<EncodeJob> m_pool;
+	RecordingWriter* m_recording;
+	RecordingStream m_stream;
+	RecordingEncoding m_encoding;
+	int m_quality;
+
+	uint64_t m_rawBytes;
+	uint64_t m_encodedBytes;
+	uint64_t m_writeFailures;
+	// Time encoding each frame, and from its submission until it was encoded
+	LatencyHistogram m_encodeTimes;
+	LatencyHistogram m_latencies;
+};
+
+#endif // _FRAME_ENCODER_H_
@@ -0,0 +1,240 @@
+#ifndef _FRAME_PAIRER_H_
+#define _FRAME_PAIRER_H_
+
+// Header Includes
+#include <OpenNI.h>
+#include <deque>
+#include <ostream>
+
+#define PAIRER_HISTOGRAM_BINS 16
+
+// Matches color frames to depth frames by timestamp (or frame index) instead of assuming the
+// Nth frame of each stream belong together. Frames without a partner within the tolerance are
+// held briefly in case it is still on its way, then discarded and counted as orphans. With
+// depthAlone set, as when color is being shed on purpose, depth frames without a partner are handed
+// out on their own instead, with an empty color frame.
+class FramePairer
+{
+public:
+	enum MatchKey
+	{
+		MATCH_TIMESTAMP,	// VideoFrameRef::getTimestamp(), tolerance in microseconds
+		MATCH_FRAME_INDEX	// VideoFrameRef::getFrameIndex(), tolerance in frames
+	};
+
+	FramePairer(MatchKey key, long long tolerance, unsigned int maxPending, bool depthAlone = false) :
+		m_key(key), m_tolerance(tolerance), m_maxPending(maxPending), m_depthAlone(depthAlone), m_flushing(false),
+		m_pairs(0), m_depthOnly(0), m_colorOrphans(0), m_depthOrphans(0), m_skewSum(0), m_skewMin(0), m_skewMax(0)
+	{
+		for(int i = 0; i < PAIRER_HISTOGRAM_BINS; i++)
+		{
+			m_histogram[i] = 0;
+		}
+	}
+
+	void addColor(const openni::VideoFrameRef& frame)
+	{
+		add(m_color, m_colorOrphans, frame, true);
+	}
+
+	void addDepth(const openni::VideoFrameRef& frame)
+	{
+		// Unmatched depth kept for nextPair to hand out alone is let go of there
+		add(m_depth, m_depthOrphans, frame, !m_depthAlone);
+	}
+
+	// Fills color/depth with the next matched pair, or with depthAlone possibly a depth frame with
+	// color released. Returns false when no pair can be formed yet.
+	bool nextPair(openni::VideoFrameRef& color, openni::VideoFrameRef& depth)
+	{
+		while(!m_color.empty() && !m_depth.empty())
+		{
+			long long colorKey = keyOf(m_color.front());
+			long long depthKey = keyOf(m_depth.front());
+
+			// Keys only increase, so a front frame that is too far behind the other side can never be matched
+			if(depthKey - colorKey > m_tolerance)
+			{
+				m_color.pop_front();
+				m_colorOrphans++;
+				continue;
+			}
+			if(colorKey - depthKey > m_tolerance)
+			{
+				if(dropDepth(color, depth))
+				{
+					return true;
+				}
+				continue;
+			}
+
+			// Within tolerance, but prefer the following frame if it is an even closer match
+			long long skew = depthKey - colorKey;
+			if(m_color.size() > 1 && absolute(depthKey - keyOf(m_color[1])) < absolute(skew))
+			{
+				m_color.pop_front();
+				m_colorOrphans++;
+				continue;
+			}
+			if(m_depth.size() > 1 && absolute(keyOf(m_depth[1]) - colorKey) < absolute(skew))
+			{
+				if(dropDepth(color, depth))
+				{
+					return true;
+				}
+				continue;
+			}
+
+			color = m_color.front();
+			depth = m_depth.front();
+			m_color.pop_front();
+			m_depth.pop_front();
+			record(skew);
+			return true;
+		}
+
+		// No color to wait for: depth that has waited as long as a partner could take, or is left
+		// after a flush, goes out alone
+		if(m_depthAlone && !m_depth.empty() && (m_flushing || m_depth.size() > m_maxPending))
+		{
+			return dropDepth(color, depth);
+		}
+		m_flushing = false;
+		return false;
+	}
+
+	// Discards everything still waiting for a partner, e.g. at the end of a recording. With
+	// depthAlone, depth frames are kept for the following nextPair calls to hand out alone.
+	void flush()
+	{
+		m_colorOrphans += m_color.size();
+		m_color.clear();
+		if(m_depthAlone)
+		{
+			m_flushing = !m_depth.empty();
+			return;
+		}
+		m_depthOrphans += m_depth.size();
+		m_depth.clear();
+	}
+
+	unsigned long pairs() const { return m_pairs; }
+	unsigned long depthOnly() const { return m_depthOnly; }
+	unsigned long colorOrphans() const { return m_colorOrphans; }
+	unsigned long depthOrphans() const { return m_depthOrphans; }
+
+	// Prints pair/orphan counts and a histogram of depth-minus-color skew
+	void printStatistics(std::ostream& out) const
+	{
+		const char* unit = (m_key == MATCH_TIMESTAMP) ? "us" : "frames";
+
+		out << "Pairs : " << m_pairs;
+		if(m_depthAlone)
+		{
+			out << " | Depth without color : " << m_depthOnly;
+		}
+		out << " | Color orphans : " << m_colorOrphans << " | Depth orphans : " << m_depthOrphans << std::endl;
+		if(m_pairs == 0)
+		{
+			return;
+		}
+
+		out << "Skew (depth - color) : min " << m_skewMin << unit << ", mean " << m_skewSum / (long long)m_pairs << unit << ", max " << m_skewMax << unit << std::endl;
+		for(int i = 0; i < PAIRER_HISTOGRAM_BINS; i++)
+		{
+			if(m_histogram[i] == 0)
+			{
+				continue;
+			}
+			out << "  [" << binLow(i) << ", " << binLow(i + 1) << ")" << unit << " : " << m_histogram[i] << std::endl;
+		}
+	}
+
+private:
+	void add(std::deque<openni::VideoFrameRef>& queue, unsigned long& orphans, const openni::VideoFrameRef& frame, bool bounded)
+	{
+		queue.push_back(frame);
+
+		// The other side has stopped delivering partners for this stream; don't hold driver buffers indefinitely
+		if(bounded && queue.size() > m_maxPending)
+		{
+			queue.pop_front();
+			orphans++;
+		}
+	}
+
+	// Lets go of the depth frame at the front as an orphan, or with depthAlone hands it out on its
+	// own and returns true
+	bool dropDepth(openni::VideoFrameRef& color, openni::VideoFrameRef& depth)
+	{
+		if(!m_depthAlone)
+		{
+			m_depth.pop_front();
+			m_depthOrphans++;
+			return false;
+		}
+		color.release();
+		depth = m_depth.front();
+		m_depth.pop_front();
+		m_depthOnly++;
+		return true;
+	}
+
+	long long keyOf(const openni::VideoFrameRef& frame) const
+	{
+		if(m_key == MATCH_FRAME_INDEX)
+		{
+			return frame.getFrameIndex();
+		}
+		return (long long)frame.getTimestamp();
+	}
+
+	static long long absolute(long long value)
+	{
+		return value < 0 ? -value : value;
+	}
+
+	// Histogram bins evenly span [-tolerance, tolerance]
+	long long binLow(int bin) const
+	{
+		return -m_tolerance + (2 * m_tolerance + 1) * bin / PAIRER_HISTOGRAM_BINS;
+	}
+
+	void record(long long skew)
+	{
+		if(m_pairs == 0 || skew < m_skewMin)
+		{
+			m_skewMin = skew;
+		}
+		if(m_pairs == 0 || skew > m_skewMax)
+		{
+			m_skewMax = skew;
+		}
+		m_skewSum += skew;
+		m_pairs++;
+
+		int bin = (int)((skew + m_tolerance) * PAIRER_HISTOGRAM_BINS / (2 * m_tolerance + 1));
+		m_histogram[bin]++;
+	}
+
+	MatchKey m_key;
+	long long m_tolerance;
+	unsigned int m_maxPending;
+	bool m_depthAlone;
+	// Set by flush until the depth frames left have been handed out
+	bool m_flushing;
+
+	std::deque<openni::VideoFrameRef> m_color;
+	std::deque<openni::VideoFrameRef> m_depth;
+
+	unsigned long m_pairs;
+	unsigned long m_depthOnly;
+	unsigned long m_colorOrphans;
+	unsigned long m_depthOrphans;
+	long long m_skewSum;
+	long long m_skewMin;
+	long long m_skewMax;
+	unsigned long m_histogram[PAIRER_HISTOGRAM_BINS];
+};
+
+#endif // _FRAME_PAIRER_H_
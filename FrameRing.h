@@ -0,0 +1,100 @@
+#ifndef _FRAME_RING_H_
+#define _FRAME_RING_H_
+
+// Header Includes
+#include <atomic>
+#include <stddef.h>
+
+// Bounded single-producer/single-consumer ring of preallocated slots.
+// The producer fills the slot returned by beginPush() in place and publishes
+// it with commitPush(); the consumer reads front() and hands it back with pop().
+// No locks are taken, so a slow consumer never blocks the producer: when the
+// ring is full beginPush() returns NULL and the caller decides what to shed.
+template <typename T>
+class FrameRing
+{
+public:
+	// Capacity is rounded up to a power of two so indices wrap with a mask
+	FrameRing(unsigned int capacity) : m_head(0), m_tail(0), m_highWater(0), m_pushed(0), m_overruns(0)
+	{
+		m_capacity = 1;
+		while (m_capacity < capacity)
+		{
+			m_capacity <<= 1;
+		}
+		m_mask = m_capacity - 1;
+		m_slots = new T[m_capacity];
+	}
+
+	~FrameRing()
+	{
+		delete[] m_slots;
+	}
+
+	// Producer side: returns the next free slot, or NULL (and counts an overrun) if the ring is full
+	T* beginPush()
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail.load(std::memory_order_acquire) >= m_capacity)
+		{
+			m_overruns.fetch_add(1, std::memory_order_relaxed);
+			return NULL;
+		}
+		return &m_slots[head & m_mask];
+	}
+
+	// Producer side: publishes the slot returned by the last beginPush()
+	void commitPush()
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed) + 1;
+		m_head.store(head, std::memory_order_release);
+		m_pushed.fetch_add(1, std::memory_order_relaxed);
+
+		unsigned int used = head - m_tail.load(std::memory_order_acquire);
+		if (used > m_highWater.load(std::memory_order_relaxed))
+		{
+			m_highWater.store(used, std::memory_order_relaxed);
+		}
+	}
+
+	// Consumer side: returns the oldest published slot, or NULL if the ring is empty
+	T* front()
+	{
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		if (tail == m_head.load(std::memory_order_acquire))
+		{
+			return NULL;
+		}
+		return &m_slots[tail & m_mask];
+	}
+
+	// Consumer side: releases the slot returned by front() back to the producer
+	void pop()
+	{
+		m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Counters, safe to read from any thread
+	unsigned int capacity() const { return m_capacity; }
+	unsigned int occupancy() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+	unsigned int highWater() const { return m_highWater.load(std::memory_order_relaxed); }
+	unsigned long pushed() const { return m_pushed.load(std::memory_order_relaxed); }
+	unsigned long overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+
+private:
+	FrameRing(const FrameRing&);
+	FrameRing& operator=(const FrameRing&);
+
+	T* m_slots;
+	unsigned int m_capacity;
+	unsigned int m_mask;
+
+	// Producer and consumer indices live on separate cache lines
+	alignas(64) std::atomic<unsigned int> m_head;
+	alignas(64) std::atomic<unsigned int> m_tail;
+	alignas(64) std::atomic<unsigned int> m_highWater;
+	std::atomic<unsigned long> m_pushed;
+	std::atomic<unsigned long> m_overruns;
+};
+
+#endif // _FRAME_RING_H_
@@ -0,0 +1,157 @@
+#ifndef _LATENCY_STATS_H_
+#define _LATENCY_STATS_H_
+
+// Header Includes
+#include <ostream>
+#include <stdint.h>
+#include <stdio.h>
+
+// Microsecond bins: one per value below 8, then each power of two split into 8 equal steps, so a
+// bin is at most 1/8 of its lower bound wide. 256 bins reach past an hour; the last is open-ended.
+#define LATENCY_HISTOGRAM_SUB_BITS 3
+#define LATENCY_HISTOGRAM_BINS 256
+
+// Distribution of latencies in microseconds, e.g. from a frame's host timestamp to the moment a
+// thread handled it. Updated by a single thread without locking, read once that thread is done.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram() : m_count(0), m_sum(0), m_max(0)
+	{
+		for(int i = 0; i < LATENCY_HISTOGRAM_BINS; i++)
+		{
+			m_bins[i] = 0;
+		}
+	}
+
+	void add(uint64_t latency)
+	{
+		m_bins[binOf(latency)]++;
+		m_count++;
+		m_sum += latency;
+		m_max = (latency > m_max) ? latency : m_max;
+	}
+
+	// Upper bound of the bin holding the given fraction of samples (at most the maximum), e.g. 0.99 for the 99th percentile
+	uint64_t percentile(double fraction) const
+	{
+		uint64_t wanted = (uint64_t)(m_count * fraction + 0.5);
+		wanted = (wanted > 0) ? wanted : 1;
+		uint64_t seen = 0;
+		for(int i = 0; i < LATENCY_HISTOGRAM_BINS - 1; i++)
+		{
+			seen += m_bins[i];
+			if(seen >= wanted)
+			{
+				return (binLow(i + 1) < m_max) ? binLow(i + 1) : m_max;
+			}
+		}
+		return m_max;
+	}
+
+	// Prints mean, percentile bounds and the worst case on one line
+	void printStatistics(std::ostream& out, const char* name) const
+	{
+		char line[256];
+		if(m_count == 0)
+		{
+			snprintf(line, sizeof(line), "%s latency : no samples", name);
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "%s latency : mean %llu us, 50%% < %llu us, 99%% < %llu us, 99.9%% < %llu us, max %llu us (%llu samples)", name,
+				(unsigned long long)(m_sum / m_count), (unsigned long long)percentile(0.5), (unsigned long long)percentile(0.99),
+				(unsigned long long)percentile(0.999), (unsigned long long)m_max, (unsigned long long)m_count);
+		}
+		out << line << std::endl;
+	}
+
+	// Appends one "device,stage,bin_low_us,bin_high_us,count" CSV row per non-empty bin; the last
+	// bin's upper bound is the maximum seen
+	void writeCsv(FILE* file, const char* device, const char* stage) const
+	{
+		for(int i = 0; i < LATENCY_HISTOGRAM_BINS; i++)
+		{
+			if(m_bins[i] != 0)
+			{
+				uint64_t high = (i < LATENCY_HISTOGRAM_BINS - 1) ? binLow(i + 1) : m_max;
+				fprintf(file, "%s,%s,%llu,%llu,%llu\n", device, stage, (unsigned long long)binLow(i), (unsigned long long)high, (unsigned long long)m_bins[i]);
+			}
+		}
+	}
+
+	uint64_t count() const { return m_count; }
+	uint64_t max() const { return m_max; }
+
+private:
+	static int binOf(uint64_t latency)
+	{
+		const uint64_t steps = 1 << LATENCY_HISTOGRAM_SUB_BITS;
+		if(latency < steps)
+		{
+			return (int)latency;
+		}
+		int octave = 63 - __builtin_clzll(latency);
+		int shift = octave - LATENCY_HISTOGRAM_SUB_BITS;
+		int bin = ((shift + 1) << LATENCY_HISTOGRAM_SUB_BITS) + (int)((latency >> shift) & (steps - 1));
+		return (bin < LATENCY_HISTOGRAM_BINS) ? bin : LATENCY_HISTOGRAM_BINS - 1;
+	}
+
+	static uint64_t binLow(int bin)
+	{
+		const int steps = 1 << LATENCY_HISTOGRAM_SUB_BITS;
+		if(bin < steps)
+		{
+			return bin;
+		}
+		int shift = (bin >> LATENCY_HISTOGRAM_SUB_BITS) - 1;
+		return (uint64_t)(steps + (bin & (steps - 1))) << shift;
+	}
+
+	uint64_t m_bins[LATENCY_HISTOGRAM_BINS];
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_max;
+};
+
+// Frames a stream skipped, judged by jumps in the driver's frame index. An index that doesn't
+// move forward means the stream restarted (e.g. after a reconnect) and is not counted as a gap.
+// Updated by the single thread reading the stream.
+class FrameIndexGaps
+{
+public:
+	FrameIndexGaps() : m_last(-1), m_gaps(0), m_missing(0), m_largest(0)
+	{
+	}
+
+	void observe(int frameIndex)
+	{
+		if(m_last >= 0 && frameIndex > m_last + 1)
+		{
+			uint64_t missing = frameIndex - m_last - 1;
+			m_gaps++;
+			m_missing += missing;
+			m_largest = (missing > m_largest) ? missing : m_largest;
+		}
+		m_last = frameIndex;
+	}
+
+	void printStatistics(std::ostream& out, const char* name) const
+	{
+		char line[256];
+		snprintf(line, sizeof(line), "%s frame index gaps : %llu, %llu frames missing, largest %llu", name,
+			(unsigned long long)m_gaps, (unsigned long long)m_missing, (unsigned long long)m_largest);
+		out << line << std::endl;
+	}
+
+	uint64_t gaps() const { return m_gaps; }
+	uint64_t missing() const { return m_missing; }
+
+private:
+	int m_last;
+	uint64_t m_gaps;
+	uint64_t m_missing;
+	uint64_t m_largest;
+};
+
+#endif // _LATENCY_STATS_H_
@@ -2,6 +2,10 @@
 #include <opencv2/opencv.hpp>
 #include <OpenNI.h>
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../../DepthColormap.h"
 
 #define DEPTH_FILE_NAME "depthOut.dat"
 #define IMAGE_FILE_NAME "imageOut.dat"
@@ -113,6 +117,15 @@ int main( const int argc, const char* argv[] )
 	cv::Mat dImg = cv::Mat( dImgHeight, dImgWidth, CV_8UC3 );
 	cv::Mat dRaw = cv::Mat (dImgHeight, dImgWidth, CV_16UC1 );
 
+	// Depth colormap, from the optional [rainbow|gray] [Scale] arguments
+	DepthColorizer colorizer;
+	if ( argc >= 2 )
+	{
+		DepthColormap colormap = ( strcmp( argv[1], "gray" ) == 0 ) ? DEPTH_COLORMAP_GRAY : DEPTH_COLORMAP_RAINBOW;
+		int scale = ( argc >= 3 ) ? atoi( argv[2] ) : DEFAULT_DEPTH_COLORMAP_SCALE;
+		colorizer.configure( colormap, scale );
+	}
+
 	// Get FPS Information
 	cout << "Color : " << color.getVideoMode().getFps() << "(fps) | Depth : " << depth.getVideoMode().getFps() << "(fps)" << endl;
 
@@ -142,60 +155,7 @@ int main( const int argc, const char* argv[] )
 		fwrite(colorImgRaw, 3, cImgWidth * cImgHeight, ImageFile);
 		
 		openni::DepthPixel* depthImgRaw = (openni::DepthPixel*)depthFrame.getData();
-		int lb, ub;
-		for ( int i = 0 ; i < ( depthFrame.getDataSize() / sizeof( openni::DepthPixel ) ) ; i++ )
-		{
-			int idx = i * 3; // Grayscale
-			unsigned char* data = &dImg.data[idx];
-			
-			lb = (depthImgRaw[i]/5) % 256;
-			ub = depthImgRaw[i]/5 / 256;
-
-			switch (ub) {
-				case 0:
-					data[2] = 255;
-					data[1] = 255-lb;
-					data[0] = 255-lb;
-					break;
-				case 1:
-					data[2] = 255;
-					data[1] = lb;
-					data[0] = 0;
-					break;
-				case 2:
-					data[2] = 255-lb;
-					data[1] = 255;
-					data[0] = 0;
-					break;
-				case 3:
-					data[2] = 0;
-					data[1] = 255;
-					data[0] = lb;
-					break;
-				case 4:
-					data[2] = 0;
-					data[1] = 255-lb;
-					data[0] = 255;
-					break;
-				case 5:
-					data[2] = 0;
-					data[1] = 0;
-					data[0] = 255-lb;
-					break;
-				default:
-					data[2] = 0;
-					data[1] = 0;
-					data[0] = 0;
-					break;
-			}
-
-			/*
-			int gray_scale = ( ( depthImgRaw[i] * 255 ) / ( maxDepthValue - minDepthValue ) );
-			data[0] = (unsigned char)~gray_scale;
-			data[1] = (unsigned char)~gray_scale;
-			data[2] = (unsigned char)~gray_scale;
-			*/
-		}
+		colorizer.colorize((const uint16_t*)depthImgRaw, dImgWidth, dImgHeight, depthFrame.getStrideInBytes(), dImg.data, dImg.step);
 		
 		fwrite(depthImgRaw, sizeof(openni::DepthPixel), cImgWidth * cImgHeight, DepthFile);
 
@@ -0,0 +1,122 @@
+// Header Includes
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "BenchFrames.h"
+#include "DepthToWorld.h"
+
+#define DEFAULT_ITERATIONS 50
+
+// Namespaces
+using namespace std;
+
+// What openni::CoordinateConverter::convertDepthToWorld computes for one pixel, kept out of line
+// like the driver call so the reference pays the same per-pixel call overhead
+__attribute__((noinline))
+void ConvertDepthToWorldReference(float xzFactor, float yzFactor, int width, int height, float depthX, float depthY, float depthZ, float* pWorldX, float* pWorldY, float* pWorldZ)
+{
+	float normalizedX = depthX / width - .5f;
+	float normalizedY = .5f - depthY / height;
+	*pWorldX = normalizedX * depthZ * xzFactor;
+	*pWorldY = normalizedY * depthZ * yzFactor;
+	*pWorldZ = depthZ;
+}
+
+// Compares whole-frame ray table conversion with converting each pixel through the OpenNI
+// formula: ns per frame, points per second, and the largest difference between the two.
+// Uses the depth frames of a recording if one is given, otherwise synthetic frames.
+int main( const int argc, const char* argv[] )
+{
+	RecordingReader reader;
+	int iterations = DEFAULT_ITERATIONS;
+	if(!OpenBenchRecording(argc, argv, reader, iterations))
+	{
+		return EXIT_FAILURE;
+	}
+
+	// Benchmark frames, packed without row padding
+	int width = BENCH_LEGACY_RES_X;
+	int height = BENCH_LEGACY_RES_Y;
+	std::vector< std::vector<uint16_t> > frames;
+	ReadBenchFrames(reader, RECORDING_STREAM_DEPTH, width, height, frames);
+	if(frames.empty())
+	{
+		SyntheticDepthFrames(width, height, frames);
+	}
+
+	double horizontalFov = DEFAULT_DEPTH_FOV_H;
+	double verticalFov = DEFAULT_DEPTH_FOV_V;
+	if(reader.header() != NULL && reader.header()->streams[RECORDING_STREAM_DEPTH].horizontalFov > 0)
+	{
+		horizontalFov = reader.header()->streams[RECORDING_STREAM_DEPTH].horizontalFov;
+		verticalFov = reader.header()->streams[RECORDING_STREAM_DEPTH].verticalFov;
+	}
+	DepthToWorld converter;
+	converter.configure(width, height, horizontalFov, verticalFov);
+
+	int pixels = width * height;
+	cout << "Depth frames : " << frames.size() << " (" << width << "x" << height << "), " << iterations << " iterations" << endl;
+
+	std::vector<float> expected(pixels * 3);
+	std::vector<float> actual(pixels * 3);
+
+	// Per-pixel conversion
+	float xzFactor = (float)(tan(horizontalFov / 2) * 2);
+	float yzFactor = (float)(tan(verticalFov / 2) * 2);
+	double start = Seconds();
+	for(int i = 0; i < iterations; i++)
+	{
+		for(size_t f = 0; f < frames.size(); f++)
+		{
+			for(int v = 0; v < height; v++)
+			{
+				for(int u = 0; u < width; u++)
+				{
+					int p = v * width + u;
+					ConvertDepthToWorldReference(xzFactor, yzFactor, width, height, u, v, frames[f][p], &expected[p * 3 + 0], &expected[p * 3 + 1], &expected[p * 3 + 2]);
+				}
+			}
+		}
+	}
+	double referenceNs = 1e9 * (Seconds() - start) / (iterations * frames.size());
+
+	// Ray tables
+	start = Seconds();
+	for(int i = 0; i < iterations; i++)
+	{
+		for(size_t f = 0; f < frames.size(); f++)
+		{
+			converter.convert(&frames[f][0], width * sizeof(uint16_t), &actual[0]);
+		}
+	}
+	double ns = 1e9 * (Seconds() - start) / (iterations * frames.size());
+
+	// Both conversions round differently, so compare relative to each point's depth
+	double maxError = 0;
+	for(size_t f = 0; f < frames.size(); f++)
+	{
+		converter.convert(&frames[f][0], width * sizeof(uint16_t), &actual[0]);
+		for(int v = 0; v < height; v++)
+		{
+			for(int u = 0; u < width; u++)
+			{
+				int p = v * width + u;
+				float x, y, z;
+				ConvertDepthToWorldReference(xzFactor, yzFactor, width, height, u, v, frames[f][p], &x, &y, &z);
+				double error = max(fabs(actual[p * 3 + 0] - x), max(fabs(actual[p * 3 + 1] - y), fabs(actual[p * 3 + 2] - z)));
+				maxError = max(maxError, error / max((double)z, 1.0));
+			}
+		}
+	}
+
+	printf("Per-pixel : %9.0f ns/frame (%.1f Mpoints/s)\n", referenceNs, 1e3 * pixels / referenceNs);
+	printf("Ray table : %9.0f ns/frame (%.1f Mpoints/s, %.1fx)\n", ns, 1e3 * pixels / ns, referenceNs / ns);
+	bool matches = maxError < 1e-6;
+	printf("Largest difference : %.3f ppm of depth %s\n", maxError * 1e6, matches ? "(matches)" : "MISMATCH");
+
+	return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,93 @@
+#ifndef _POINT_CLOUD_EXPORT_H_
+#define _POINT_CLOUD_EXPORT_H_
+
+// Header Includes
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "PointCloudFormat.h"
+
+// Points converted per fwrite when the file layout differs from PointXYZRGB
+#define POINT_CLOUD_EXPORT_CHUNK 4096
+
+// File formats understood by downstream tools
+enum PointCloudFileFormat
+{
+	POINT_CLOUD_FILE_PLY,	// Binary little-endian PLY, vertices with float x y z and uchar red green blue
+	POINT_CLOUD_FILE_PCD	// Binary PCD v0.7, fields x y z rgb with rgb packed PCL-style into a float
+};
+
+// File name extension for a format, without the dot
+inline const char* PointCloudFileExtension(PointCloudFileFormat format)
+{
+	return (format == POINT_CLOUD_FILE_PCD) ? "pcd" : "ply";
+}
+
+// Writes one cloud in binary PLY. An organized cloud (width * height points, row-major, as built
+// by BuildColoredCloud) records its grid size in the header comments; an unorganized one doesn't.
+// PLY's vertex layout is exactly PointXYZRGB, so the points are written without conversion.
+inline bool WritePly(const char* fileName, const PointXYZRGB* points, uint32_t pointCount, int width, int height, bool organized)
+{
+	FILE* file = fopen(fileName, "wb");
+	if(file == NULL)
+	{
+		return false;
+	}
+
+	bool ok = fprintf(file, "ply\nformat binary_little_endian 1.0\ncomment units mm\n") > 0;
+	if(organized)
+	{
+		ok = fprintf(file, "comment width %d\ncomment height %d\n", width, height) > 0 && ok;
+	}
+	ok = fprintf(file, "element vertex %u\nproperty float x\nproperty float y\nproperty float z\n"
+		"property uchar red\nproperty uchar green\nproperty uchar blue\nend_header\n", pointCount) > 0 && ok;
+	ok = fwrite(points, sizeof(PointXYZRGB), pointCount, file) == pointCount && ok;
+
+	return (fclose(file) == 0) && ok;
+}
+
+// Writes one cloud in binary PCD. Organized clouds keep their width x height grid, unorganized
+// ones are a single row. Coordinates stay in millimetres as OpenNI gives them.
+inline bool WritePcd(const char* fileName, const PointXYZRGB* points, uint32_t pointCount, int width, int height, bool organized)
+{
+	FILE* file = fopen(fileName, "wb");
+	if(file == NULL)
+	{
+		return false;
+	}
+
+	bool ok = fprintf(file, "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\nFIELDS x y z rgb\nSIZE 4 4 4 4\nTYPE F F F F\nCOUNT 1 1 1 1\n"
+		"WIDTH %u\nHEIGHT %u\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS %u\nDATA binary\n",
+		organized ? width : pointCount, organized ? height : 1, pointCount) > 0;
+
+	float chunk[POINT_CLOUD_EXPORT_CHUNK * 4];
+	for(uint32_t first = 0; ok && first < pointCount; first += POINT_CLOUD_EXPORT_CHUNK)
+	{
+		uint32_t count = (pointCount - first < POINT_CLOUD_EXPORT_CHUNK) ? pointCount - first : POINT_CLOUD_EXPORT_CHUNK;
+		for(uint32_t i = 0; i < count; i++)
+		{
+			const PointXYZRGB& point = points[first + i];
+			uint32_t rgb = ((uint32_t)point.r << 16) | ((uint32_t)point.g << 8) | point.b;
+			chunk[i * 4 + 0] = point.x;
+			chunk[i * 4 + 1] = point.y;
+			chunk[i * 4 + 2] = point.z;
+			memcpy(&chunk[i * 4 + 3], &rgb, sizeof(rgb));
+		}
+		ok = fwrite(chunk, sizeof(float) * 4, count, file) == count;
+	}
+
+	return (fclose(file) == 0) && ok;
+}
+
+// Writes one cloud in the given format
+inline bool WritePointCloudFile(PointCloudFileFormat format, const char* fileName, const PointXYZRGB* points, uint32_t pointCount, int width, int height, bool organized)
+{
+	if(format == POINT_CLOUD_FILE_PCD)
+	{
+		return WritePcd(fileName, points, pointCount, width, height, organized);
+	}
+	return WritePly(fileName, points, pointCount, width, height, organized);
+}
+
+#endif // _POINT_CLOUD_EXPORT_H_
@@ -0,0 +1,59 @@
+#ifndef _POINT_CLOUD_FORMAT_H_
+#define _POINT_CLOUD_FORMAT_H_
+
+// Header Includes
+#include <stdint.h>
+
+// On-disk layout of a point cloud stream (.pcl) file. All fields are little-endian.
+//
+//   PointCloudHeader
+//   PointCloudFrameHeader + PointXYZRGB[pointCount], once per captured frame pair
+//
+// Frames are appended as they are captured, so a file cut short by a crash is still readable
+// up to its last complete frame. Points are in millimetres in the depth camera's frame
+// (x right, y up, z forward), as given by openni::CoordinateConverter::convertDepthToWorld.
+// This header has no OpenNI dependency so offline tools can include it on its own.
+
+#define POINT_CLOUD_FILE_MAGIC 0x444C4350	// "PCLD"
+#define POINT_CLOUD_FRAME_MAGIC 0x52464350	// "PCFR"
+#define POINT_CLOUD_VERSION 1
+
+// PointCloudHeader::flags
+#define POINT_CLOUD_FLAG_SKIP_INVALID 0x1	// Zero-depth points are left out, so frames vary in size; otherwise they are NaN
+
+#pragma pack(push, 1)
+
+struct PointCloudHeader
+{
+	uint32_t magic;	// POINT_CLOUD_FILE_MAGIC
+	uint32_t version;	// POINT_CLOUD_VERSION
+	uint32_t headerSize;	// sizeof(PointCloudHeader)
+	uint32_t pointSize;	// sizeof(PointXYZRGB)
+	uint32_t width;	// Depth resolution; a frame without skipped points has width * height points
+	uint32_t height;
+	uint32_t flags;	// POINT_CLOUD_FLAG_*
+	uint32_t reserved;
+};
+
+struct PointCloudFrameHeader
+{
+	uint32_t magic;	// POINT_CLOUD_FRAME_MAGIC
+	uint32_t frameIndex;	// Depth frame index from the driver
+	uint64_t timestamp;	// Depth frame timestamp in microseconds
+	uint32_t pointCount;
+	uint32_t reserved;
+};
+
+struct PointXYZRGB
+{
+	float x;
+	float y;
+	float z;
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+};
+
+#pragma pack(pop)
+
+#endif // _POINT_CLOUD_FORMAT_H_
@@ -0,0 +1,208 @@
+#ifndef _POINT_CLOUD_WRITER_H_
+#define _POINT_CLOUD_WRITER_H_
+
+// Header Includes
+#include <OpenNI.h>
+#include <PS1080.h>
+#include <ostream>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "DepthToWorld.h"
+#include "FrameCopy.h"
+#include "PointCloudFormat.h"
+#include "WorkerPool.h"
+
+// stdio buffer for the point cloud file; a VGA frame of points is about 4.6 MB
+#define POINT_CLOUD_BUFFER_SIZE (8 * 1024 * 1024)
+
+// Builds the depth-to-world ray tables for a depth stream: its field of view if the driver
+// reports one, else the PS1080 zero plane properties, else the PrimeSense defaults
+inline void ConfigureDepthToWorld(DepthToWorld& converter, const openni::VideoStream& depth)
+{
+	const openni::VideoMode mode = depth.getVideoMode();
+	float horizontalFov = depth.getHorizontalFieldOfView();
+	float verticalFov = depth.getVerticalFieldOfView();
+	if(horizontalFov > 0 && verticalFov > 0)
+	{
+		converter.configure(mode.getResolutionX(), mode.getResolutionY(), horizontalFov, verticalFov);
+		return;
+	}
+
+	uint64_t zeroPlaneDistance = 0;
+	double zeroPlanePixelSize = 0;
+	depth.getProperty<uint64_t>(XN_STREAM_PROPERTY_ZERO_PLANE_DISTANCE, &zeroPlaneDistance);
+	depth.getProperty<double>(XN_STREAM_PROPERTY_ZERO_PLANE_PIXEL_SIZE, &zeroPlanePixelSize);
+	if(!converter.configureZeroPlane(mode.getResolutionX(), mode.getResolutionY(), zeroPlaneDistance, zeroPlanePixelSize))
+	{
+		converter.configure(mode.getResolutionX(), mode.getResolutionY(), DEFAULT_DEPTH_FOV_H, DEFAULT_DEPTH_FOV_V);
+	}
+}
+
+// A color/depth pair being turned into a point cloud record on the writer's pool
+struct PointCloudJob
+{
+	HeldFrame color;
+	HeldFrame depth;
+	// PointCloudFrameHeader followed by the points, ready to append to the file
+	std::vector<uint8_t> record;
+	uint32_t pointCount;
+};
+
+// Streams colored point clouds for a whole session into one .pcl file (see PointCloudFormat.h).
+// Each frame pair is converted on a pool of worker threads and appended, in capture order, through
+// a large stdio buffer.
+class PointCloudWriter
+{
+public:
+	PointCloudWriter(const DepthToWorld& converter, bool skipInvalid, unsigned int threads, unsigned int maxQueued) :
+		m_converter(converter), m_skipInvalid(skipInvalid), m_file(NULL), m_bytesWritten(0), m_frameCount(0), m_pointCount(0), m_failed(false),
+		m_pool(threads, maxQueued, [this](PointCloudJob& job) { build(job); })
+	{
+	}
+
+	~PointCloudWriter()
+	{
+		close();
+	}
+
+	// Creates the file and writes the header. Returns false if the file can't be written.
+	bool open(const char* fileName)
+	{
+		m_file = fopen(fileName, "wb");
+		if(m_file == NULL)
+		{
+			return false;
+		}
+		setvbuf(m_file, NULL, _IOFBF, POINT_CLOUD_BUFFER_SIZE);
+
+		PointCloudHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = POINT_CLOUD_FILE_MAGIC;
+		header.version = POINT_CLOUD_VERSION;
+		header.headerSize = sizeof(header);
+		header.pointSize = sizeof(PointXYZRGB);
+		header.width = m_converter.width();
+		header.height = m_converter.height();
+		header.flags = m_skipInvalid ? POINT_CLOUD_FLAG_SKIP_INVALID : 0;
+		return write(&header, sizeof(header));
+	}
+
+	// Queues a pair of driver frames or of FrameCopy for conversion. If the pool is backed up,
+	// writes its oldest frame first.
+	template<typename Frame>
+	void submit(const Frame& color, const Frame& depth)
+	{
+		if(m_pool.full())
+		{
+			drain(false, true);
+		}
+
+		PointCloudJob job;
+		job.color = color;
+		job.depth = depth;
+		job.pointCount = 0;
+		m_pool.submit(std::move(job));
+	}
+
+	// Appends frames that have finished converting. With wait, blocks until every submitted frame
+	// is written; with waitForOne, blocks for the oldest one before taking any others that are ready.
+	void drain(bool wait, bool waitForOne = false)
+	{
+		PointCloudJob job;
+		while(m_pool.next(job, wait || waitForOne))
+		{
+			waitForOne = false;
+			if(!job.record.empty() && write(&job.record[0], job.record.size()))
+			{
+				m_frameCount++;
+				m_pointCount += job.pointCount;
+			}
+			job.color.release();
+			job.depth.release();
+		}
+	}
+
+	// Writes out everything still queued and closes the file. Returns false if any write failed.
+	bool close()
+	{
+		if(m_file == NULL)
+		{
+			return !m_failed;
+		}
+		drain(true);
+		m_failed = (fclose(m_file) != 0) || m_failed;
+		m_file = NULL;
+		return !m_failed;
+	}
+
+	// Prints frames, points and data rate written
+	void printStatistics(std::ostream& out)
+	{
+		char line[256];
+		snprintf(line, sizeof(line), "Point clouds : %llu frames, %llu points (%.0f per frame), %.1f MB on %u threads",
+			(unsigned long long)m_frameCount, (unsigned long long)m_pointCount, m_frameCount ? (double)m_pointCount / m_frameCount : 0.0,
+			m_bytesWritten / 1048576.0, m_pool.threads());
+		out << line << std::endl;
+	}
+
+	uint64_t bytesWritten() const { return m_bytesWritten; }
+	uint64_t frameCount() const { return m_frameCount; }
+	std::vector<std::thread::native_handle_type> workerThreads() { return m_pool.threadHandles(); }
+
+private:
+	PointCloudWriter(const PointCloudWriter&);
+	PointCloudWriter& operator=(const PointCloudWriter&);
+
+	// Runs on the pool threads: converts the pair straight into the record's point array
+	void build(PointCloudJob& job)
+	{
+		int width = m_converter.width();
+		int height = m_converter.height();
+		job.record.clear();
+		if(job.depth.getWidth() != width || job.depth.getHeight() != height)
+		{
+			return;
+		}
+
+		job.record.resize(sizeof(PointCloudFrameHeader) + (size_t)width * height * sizeof(PointXYZRGB));
+		uint32_t count = BuildColoredCloud(m_converter, (const uint16_t*)job.depth.getData(), job.depth.getStrideInBytes(),
+			(const uint8_t*)job.color.getData(), job.color.getWidth(), job.color.getHeight(), job.color.getStrideInBytes(), !m_skipInvalid,
+			(PointXYZRGB*)&job.record[sizeof(PointCloudFrameHeader)]);
+		job.record.resize(sizeof(PointCloudFrameHeader) + (size_t)count * sizeof(PointXYZRGB));
+
+		PointCloudFrameHeader frame;
+		memset(&frame, 0, sizeof(frame));
+		frame.magic = POINT_CLOUD_FRAME_MAGIC;
+		frame.frameIndex = job.depth.getFrameIndex();
+		frame.timestamp = job.depth.getTimestamp();
+		frame.pointCount = count;
+		memcpy(&job.record[0], &frame, sizeof(frame));
+		job.pointCount = count;
+	}
+
+	bool write(const void* data, size_t size)
+	{
+		if(fwrite(data, 1, size, m_file) != size)
+		{
+			m_failed = true;
+			return false;
+		}
+		m_bytesWritten += size;
+		return true;
+	}
+
+	DepthToWorld m_converter;
+	bool m_skipInvalid;
+	FILE* m_file;
+	uint64_t m_bytesWritten;
+	uint64_t m_frameCount;
+	uint64_t m_pointCount;
+	bool m_failed;
+
+	// Last, so the workers start only once everything they use is set up
+	OrderedWorkerPool<PointCloudJob> m_pool;
+};
+
+#endif // _POINT_CLOUD_WRITER_H_
@@ -0,0 +1,250 @@
+#ifndef _PREVIEW_H_
+#define _PREVIEW_H_
+
+// Header Includes
+#include <opencv2/opencv.hpp>
+#include <OpenNI.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "ColorSwizzle.h"
+#include "DepthColormap.h"
+#include "DeviceClock.h"
+#include "LatencyStats.h"
+
+// Converts an RGB888 color frame into a BGR image for display. A cropped frame is placed at its
+// crop origin when the image is big enough to hold the full video mode, otherwise at the top left.
+inline void ConvertColorFrame(const openni::VideoFrameRef& colorFrame, cv::Mat& cImg)
+{
+	int originX = 0;
+	int originY = 0;
+	if(colorFrame.getCroppingEnabled() &&
+		colorFrame.getCropOriginX() + colorFrame.getWidth() <= cImg.cols && colorFrame.getCropOriginY() + colorFrame.getHeight() <= cImg.rows)
+	{
+		originX = colorFrame.getCropOriginX();
+		originY = colorFrame.getCropOriginY();
+	}
+	SwizzleRgbToBgr((const uint8_t*)colorFrame.getData(), colorFrame.getWidth(), colorFrame.getHeight(), colorFrame.getStrideInBytes(),
+		cImg.data + originY * cImg.step + originX * 3, cImg.step);
+}
+
+// Colorizes a depth frame into a BGR image for display through the colorizer's lookup table
+inline void ColorizeDepthFrame(const openni::VideoFrameRef& depthFrame, const DepthColorizer& colorizer, cv::Mat& dImg)
+{
+	colorizer.colorize((const uint16_t*)depthFrame.getData(), depthFrame.getWidth(), depthFrame.getHeight(), depthFrame.getStrideInBytes(), dImg.data, dImg.step);
+}
+
+// Receives display images built from captured frames
+class PreviewConsumer
+{
+public:
+	virtual ~PreviewConsumer() {}
+
+	virtual void onColorImage(const cv::Mat& cImg, const openni::VideoFrameRef& colorFrame) = 0;
+	virtual void onDepthImage(const cv::Mat& dImg, const openni::VideoFrameRef& depthFrame) = 0;
+};
+
+// Shows the images in OpenCV windows
+class WindowPreview : public PreviewConsumer
+{
+public:
+	void onColorImage(const cv::Mat& cImg, const openni::VideoFrameRef&)
+	{
+		cv::imshow( "color", cImg );
+	}
+
+	void onDepthImage(const cv::Mat& dImg, const openni::VideoFrameRef&)
+	{
+		cv::imshow( "depth", dImg );
+		cv::waitKey( 1 );
+	}
+};
+
+// Optional visualization stage. Display images are only built when a consumer is attached,
+// and then only for every decimation'th frame, so headless runs do no per-pixel display work.
+// Frame pairs are handed to a display thread through a one-pair mailbox: a pair offered while the
+// display is still busy replaces the one waiting, so a slow window never holds up the caller.
+class Preview
+{
+public:
+	Preview() : m_consumer(NULL), m_decimation(1), m_pending(false), m_busy(false), m_stop(false), m_shown(0), m_replaced(0)
+	{
+	}
+
+	~Preview()
+	{
+		stop();
+	}
+
+	// Starts the display thread feeding the consumer
+	void attach(PreviewConsumer* consumer, int decimation)
+	{
+		stop();
+		m_consumer = consumer;
+		m_decimation = (decimation > 0) ? decimation : 1;
+		m_stop = false;
+		m_thread = std::thread(&Preview::run, this);
+	}
+
+	// Finishes the display thread and lets go of any frames it still holds
+	void stop()
+	{
+		if(!m_thread.joinable())
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_ready.notify_one();
+		m_thread.join();
+		m_color.release();
+		m_depth.release();
+		m_pending = false;
+	}
+
+	// Lets go of the frames waiting and waits for the display to finish with the ones it is showing,
+	// so the streams they came from can be destroyed
+	void release()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_color.release();
+		m_depth.release();
+		m_pending = false;
+		while(m_busy)
+		{
+			m_done.wait(lock);
+		}
+	}
+
+	// Picks the depth colormap and its scale in millimetres per step
+	void setColormap(DepthColormap colormap, int scale)
+	{
+		m_colorizer.configure(colormap, scale);
+	}
+
+	// True if the frame pair with this number should be shown
+	bool due(int frameNumber) const
+	{
+		return m_consumer != NULL && frameNumber % m_decimation == 0;
+	}
+
+	// Hands a frame pair to the display thread, replacing one it hasn't got to yet. Only takes
+	// references to the frames, no pixels are copied.
+	void show(const openni::VideoFrameRef& colorFrame, const openni::VideoFrameRef& depthFrame)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_replaced += m_pending;
+			m_color = colorFrame;
+			m_depth = depthFrame;
+			m_pending = true;
+		}
+		m_ready.notify_one();
+	}
+
+	// Time converting color and colorizing depth on the display thread; read once it has stopped
+	const LatencyHistogram& convertTime() const { return m_convertTime; }
+	const LatencyHistogram& colorizeTime() const { return m_colorizeTime; }
+	// Pairs displayed, and pairs replaced in the mailbox before the display got to them
+	uint64_t shown() const { return m_shown; }
+	uint64_t replaced() const { return m_replaced; }
+
+private:
+	Preview(const Preview&);
+	Preview& operator=(const Preview&);
+
+	// Display thread: builds and shows the images of the latest pair offered
+	void run()
+	{
+		openni::VideoFrameRef colorFrame;
+		openni::VideoFrameRef depthFrame;
+		while(true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while(!m_pending && !m_stop)
+				{
+					m_ready.wait(lock);
+				}
+				if(m_stop)
+				{
+					break;
+				}
+				colorFrame = m_color;
+				depthFrame = m_depth;
+				m_color.release();
+				m_depth.release();
+				m_pending = false;
+				m_busy = true;
+			}
+
+			uint64_t start = HostClockMicroseconds();
+			showColor(colorFrame);
+			uint64_t converted = HostClockMicroseconds();
+			showDepth(depthFrame);
+			m_convertTime.add(converted - start);
+			m_colorizeTime.add(HostClockMicroseconds() - converted);
+			m_shown++;
+			colorFrame.release();
+			depthFrame.release();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_busy = false;
+			}
+			m_done.notify_all();
+		}
+	}
+
+	// A cropped frame is shown within the full video mode, at its crop origin
+	void showColor(const openni::VideoFrameRef& colorFrame)
+	{
+		if(colorFrame.getCroppingEnabled())
+		{
+			m_cImg.create(colorFrame.getVideoMode().getResolutionY(), colorFrame.getVideoMode().getResolutionX(), CV_8UC3);
+			m_cImg.setTo(cv::Scalar::all(0));
+		}
+		else
+		{
+			m_cImg.create(colorFrame.getHeight(), colorFrame.getWidth(), CV_8UC3);
+		}
+		ConvertColorFrame(colorFrame, m_cImg);
+		m_consumer->onColorImage(m_cImg, colorFrame);
+	}
+
+	void showDepth(const openni::VideoFrameRef& depthFrame)
+	{
+		m_dImg.create(depthFrame.getHeight(), depthFrame.getWidth(), CV_8UC3);
+		ColorizeDepthFrame(depthFrame, m_colorizer, m_dImg);
+		m_consumer->onDepthImage(m_dImg, depthFrame);
+	}
+
+	PreviewConsumer* m_consumer;
+	int m_decimation;
+	DepthColorizer m_colorizer;
+
+	// Mailbox between the caller and the display thread
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::condition_variable m_done;
+	openni::VideoFrameRef m_color;
+	openni::VideoFrameRef m_depth;
+	bool m_pending;
+	bool m_busy;
+	bool m_stop;
+	std::thread m_thread;
+
+	// Updated by the display thread, except m_replaced under the mutex
+	LatencyHistogram m_convertTime;
+	LatencyHistogram m_colorizeTime;
+	uint64_t m_shown;
+	uint64_t m_replaced;
+
+	// Color Image & Depth Image Matrix, allocated on first use
+	cv::Mat m_cImg;
+	cv::Mat m_dImg;
+};
+
+#endif // _PREVIEW_H_
@@ -0,0 +1,122 @@
+#ifndef _RECORDING_FORMAT_H_
+#define _RECORDING_FORMAT_H_
+
+// Header Includes
+#include <stdint.h>
+
+// On-disk layout of a recording (.rgbd) file. All fields are little-endian.
+//
+//   RecordingHeader
+//   RecordingFrameHeader + pixel data (padded to RECORDING_ALIGNMENT), once per frame of any stream
+//   RecordingIndexEntry[frameCount] for each stream
+//   RecordingFooter
+//
+// The footer has a fixed size and sits at the very end of the file, so a reader finds the
+// per-stream indexes without scanning and can seek straight to frame N of any stream.
+// This header has no OpenNI dependency so offline tools can include it on its own.
+
+#define RECORDING_FILE_MAGIC 0x44424752	// "RGBD"
+#define RECORDING_FRAME_MAGIC 0x4D415246	// "FRAM"
+#define RECORDING_FOOTER_MAGIC 0x58444E49	// "INDX"
+#define RECORDING_VERSION 1
+
+#define RECORDING_MAX_STREAMS 2
+#define RECORDING_SERIAL_LENGTH 64
+
+// Frame records and their pixel data start on multiples of this
+#define RECORDING_ALIGNMENT 16
+
+// RecordingStreamInfo::pixelFormat of depth: openni::PIXEL_FORMAT_DEPTH_1_MM and
+// PIXEL_FORMAT_DEPTH_100_UM, for readers without OpenNI
+#define RECORDING_PIXEL_FORMAT_DEPTH_1_MM 100
+#define RECORDING_PIXEL_FORMAT_DEPTH_100_UM 101
+
+// RecordingIndexEntry::flags
+#define RECORDING_FRAME_FLAG_GAP 0x1	// First frame of its stream after capture was interrupted, e.g. the device was unplugged
+
+// Stream slots in RecordingHeader::streams
+enum RecordingStream
+{
+	RECORDING_STREAM_COLOR = 0,
+	RECORDING_STREAM_DEPTH = 1
+};
+
+// How a frame's pixel data is stored
+enum RecordingEncoding
+{
+	RECORDING_ENCODING_RAW = 0,	// Exactly as delivered by the driver
+	RECORDING_ENCODING_DEPTH_RICE = 1,	// Lossless depth, see DepthCodec.h
+	RECORDING_ENCODING_JPEG = 2,	// Color as a JPEG file image
+	RECORDING_ENCODING_PNG = 3	// Color as a PNG file image
+};
+
+#pragma pack(push, 1)
+
+struct RecordingStreamInfo
+{
+	uint32_t sensorType;	// openni::SensorType, 0 if the stream is absent
+	uint32_t pixelFormat;	// openni::PixelFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t fps;
+	uint32_t bytesPerPixel;
+	float horizontalFov;	// Radians
+	float verticalFov;	// Radians
+};
+
+struct RecordingHeader
+{
+	uint32_t magic;	// RECORDING_FILE_MAGIC
+	uint32_t version;	// RECORDING_VERSION
+	uint32_t headerSize;	// sizeof(RecordingHeader), so older readers can skip fields they don't know
+	uint32_t streamCount;
+	char serialNumber[RECORDING_SERIAL_LENGTH];	// XN_MODULE_PROPERTY_SERIAL_NUMBER, NUL terminated
+	int64_t startTime;	// Seconds since the epoch when recording began
+
+	// PS1080 depth intrinsics, zero when the driver doesn't report them
+	uint64_t zeroPlaneDistance;	// XN_STREAM_PROPERTY_ZERO_PLANE_DISTANCE
+	double zeroPlanePixelSize;	// XN_STREAM_PROPERTY_ZERO_PLANE_PIXEL_SIZE
+	double emitterDcmosDistance;	// XN_STREAM_PROPERTY_EMITTER_DCMOS_DISTANCE
+
+	RecordingStreamInfo streams[RECORDING_MAX_STREAMS];
+};
+
+struct RecordingFrameHeader
+{
+	uint32_t magic;	// RECORDING_FRAME_MAGIC
+	uint32_t stream;	// RecordingStream
+	uint64_t timestamp;	// VideoFrameRef::getTimestamp(), microseconds
+	int32_t frameIndex;	// VideoFrameRef::getFrameIndex()
+	uint32_t width;
+	uint32_t height;
+	uint32_t strideInBytes;
+	uint32_t encoding;	// RecordingEncoding
+	uint32_t dataSize;	// Bytes of pixel data following this header, before padding
+	uint64_t hostTimestamp;	// timestamp on the host's monotonic clock (see DeviceClock.h), microseconds, 0 if unknown
+};
+
+struct RecordingIndexEntry
+{
+	uint64_t offset;	// File offset of the frame's RecordingFrameHeader
+	uint64_t timestamp;
+	int32_t frameIndex;
+	uint32_t flags;	// RECORDING_FRAME_FLAG_*
+};
+
+struct RecordingFooter
+{
+	uint64_t indexOffset[RECORDING_MAX_STREAMS];	// File offset of each stream's RecordingIndexEntry array
+	uint64_t frameCount[RECORDING_MAX_STREAMS];
+	uint32_t magic;	// RECORDING_FOOTER_MAGIC
+	uint32_t reserved;
+};
+
+#pragma pack(pop)
+
+// Size of a frame record's pixel data once padded
+inline uint64_t RecordingPaddedSize(uint64_t size)
+{
+	return (size + RECORDING_ALIGNMENT - 1) & ~(uint64_t)(RECORDING_ALIGNMENT - 1);
+}
+
+#endif // _RECORDING_FORMAT_H_
@@ -0,0 +1,120 @@
+// Header Includes
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BenchFrames.h"
+
+// Namespaces
+using namespace std;
+
+void PrintStream(const RecordingReader& reader, RecordingStream stream, const char* name)
+{
+	cout << name << " : " << reader.frameCount(stream) << " frames";
+
+	const RecordingHeader* header = reader.header();
+	if(header != NULL)
+	{
+		const RecordingStreamInfo& info = header->streams[stream];
+		cout << ", " << info.width << "x" << info.height << "@" << info.fps << "fps, pixel format " << info.pixelFormat
+			<< ", FOV " << info.horizontalFov << "x" << info.verticalFov;
+	}
+
+	FrameView first, last;
+	if(reader.frame(stream, 0, first) && reader.frame(stream, reader.frameCount(stream) - 1, last))
+	{
+		cout << ", frame index " << first.frameIndex << "-" << last.frameIndex;
+		if(last.timestamp > first.timestamp)
+		{
+			cout << ", " << (last.timestamp - first.timestamp) / 1000000.0 << "s";
+		}
+		if(first.hostTimestamp != 0)
+		{
+			cout << ", host clock " << first.hostTimestamp / 1000000.0 << "s-" << last.hostTimestamp / 1000000.0 << "s";
+		}
+	}
+	cout << endl;
+}
+
+int main( const int argc, const char* argv[] )
+{
+	RecordingReader reader;
+	bool opened = false;
+
+	// Legacy layouts have no header, so their resolution can be given after the file names
+	if(argc >= 4 && strcmp(argv[1], "--split") == 0)
+	{
+		int width = (argc >= 6) ? atoi(argv[4]) : BENCH_LEGACY_RES_X;
+		int height = (argc >= 6) ? atoi(argv[5]) : BENCH_LEGACY_RES_Y;
+		opened = reader.openSplit(argv[2], argv[3], width, height);
+	}
+	else if(argc >= 3 && strcmp(argv[1], "--interleaved") == 0)
+	{
+		int width = (argc >= 5) ? atoi(argv[3]) : BENCH_LEGACY_RES_X;
+		int height = (argc >= 5) ? atoi(argv[4]) : BENCH_LEGACY_RES_Y;
+		opened = reader.openInterleaved(argv[2], width, height);
+	}
+	else if(argc == 2)
+	{
+		opened = reader.openRecording(argv[1]);
+	}
+	else
+	{
+		cerr << "Usage: " << argv[0] << " Recording.rgbd" << endl;
+		cerr << "       " << argv[0] << " --split ImageOutput.dat DepthOutput.dat [Width Height]" << endl;
+		cerr << "       " << argv[0] << " --interleaved data.dat [Width Height]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	if(!opened)
+	{
+		cerr << "Can't open recording" << endl;
+		return EXIT_FAILURE;
+	}
+
+	const RecordingHeader* header = reader.header();
+	if(header != NULL)
+	{
+		cout << "Recording version " << header->version << ", serial " << header->serialNumber << endl;
+		cout << "Zero plane distance " << header->zeroPlaneDistance << ", pixel size " << header->zeroPlanePixelSize
+			<< ", emitter-DCMOS distance " << header->emitterDcmosDistance << endl;
+	}
+	PrintStream(reader, RECORDING_STREAM_COLOR, "Color");
+	PrintStream(reader, RECORDING_STREAM_DEPTH, "Depth");
+
+	// Touch every frame once in order to measure sequential read throughput through the mapping
+	reader.advise(RecordingReader::ACCESS_SEQUENTIAL);
+	double start = Seconds();
+	uint64_t bytes = 0;
+	unsigned long checksum = 0;
+	uint64_t gaps[RECORDING_MAX_STREAMS] = { 0 };
+	for(int s = 0; s < RECORDING_MAX_STREAMS; s++)
+	{
+		RecordingStream stream = (RecordingStream)s;
+		for(uint64_t n = 0; n < reader.frameCount(stream); n++)
+		{
+			FrameView view;
+			if(!reader.frame(stream, n, view))
+			{
+				cerr << "Frame " << n << " of stream " << s << " is damaged" << endl;
+				continue;
+			}
+			const unsigned char* data = (const unsigned char*)view.data;
+			for(uint32_t i = 0; i < view.dataSize; i += 4096)
+			{
+				checksum += data[i];
+			}
+			bytes += view.dataSize;
+			gaps[s] += (view.flags & RECORDING_FRAME_FLAG_GAP) != 0;
+		}
+	}
+	double elapsed = Seconds() - start;
+	printf("Read %.1f MB in %.3fs (%.1f MB/s, checksum %lu)\n", bytes / 1048576.0, elapsed, elapsed > 0 ? bytes / 1048576.0 / elapsed : 0.0, checksum);
+	if(gaps[RECORDING_STREAM_COLOR] != 0 || gaps[RECORDING_STREAM_DEPTH] != 0)
+	{
+		cout << "Capture gaps (device reconnects) : color " << gaps[RECORDING_STREAM_COLOR] << ", depth " << gaps[RECORDING_STREAM_DEPTH] << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,422 @@
+#ifndef _RECORDING_READER_H_
+#define _RECORDING_READER_H_
+
+// Header Includes
+#include <fcntl.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DepthCodec.h"
+#include "RecordingFormat.h"
+
+// Define RECORDING_READER_OPENCV before including this header to get cv::Mat wrappers
+#ifdef RECORDING_READER_OPENCV
+#include <opencv2/opencv.hpp>
+#endif
+
+// A frame inside a mapped recording. The pointer aims straight into the mapping, so it is only
+// valid while the reader that produced it stays open, and must be treated as read-only.
+struct FrameView
+{
+	const void* data;
+	uint32_t dataSize;
+	int width;
+	int height;
+	int strideInBytes;
+	int bytesPerPixel;
+	uint64_t timestamp;	// Microseconds, 0 for legacy layouts which don't store it
+	uint64_t hostTimestamp;	// Microseconds on the host's monotonic clock, 0 if not recorded
+	int frameIndex;	// Position in the file for legacy layouts
+	uint32_t encoding;	// RecordingEncoding
+	uint32_t flags;	// RECORDING_FRAME_FLAG_*, always 0 for legacy layouts
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() : m_data(NULL), m_size(0)
+	{
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	// Maps the file. Recordings larger than the address space need a 64-bit process.
+	bool open(const char* fileName)
+	{
+		close();
+
+		int fd = ::open(fileName, O_RDONLY);
+		if(fd < 0)
+		{
+			return false;
+		}
+
+		struct stat info;
+		if(fstat(fd, &info) != 0 || info.st_size == 0 || (uint64_t)info.st_size > (size_t)-1)
+		{
+			::close(fd);
+			return false;
+		}
+
+		void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		// The mapping keeps the file referenced, so the descriptor isn't needed any more
+		::close(fd);
+		if(data == MAP_FAILED)
+		{
+			return false;
+		}
+
+		m_data = (const unsigned char*)data;
+		m_size = info.st_size;
+		return true;
+	}
+
+	void close()
+	{
+		if(m_data != NULL)
+		{
+			munmap((void*)m_data, m_size);
+			m_data = NULL;
+			m_size = 0;
+		}
+	}
+
+	// Passes a madvise() hint for a byte range, widened to whole pages
+	void advise(uint64_t offset, uint64_t length, int advice) const
+	{
+		if(m_data == NULL || offset >= m_size)
+		{
+			return;
+		}
+		if(length > m_size - offset)
+		{
+			length = m_size - offset;
+		}
+
+		uint64_t page = sysconf(_SC_PAGESIZE);
+		uint64_t start = offset & ~(page - 1);
+		madvise((void*)(m_data + start), length + (offset - start), advice);
+	}
+
+	const unsigned char* data() const { return m_data; }
+	uint64_t size() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char* m_data;
+	uint64_t m_size;
+};
+
+// Zero-copy access to recorded sessions. Understands the .rgbd container written by
+// CaptureImageDepthData, the legacy ImageOutput/DepthOutput .dat pair, and the interleaved
+// color+depth .dat written by openniCaptureFitPC. Legacy layouts carry no header, so their
+// resolution has to be supplied by the caller.
+class RecordingReader
+{
+public:
+	enum Layout
+	{
+		LAYOUT_NONE,
+		LAYOUT_CONTAINER,	// Output/Recording_*.rgbd
+		LAYOUT_SPLIT,	// Output/ImageOutput_*.dat + Output/DepthOutput_*.dat
+		LAYOUT_INTERLEAVED	// Output/data_*.dat: RGB888 frame then 16 bit depth frame, repeated
+	};
+
+	enum AccessPattern
+	{
+		ACCESS_NORMAL,
+		ACCESS_SEQUENTIAL,	// Aggressive read-ahead, pages dropped soon after use
+		ACCESS_RANDOM	// No read-ahead, for seeking
+	};
+
+	RecordingReader() : m_width(0), m_height(0)
+	{
+		close();
+	}
+
+	// Opens an .rgbd container, validating its header, footer and index bounds
+	bool openRecording(const char* fileName)
+	{
+		close();
+		if(!m_files[0].open(fileName) || m_files[0].size() < sizeof(RecordingHeader) + sizeof(RecordingFooter))
+		{
+			close();
+			return false;
+		}
+
+		const unsigned char* base = m_files[0].data();
+		uint64_t size = m_files[0].size();
+		m_header = (const RecordingHeader*)base;
+		m_footer = (const RecordingFooter*)(base + size - sizeof(RecordingFooter));
+		if(m_header->magic != RECORDING_FILE_MAGIC || m_header->version > RECORDING_VERSION || m_footer->magic != RECORDING_FOOTER_MAGIC)
+		{
+			close();
+			return false;
+		}
+
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			uint64_t indexEnd = m_footer->indexOffset[i] + m_footer->frameCount[i] * sizeof(RecordingIndexEntry);
+			if(m_footer->indexOffset[i] > size || indexEnd > size - sizeof(RecordingFooter))
+			{
+				close();
+				return false;
+			}
+			m_index[i] = (const RecordingIndexEntry*)(base + m_footer->indexOffset[i]);
+			m_frameCount[i] = m_footer->frameCount[i];
+		}
+
+		m_layout = LAYOUT_CONTAINER;
+		return true;
+	}
+
+	// Opens the headerless color/depth pair written before the container existed
+	bool openSplit(const char* colorFileName, const char* depthFileName, int width, int height)
+	{
+		close();
+		if(!m_files[RECORDING_STREAM_COLOR].open(colorFileName) || !m_files[RECORDING_STREAM_DEPTH].open(depthFileName))
+		{
+			close();
+			return false;
+		}
+
+		m_layout = LAYOUT_SPLIT;
+		m_width = width;
+		m_height = height;
+		m_frameCount[RECORDING_STREAM_COLOR] = m_files[RECORDING_STREAM_COLOR].size() / legacyFrameSize(RECORDING_STREAM_COLOR);
+		m_frameCount[RECORDING_STREAM_DEPTH] = m_files[RECORDING_STREAM_DEPTH].size() / legacyFrameSize(RECORDING_STREAM_DEPTH);
+		return true;
+	}
+
+	// Opens the single interleaved file written by openniCaptureFitPC
+	bool openInterleaved(const char* fileName, int width, int height)
+	{
+		close();
+		if(!m_files[0].open(fileName))
+		{
+			return false;
+		}
+
+		m_layout = LAYOUT_INTERLEAVED;
+		m_width = width;
+		m_height = height;
+		uint64_t pairs = m_files[0].size() / (legacyFrameSize(RECORDING_STREAM_COLOR) + legacyFrameSize(RECORDING_STREAM_DEPTH));
+		m_frameCount[RECORDING_STREAM_COLOR] = pairs;
+		m_frameCount[RECORDING_STREAM_DEPTH] = pairs;
+		return true;
+	}
+
+	void close()
+	{
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			m_files[i].close();
+			m_index[i] = NULL;
+			m_frameCount[i] = 0;
+		}
+		m_layout = LAYOUT_NONE;
+		m_header = NULL;
+		m_footer = NULL;
+	}
+
+	// Tells the kernel how the frames are about to be read
+	void advise(AccessPattern pattern) const
+	{
+		int advice = (pattern == ACCESS_SEQUENTIAL) ? MADV_SEQUENTIAL : (pattern == ACCESS_RANDOM) ? MADV_RANDOM : MADV_NORMAL;
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			m_files[i].advise(0, m_files[i].size(), advice);
+		}
+	}
+
+	// Starts paging in frame n ahead of use, e.g. one step ahead of a random-access worker
+	void prefetch(RecordingStream stream, uint64_t n) const
+	{
+		uint64_t offset, length;
+		int file;
+		if(locate(stream, n, file, offset, length))
+		{
+			m_files[file].advise(offset, length, MADV_WILLNEED);
+		}
+	}
+
+	// Looks up frame n of a stream. Returns false if it doesn't exist or its record is damaged.
+	bool frame(RecordingStream stream, uint64_t n, FrameView& view) const
+	{
+		uint64_t offset, length;
+		int file;
+		if(!locate(stream, n, file, offset, length))
+		{
+			return false;
+		}
+		const unsigned char* base = m_files[file].data();
+
+		if(m_layout == LAYOUT_CONTAINER)
+		{
+			const RecordingFrameHeader* record = (const RecordingFrameHeader*)(base + offset);
+			if(record->magic != RECORDING_FRAME_MAGIC || record->stream != (uint32_t)stream)
+			{
+				return false;
+			}
+			view.data = record + 1;
+			view.dataSize = record->dataSize;
+			view.width = record->width;
+			view.height = record->height;
+			view.strideInBytes = record->strideInBytes;
+			view.bytesPerPixel = m_header->streams[stream].bytesPerPixel;
+			view.timestamp = record->timestamp;
+			view.hostTimestamp = record->hostTimestamp;
+			view.frameIndex = record->frameIndex;
+			view.encoding = record->encoding;
+			view.flags = m_index[stream][n].flags;
+			return true;
+		}
+
+		view.data = base + offset;
+		view.dataSize = length;
+		view.width = m_width;
+		view.height = m_height;
+		view.bytesPerPixel = legacyBytesPerPixel(stream);
+		view.strideInBytes = m_width * view.bytesPerPixel;
+		view.timestamp = 0;
+		view.hostTimestamp = 0;
+		view.frameIndex = (int)n;
+		view.encoding = RECORDING_ENCODING_RAW;
+		view.flags = 0;
+		return true;
+	}
+
+	// Expands a frame into pixels, which must hold width x height pixels packed without padding.
+	// Raw frames are simply copied; use the view directly to avoid that.
+	static bool decode(const FrameView& view, void* pixels)
+	{
+		int rowSize = view.width * view.bytesPerPixel;
+		switch(view.encoding)
+		{
+			case RECORDING_ENCODING_RAW:
+				if((uint64_t)view.strideInBytes * (view.height - 1) + rowSize > view.dataSize)
+				{
+					return false;
+				}
+				for(int y = 0; y < view.height; y++)
+				{
+					memcpy((uint8_t*)pixels + (size_t)y * rowSize, (const uint8_t*)view.data + (size_t)y * view.strideInBytes, rowSize);
+				}
+				return true;
+			case RECORDING_ENCODING_DEPTH_RICE:
+				return DecodeDepth((const uint8_t*)view.data, view.dataSize, (uint16_t*)pixels, view.width, view.height, rowSize);
+			default:
+				return false;
+		}
+	}
+
+#ifdef RECORDING_READER_OPENCV
+	// Wraps a raw frame in a cv::Mat header without copying (CV_8UC3 RGB order for color, CV_16UC1 for depth).
+	// The Mat must not be written to, and is empty for encoded frames.
+	static cv::Mat toMat(const FrameView& view)
+	{
+		if(view.encoding != RECORDING_ENCODING_RAW)
+		{
+			return cv::Mat();
+		}
+		int type = (view.bytesPerPixel == 3) ? CV_8UC3 : CV_16UC1;
+		return cv::Mat(view.height, view.width, type, (void*)view.data, view.strideInBytes);
+	}
+
+	// Returns a color frame as a BGR image whatever its encoding. Always copies.
+	static cv::Mat decodeColor(const FrameView& view)
+	{
+		cv::Mat bgr;
+		if(view.encoding == RECORDING_ENCODING_RAW)
+		{
+			cv::cvtColor(toMat(view), bgr, cv::COLOR_RGB2BGR);
+		}
+		else if(view.encoding == RECORDING_ENCODING_JPEG || view.encoding == RECORDING_ENCODING_PNG)
+		{
+			bgr = cv::imdecode(cv::Mat(1, view.dataSize, CV_8UC1, (void*)view.data), cv::IMREAD_COLOR);
+		}
+		return bgr;
+	}
+#endif
+
+	Layout layout() const { return m_layout; }
+	// NULL for legacy layouts
+	const RecordingHeader* header() const { return m_header; }
+	uint64_t frameCount(RecordingStream stream) const { return m_frameCount[stream]; }
+
+private:
+	RecordingReader(const RecordingReader&);
+	RecordingReader& operator=(const RecordingReader&);
+
+	static int legacyBytesPerPixel(RecordingStream stream)
+	{
+		return (stream == RECORDING_STREAM_COLOR) ? 3 : 2;
+	}
+
+	uint64_t legacyFrameSize(RecordingStream stream) const
+	{
+		return (uint64_t)m_width * m_height * legacyBytesPerPixel(stream);
+	}
+
+	// Finds which mapping holds frame n and the byte range of its record
+	bool locate(RecordingStream stream, uint64_t n, int& file, uint64_t& offset, uint64_t& length) const
+	{
+		if(m_layout == LAYOUT_NONE || n >= m_frameCount[stream])
+		{
+			return false;
+		}
+
+		switch(m_layout)
+		{
+			case LAYOUT_CONTAINER:
+			{
+				file = 0;
+				offset = m_index[stream][n].offset;
+				if(offset + sizeof(RecordingFrameHeader) > m_files[0].size())
+				{
+					return false;
+				}
+				const RecordingFrameHeader* record = (const RecordingFrameHeader*)(m_files[0].data() + offset);
+				length = sizeof(RecordingFrameHeader) + record->dataSize;
+				return offset + length <= m_files[0].size();
+			}
+			case LAYOUT_SPLIT:
+				file = stream;
+				length = legacyFrameSize(stream);
+				offset = n * length;
+				return true;
+			case LAYOUT_INTERLEAVED:
+				file = 0;
+				length = legacyFrameSize(stream);
+				offset = n * (legacyFrameSize(RECORDING_STREAM_COLOR) + legacyFrameSize(RECORDING_STREAM_DEPTH));
+				if(stream == RECORDING_STREAM_DEPTH)
+				{
+					offset += legacyFrameSize(RECORDING_STREAM_COLOR);
+				}
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	Layout m_layout;
+	MappedFile m_files[RECORDING_MAX_STREAMS];
+	const RecordingHeader* m_header;
+	const RecordingFooter* m_footer;
+	const RecordingIndexEntry* m_index[RECORDING_MAX_STREAMS];
+	uint64_t m_frameCount[RECORDING_MAX_STREAMS];
+	int m_width;
+	int m_height;
+};
+
+#endif // _RECORDING_READER_H_
@@ -0,0 +1,336 @@
+#ifndef _RECORDING_WRITER_H_
+#define _RECORDING_WRITER_H_
+
+// Header Includes
+#include <OpenNI.h>
+#include <PS1080.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "DeviceClock.h"
+#include "DirectFile.h"
+#include "RecordingFormat.h"
+
+// Reads the device's serial number. Returns false if the driver doesn't report one.
+inline bool GetSerialNumber(const openni::Device& device, char* serial, int size)
+{
+	char value[XN_DEVICE_MAX_STRING_LENGTH];
+	int valueSize = sizeof(value);
+	if(size <= 0 || device.getProperty(XN_MODULE_PROPERTY_SERIAL_NUMBER, value, &valueSize) != openni::STATUS_OK)
+	{
+		return false;
+	}
+	strncpy(serial, value, size - 1);
+	serial[size - 1] = '\0';
+	return true;
+}
+
+// Fills in the description of one stream from its current video mode
+inline void DescribeRecordingStream(RecordingStreamInfo& info, const openni::VideoStream& stream)
+{
+	const openni::VideoMode mode = stream.getVideoMode();
+	info.sensorType = stream.getSensorInfo().getSensorType();
+	info.pixelFormat = mode.getPixelFormat();
+	info.width = mode.getResolutionX();
+	info.height = mode.getResolutionY();
+	info.fps = mode.getFps();
+	info.bytesPerPixel = (info.pixelFormat == openni::PIXEL_FORMAT_RGB888) ? 3 : 2;
+	info.horizontalFov = stream.getHorizontalFieldOfView();
+	info.verticalFov = stream.getVerticalFieldOfView();
+}
+
+// Builds a recording header describing the device, its streams and the depth intrinsics
+inline void DescribeRecording(RecordingHeader& header, const openni::Device& device, const openni::VideoStream& color, const openni::VideoStream& depth)
+{
+	memset(&header, 0, sizeof(header));
+	header.magic = RECORDING_FILE_MAGIC;
+	header.version = RECORDING_VERSION;
+	header.headerSize = sizeof(RecordingHeader);
+	header.streamCount = RECORDING_MAX_STREAMS;
+	header.startTime = time(NULL);
+
+	GetSerialNumber(device, header.serialNumber, RECORDING_SERIAL_LENGTH);
+
+	// Not every driver reports these; the header keeps zeros when they're missing
+	depth.getProperty<uint64_t>(XN_STREAM_PROPERTY_ZERO_PLANE_DISTANCE, &header.zeroPlaneDistance);
+	depth.getProperty<double>(XN_STREAM_PROPERTY_ZERO_PLANE_PIXEL_SIZE, &header.zeroPlanePixelSize);
+	depth.getProperty<double>(XN_STREAM_PROPERTY_EMITTER_DCMOS_DISTANCE, &header.emitterDcmosDistance);
+
+	DescribeRecordingStream(header.streams[RECORDING_STREAM_COLOR], color);
+	DescribeRecordingStream(header.streams[RECORDING_STREAM_DEPTH], depth);
+}
+
+// Appended to the name of a recording file that is still being written
+#define RECORDING_PARTIAL_SUFFIX ".partial"
+
+// How RecordingWriter creates and finishes its files
+struct RecordingFileOptions
+{
+	RecordingFileOptions() : direct(false), preallocate(0), partialUntilClosed(false)
+	{
+	}
+
+	// Write through a DirectFile (O_DIRECT, asynchronous) instead of stdio
+	bool direct;
+	// Bytes to reserve on the disk up front with fallocate, 0 for none. Keeps the file in few
+	// extents and spares the filesystem block allocation while frames are written.
+	uint64_t preallocate;
+	// Write to the name plus RECORDING_PARTIAL_SUFFIX, and only once the index and footer are on
+	// the disk rename it to the name, so a file with the final name is always complete
+	bool partialUntilClosed;
+};
+
+// Writes a recording file: the header up front, one record per frame as they arrive,
+// and the per-stream seek indexes plus footer when the recording is closed. The file is written
+// through stdio, or through a DirectFile (O_DIRECT, asynchronous) when opened for direct I/O.
+// A long recording can be split into segments with rotate(), each a complete recording.
+class RecordingWriter
+{
+public:
+	RecordingWriter() : m_file(NULL), m_direct(NULL), m_offset(0), m_clock(NULL)
+	{
+		memset(&m_header, 0, sizeof(m_header));
+		markGap(false);
+	}
+
+	~RecordingWriter()
+	{
+		close();
+	}
+
+	// Creates the file and writes the header. Returns false if the file can't be written.
+	bool open(const char* fileName, const RecordingHeader& header, const RecordingFileOptions& options = RecordingFileOptions())
+	{
+		m_header = header;
+		m_options = options;
+		markGap(false);
+		return create(fileName);
+	}
+
+	// Closes the current file and carries on in a new one with the same header and options.
+	// Gap flags still pending go to the first frames of the new file. If the new file can't be
+	// created the writer is left closed, and frames written after that fail.
+	bool rotate(const char* fileName)
+	{
+		bool ok = close();
+		return create(fileName) && ok;
+	}
+
+	// Flags the next frame of every stream as following a break in capture (RECORDING_FRAME_FLAG_GAP).
+	// Frames already queued for writing must be written before this is called.
+	void markGap(bool gap = true)
+	{
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			m_gapPending[i] = gap;
+		}
+	}
+
+	// Stamps each frame with its time on the host clock as well as the device's own timestamp
+	void setClock(const DeviceClock* clock)
+	{
+		m_clock = clock;
+	}
+
+	// Appends one frame of the given stream and remembers where it went. Takes a VideoFrameRef or
+	// anything with its accessors, e.g. a FrameCopy.
+	template<typename Frame>
+	bool writeFrame(RecordingStream stream, const Frame& frame)
+	{
+		return writeFrame(stream, frame, RECORDING_ENCODING_RAW, frame.getData(), frame.getDataSize());
+	}
+
+	// Appends one frame whose pixel data has already been encoded by the caller
+	template<typename Frame>
+	bool writeFrame(RecordingStream stream, const Frame& frame, RecordingEncoding encoding, const void* data, uint32_t dataSize)
+	{
+		RecordingFrameHeader record;
+		memset(&record, 0, sizeof(record));
+		record.magic = RECORDING_FRAME_MAGIC;
+		record.stream = stream;
+		record.timestamp = frame.getTimestamp();
+		record.frameIndex = frame.getFrameIndex();
+		record.width = frame.getWidth();
+		record.height = frame.getHeight();
+		record.strideInBytes = frame.getStrideInBytes();
+		record.encoding = encoding;
+		record.dataSize = dataSize;
+		record.hostTimestamp = (m_clock != NULL) ? m_clock->toHost(record.timestamp) : 0;
+
+		RecordingIndexEntry entry;
+		entry.offset = m_offset;
+		entry.timestamp = record.timestamp;
+		entry.frameIndex = record.frameIndex;
+		entry.flags = m_gapPending[stream] ? RECORDING_FRAME_FLAG_GAP : 0;
+
+		static const char padding[RECORDING_ALIGNMENT] = { 0 };
+		if(!write(&record, sizeof(record)) || !write(data, dataSize) || !write(padding, RecordingPaddedSize(dataSize) - dataSize))
+		{
+			return false;
+		}
+
+		m_index[stream].push_back(entry);
+		m_gapPending[stream] = false;
+		return true;
+	}
+
+	// Pushes everything written so far to the disk, so a crash or power cut loses at most what
+	// came after. Blocks for as long as the device takes; returns false on a write error.
+	bool sync()
+	{
+		if(m_direct != NULL)
+		{
+			return m_direct->sync();
+		}
+		if(m_file == NULL)
+		{
+			return false;
+		}
+		return fflush(m_file) == 0 && fdatasync(fileno(m_file)) == 0;
+	}
+
+	// Writes the seek indexes and footer and closes the file. Safe to call more than once. A file
+	// written to its partial name keeps that name if anything went wrong finishing it.
+	bool close()
+	{
+		if(m_file == NULL && m_direct == NULL)
+		{
+			return true;
+		}
+
+		RecordingFooter footer;
+		memset(&footer, 0, sizeof(footer));
+		footer.magic = RECORDING_FOOTER_MAGIC;
+
+		bool ok = true;
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			footer.indexOffset[i] = m_offset;
+			footer.frameCount[i] = m_index[i].size();
+			if(!m_index[i].empty())
+			{
+				ok = write(&m_index[i][0], m_index[i].size() * sizeof(RecordingIndexEntry)) && ok;
+			}
+		}
+		ok = write(&footer, sizeof(footer)) && ok;
+
+		// The index and footer must be on the disk before the file may take its final name
+		if(m_options.partialUntilClosed)
+		{
+			ok = sync() && ok;
+		}
+		if(m_direct != NULL)
+		{
+			// Trimming the file to its size also frees what was preallocated beyond it
+			ok = m_direct->close() && ok;
+			delete m_direct;
+			m_direct = NULL;
+		}
+		else
+		{
+			if(m_options.preallocate != 0)
+			{
+				ok = fflush(m_file) == 0 && ftruncate(fileno(m_file), m_offset) == 0 && ok;
+			}
+			ok = (fclose(m_file) == 0) && ok;
+			m_file = NULL;
+		}
+		if(m_options.partialUntilClosed && ok)
+		{
+			ok = rename((m_fileName + RECORDING_PARTIAL_SUFFIX).c_str(), m_fileName.c_str()) == 0 && ok;
+		}
+		return ok;
+	}
+
+	// How the file is written, e.g. "O_DIRECT, io_uring", or "stdio"
+	const char* describe() const
+	{
+		return (m_direct != NULL) ? m_direct->describe() : "stdio";
+	}
+
+	bool isOpen() const { return m_file != NULL || m_direct != NULL; }
+	uint64_t bytesWritten() const { return m_offset; }
+	uint64_t frameCount(RecordingStream stream) const { return m_index[stream].size(); }
+
+	// Name the current file has once it is closed
+	const std::string& fileName() const { return m_fileName; }
+
+private:
+	RecordingWriter(const RecordingWriter&);
+	RecordingWriter& operator=(const RecordingWriter&);
+
+	bool create(const char* fileName)
+	{
+		m_fileName = fileName;
+		std::string path = m_options.partialUntilClosed ? m_fileName + RECORDING_PARTIAL_SUFFIX : m_fileName;
+		int fd;
+		if(m_options.direct)
+		{
+			m_direct = new DirectFile;
+			if(!m_direct->open(path.c_str()))
+			{
+				delete m_direct;
+				m_direct = NULL;
+				return false;
+			}
+			fd = m_direct->descriptor();
+		}
+		else
+		{
+			m_file = fopen(path.c_str(), "wb");
+			if(m_file == NULL)
+			{
+				return false;
+			}
+			fd = fileno(m_file);
+		}
+
+		// Reserve without changing the file size; filesystems that can't just allocate as they go
+		if(m_options.preallocate != 0)
+		{
+			fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, m_options.preallocate);
+		}
+
+		m_offset = 0;
+		for(int i = 0; i < RECORDING_MAX_STREAMS; i++)
+		{
+			m_index[i].clear();
+		}
+		return write(&m_header, sizeof(m_header));
+	}
+
+	bool write(const void* data, size_t size)
+	{
+		if(m_file == NULL && m_direct == NULL)
+		{
+			return false;
+		}
+		if(size == 0)
+		{
+			return true;
+		}
+		if(m_direct != NULL ? !m_direct->write(data, size) : fwrite(data, 1, size, m_file) != size)
+		{
+			return false;
+		}
+		m_offset += size;
+		return true;
+	}
+
+	FILE* m_file;
+	DirectFile* m_direct;
+	std::string m_fileName;
+	RecordingHeader m_header;
+	RecordingFileOptions m_options;
+	uint64_t m_offset;
+	std::vector<RecordingIndexEntry> m_index[RECORDING_MAX_STREAMS];
+	const DeviceClock* m_clock;
+	bool m_gapPending[RECORDING_MAX_STREAMS];
+};
+
+#endif // _RECORDING_WRITER_H_
@@ -0,0 +1,693 @@
+// Synthetic OpenNI driver: a device with virtual depth and color sensors that produce
+// deterministic frames, for benchmarking and testing the capture tools without a sensor.
+// Build it into OpenNI2/Drivers (make OpenNI2/Drivers/libSyntheticDevice.so) and OpenNI loads
+// it next to libPS1080.so.
+//
+// Open it with --device synthetic://N; OpenNI asks every driver about a URI it doesn't know.
+// The driver announces no devices of its own unless asked to, so openni::ANY_DEVICE keeps
+// picking real hardware. Environment:
+//   SYNTHETIC_DEVICES=N  announce synthetic://0 .. synthetic://N-1 when OpenNI starts
+//   SYNTHETIC_FPS=F      produce F frames per second whatever the video mode says, 0 for as
+//                        fast as the consumer takes them
+
+// Header Includes
+#include <Driver/OniDriverAPI.h>
+#include <PS1080.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// The export macro allocates with XnOS, which isn't part of the public SDK
+#ifndef XN_NEW
+#define XN_NEW(type, arg) new type(arg)
+#endif
+#ifndef XN_DELETE
+#define XN_DELETE(p) delete (p)
+#endif
+
+#define SYNTHETIC_URI_PREFIX "synthetic://"
+#define SYNTHETIC_VENDOR "Synthetic"
+#define SYNTHETIC_NAME "Synthetic RGB-D"
+#define SYNTHETIC_USB_VENDOR_ID 0
+#define SYNTHETIC_USB_PRODUCT_ID 0
+
+// PrimeSense-like optics, so point clouds from synthetic recordings have sane proportions
+#define SYNTHETIC_DEPTH_HFOV 1.0225f	// 58.6 degrees
+#define SYNTHETIC_DEPTH_VFOV 0.7959f	// 45.6 degrees
+#define SYNTHETIC_COLOR_HFOV 1.0225f	// Registered to depth
+#define SYNTHETIC_COLOR_VFOV 0.7959f
+#define SYNTHETIC_ZERO_PLANE_DISTANCE 120	// mm
+#define SYNTHETIC_ZERO_PLANE_PIXEL_SIZE 0.1042	// mm
+#define SYNTHETIC_EMITTER_DCMOS_DISTANCE 7.5	// cm
+#define SYNTHETIC_MAX_DEPTH 10000	// mm
+
+// Namespaces
+using namespace std;
+using namespace oni::driver;
+
+// Microseconds since an arbitrary point, the same for every stream of the process
+static uint64_t SteadyMicroseconds()
+{
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Rate forced by SYNTHETIC_FPS: -1 to follow the video mode, 0 for unthrottled
+static int ForcedFps()
+{
+	const char* value = getenv("SYNTHETIC_FPS");
+	return (value == NULL || *value == '\0') ? -1 : atoi(value);
+}
+
+// Fills a depth frame. A floor-like plane rising towards the top of the image, a box sliding
+// left and right in front of it, and a shadow (no reading) to the right of the box, as a
+// structured light sensor would see it. Values are in mm, or 100 um units for DEPTH_100_UM.
+static void GenerateDepth(OniDepthPixel* pixels, int width, int height, int frameIndex, bool mirror, int scale)
+{
+	int period = width * 2;
+	int phase = (frameIndex * 4) % period;
+	int boxLeft = (phase < width ? phase : period - phase) * 3 / 4;
+	int boxRight = boxLeft + width / 4;
+	int shadowRight = boxRight + width / 32;
+	int boxTop = height / 3;
+	int boxBottom = boxTop + height / 3;
+
+	for(int y = 0; y < height; y++)
+	{
+		OniDepthPixel* row = pixels + y * width;
+		OniDepthPixel plane = (OniDepthPixel)((4000 - y * 2500 / height) * scale);
+		OniDepthPixel box = (OniDepthPixel)(1200 * scale);
+		bool inBox = (y >= boxTop && y < boxBottom);
+		for(int x = 0; x < width; x++)
+		{
+			int sx = mirror ? width - 1 - x : x;
+			OniDepthPixel value = plane;
+			if(inBox && sx >= boxLeft && sx < boxRight)
+			{
+				value = box + (OniDepthPixel)(((sx - boxLeft) & 15) * scale);
+			}
+			else if(inBox && sx >= boxRight && sx < shadowRight)
+			{
+				value = 0;
+			}
+			row[x] = value;
+		}
+	}
+}
+
+// Fills an RGB888 frame: a gradient scrolling with the frame index, and the same box as the
+// depth frame in a solid color, so registration and pairing mistakes are visible in a preview
+static void GenerateColor(OniRGB888Pixel* pixels, int width, int height, int frameIndex, bool mirror)
+{
+	int period = width * 2;
+	int phase = (frameIndex * 4) % period;
+	int boxLeft = (phase < width ? phase : period - phase) * 3 / 4;
+	int boxRight = boxLeft + width / 4;
+	int boxTop = height / 3;
+	int boxBottom = boxTop + height / 3;
+
+	for(int y = 0; y < height; y++)
+	{
+		OniRGB888Pixel* row = pixels + y * width;
+		bool inBox = (y >= boxTop && y < boxBottom);
+		uint8_t g = (uint8_t)(y * 255 / height);
+		for(int x = 0; x < width; x++)
+		{
+			int sx = mirror ? width - 1 - x : x;
+			if(inBox && sx >= boxLeft && sx < boxRight)
+			{
+				row[x].r = 230;
+				row[x].g = 120;
+				row[x].b = 30;
+			}
+			else
+			{
+				row[x].r = (uint8_t)(sx + frameIndex);
+				row[x].g = g;
+				row[x].b = (uint8_t)((sx ^ y) + frameIndex);
+			}
+		}
+	}
+}
+
+// A frame handed to OpenNI, reference counted and recycled through its stream's pool
+struct SyntheticFrame
+{
+	OniDriverFrame driverFrame;
+	atomic<int> refCount;
+	int capacity;
+};
+
+class SyntheticStream : public StreamBase
+{
+public:
+	SyntheticStream(OniSensorType sensorType, const OniSensorInfo& sensorInfo, uint64_t epoch) :
+		m_sensorType(sensorType), m_sensorInfo(sensorInfo), m_epoch(epoch), m_mirror(false), m_running(false)
+	{
+		m_mode = sensorInfo.pSupportedVideoModes[0];
+	}
+
+	~SyntheticStream()
+	{
+		stop();
+		for(size_t i = 0; i < m_pool.size(); i++)
+		{
+			freeFrame(m_pool[i]);
+		}
+	}
+
+	OniStatus start()
+	{
+		if(m_running.exchange(true))
+		{
+			return ONI_STATUS_OK;
+		}
+		m_thread = thread(&SyntheticStream::run, this);
+		return ONI_STATUS_OK;
+	}
+
+	void stop()
+	{
+		if(m_running.exchange(false))
+		{
+			m_thread.join();
+		}
+	}
+
+	OniStatus setProperty(int propertyId, const void* data, int dataSize)
+	{
+		switch(propertyId)
+		{
+		case ONI_STREAM_PROPERTY_VIDEO_MODE:
+		{
+			if(dataSize != sizeof(OniVideoMode))
+			{
+				return ONI_STATUS_BAD_PARAMETER;
+			}
+			const OniVideoMode* mode = (const OniVideoMode*)data;
+			for(int i = 0; i < m_sensorInfo.numSupportedVideoModes; i++)
+			{
+				const OniVideoMode& supported = m_sensorInfo.pSupportedVideoModes[i];
+				if(supported.pixelFormat == mode->pixelFormat && supported.resolutionX == mode->resolutionX &&
+					supported.resolutionY == mode->resolutionY && supported.fps == mode->fps)
+				{
+					lock_guard<mutex> lock(m_modeLock);
+					m_mode = *mode;
+					return ONI_STATUS_OK;
+				}
+			}
+			return ONI_STATUS_NOT_SUPPORTED;
+		}
+		case ONI_STREAM_PROPERTY_MIRRORING:
+			if(dataSize != sizeof(OniBool))
+			{
+				return ONI_STATUS_BAD_PARAMETER;
+			}
+			m_mirror = (*(const OniBool*)data != FALSE);
+			return ONI_STATUS_OK;
+		default:
+			return ONI_STATUS_NOT_SUPPORTED;
+		}
+	}
+
+	OniStatus getProperty(int propertyId, void* data, int* pDataSize)
+	{
+		switch(propertyId)
+		{
+		case ONI_STREAM_PROPERTY_VIDEO_MODE:
+		{
+			lock_guard<mutex> lock(m_modeLock);
+			return copyProperty(&m_mode, sizeof(m_mode), data, pDataSize);
+		}
+		case ONI_STREAM_PROPERTY_MIRRORING:
+		{
+			OniBool mirror = m_mirror ? TRUE : FALSE;
+			return copyProperty(&mirror, sizeof(mirror), data, pDataSize);
+		}
+		case ONI_STREAM_PROPERTY_HORIZONTAL_FOV:
+		{
+			float fov = isDepth() ? SYNTHETIC_DEPTH_HFOV : SYNTHETIC_COLOR_HFOV;
+			return copyProperty(&fov, sizeof(fov), data, pDataSize);
+		}
+		case ONI_STREAM_PROPERTY_VERTICAL_FOV:
+		{
+			float fov = isDepth() ? SYNTHETIC_DEPTH_VFOV : SYNTHETIC_COLOR_VFOV;
+			return copyProperty(&fov, sizeof(fov), data, pDataSize);
+		}
+		case ONI_STREAM_PROPERTY_MIN_VALUE:
+		{
+			int value = 0;
+			return copyProperty(&value, sizeof(value), data, pDataSize);
+		}
+		case ONI_STREAM_PROPERTY_MAX_VALUE:
+		{
+			int value = isDepth() ? SYNTHETIC_MAX_DEPTH * depthScale() : 255;
+			return copyProperty(&value, sizeof(value), data, pDataSize);
+		}
+		case ONI_STREAM_PROPERTY_STRIDE:
+		{
+			lock_guard<mutex> lock(m_modeLock);
+			int stride = m_mode.resolutionX * pixelSize(m_mode.pixelFormat);
+			return copyProperty(&stride, sizeof(stride), data, pDataSize);
+		}
+		case XN_STREAM_PROPERTY_ZERO_PLANE_DISTANCE:
+		{
+			if(!isDepth())
+			{
+				return ONI_STATUS_NOT_SUPPORTED;
+			}
+			uint64_t distance = SYNTHETIC_ZERO_PLANE_DISTANCE;
+			return copyProperty(&distance, sizeof(distance), data, pDataSize);
+		}
+		case XN_STREAM_PROPERTY_ZERO_PLANE_PIXEL_SIZE:
+		{
+			if(!isDepth())
+			{
+				return ONI_STATUS_NOT_SUPPORTED;
+			}
+			double size = SYNTHETIC_ZERO_PLANE_PIXEL_SIZE;
+			return copyProperty(&size, sizeof(size), data, pDataSize);
+		}
+		case XN_STREAM_PROPERTY_EMITTER_DCMOS_DISTANCE:
+		{
+			if(!isDepth())
+			{
+				return ONI_STATUS_NOT_SUPPORTED;
+			}
+			double distance = SYNTHETIC_EMITTER_DCMOS_DISTANCE;
+			return copyProperty(&distance, sizeof(distance), data, pDataSize);
+		}
+		default:
+			return ONI_STATUS_NOT_SUPPORTED;
+		}
+	}
+
+	OniBool isPropertySupported(int propertyId)
+	{
+		int size = 0;
+		if(propertyId == ONI_STREAM_PROPERTY_VIDEO_MODE || propertyId == ONI_STREAM_PROPERTY_MIRRORING)
+		{
+			return TRUE;
+		}
+		return (getProperty(propertyId, NULL, &size) == ONI_STATUS_BAD_PARAMETER) ? TRUE : FALSE;
+	}
+
+	void addRefToFrame(OniDriverFrame* pFrame)
+	{
+		((SyntheticFrame*)pFrame->pDriverCookie)->refCount.fetch_add(1);
+	}
+
+	void releaseFrame(OniDriverFrame* pFrame)
+	{
+		SyntheticFrame* frame = (SyntheticFrame*)pFrame->pDriverCookie;
+		if(frame->refCount.fetch_sub(1) != 1)
+		{
+			return;
+		}
+		lock_guard<mutex> lock(m_poolLock);
+		m_pool.push_back(frame);
+	}
+
+private:
+	static int pixelSize(OniPixelFormat format)
+	{
+		return (format == ONI_PIXEL_FORMAT_RGB888) ? sizeof(OniRGB888Pixel) : sizeof(OniDepthPixel);
+	}
+
+	// Answers a property query, or reports the size wanted with ONI_STATUS_BAD_PARAMETER
+	static OniStatus copyProperty(const void* value, int size, void* data, int* pDataSize)
+	{
+		if(data == NULL || *pDataSize < size)
+		{
+			*pDataSize = size;
+			return ONI_STATUS_BAD_PARAMETER;
+		}
+		memcpy(data, value, size);
+		*pDataSize = size;
+		return ONI_STATUS_OK;
+	}
+
+	static void freeFrame(SyntheticFrame* frame)
+	{
+		free(frame->driverFrame.frame.data);
+		delete frame;
+	}
+
+	bool isDepth() const { return m_sensorType == ONI_SENSOR_DEPTH; }
+	int depthScale() const { return (m_mode.pixelFormat == ONI_PIXEL_FORMAT_DEPTH_100_UM) ? 10 : 1; }
+
+	// Takes a frame of at least the given size from the pool, or makes one
+	SyntheticFrame* acquireFrame(int dataSize)
+	{
+		SyntheticFrame* frame = NULL;
+		{
+			lock_guard<mutex> lock(m_poolLock);
+			if(!m_pool.empty())
+			{
+				frame = m_pool.back();
+				m_pool.pop_back();
+			}
+		}
+		if(frame != NULL && frame->capacity < dataSize)
+		{
+			freeFrame(frame);
+			frame = NULL;
+		}
+		if(frame == NULL)
+		{
+			frame = new SyntheticFrame;
+			memset(&frame->driverFrame, 0, sizeof(frame->driverFrame));
+			frame->driverFrame.frame.data = malloc(dataSize);
+			frame->driverFrame.pDriverCookie = frame;
+			frame->capacity = dataSize;
+		}
+		frame->refCount.store(1);
+		return frame;
+	}
+
+	// Produces frames until stopped. Paced frames fall on ticks of a clock the device's streams
+	// share, so depth and color frames of the same tick carry the same index and timestamp, the
+	// way a hardware-synchronized sensor delivers them. Unthrottled frames are stamped with the
+	// time they were made.
+	void run()
+	{
+		int forcedFps = ForcedFps();
+		int frameIndex = 0;
+		uint64_t tick = 0;
+		while(m_running.load())
+		{
+			OniVideoMode mode;
+			{
+				lock_guard<mutex> lock(m_modeLock);
+				mode = m_mode;
+			}
+			int fps = (forcedFps >= 0) ? forcedFps : mode.fps;
+
+			uint64_t timestamp;
+			if(fps > 0)
+			{
+				// Next tick after the last one sent, skipping any the consumer made us miss
+				uint64_t now = SteadyMicroseconds() - m_epoch;
+				uint64_t nowTick = now * fps / 1000000 + 1;
+				tick = (nowTick > tick + 1) ? nowTick : tick + 1;
+				timestamp = tick * 1000000 / fps;
+				if(timestamp > now)
+				{
+					this_thread::sleep_for(chrono::microseconds(timestamp - now));
+				}
+				frameIndex = (int)tick;
+			}
+			else
+			{
+				timestamp = SteadyMicroseconds() - m_epoch;
+				frameIndex++;
+			}
+
+			int stride = mode.resolutionX * pixelSize(mode.pixelFormat);
+			int dataSize = stride * mode.resolutionY;
+			SyntheticFrame* synthetic = acquireFrame(dataSize);
+			OniFrame& frame = synthetic->driverFrame.frame;
+			if(mode.pixelFormat == ONI_PIXEL_FORMAT_RGB888)
+			{
+				GenerateColor((OniRGB888Pixel*)frame.data, mode.resolutionX, mode.resolutionY, frameIndex, m_mirror);
+			}
+			else
+			{
+				int scale = (mode.pixelFormat == ONI_PIXEL_FORMAT_DEPTH_100_UM) ? 10 : 1;
+				GenerateDepth((OniDepthPixel*)frame.data, mode.resolutionX, mode.resolutionY, frameIndex, m_mirror, scale);
+			}
+
+			frame.dataSize = dataSize;
+			frame.sensorType = m_sensorType;
+			frame.timestamp = timestamp;
+			frame.frameIndex = frameIndex;
+			frame.width = mode.resolutionX;
+			frame.height = mode.resolutionY;
+			frame.videoMode = mode;
+			frame.croppingEnabled = FALSE;
+			frame.cropOriginX = 0;
+			frame.cropOriginY = 0;
+			frame.stride = stride;
+
+			raiseNewFrame(&synthetic->driverFrame);
+			releaseFrame(&synthetic->driverFrame);
+		}
+	}
+
+	OniSensorType m_sensorType;
+	const OniSensorInfo& m_sensorInfo;
+	uint64_t m_epoch;
+	mutex m_modeLock;
+	OniVideoMode m_mode;
+	atomic<bool> m_mirror;
+	atomic<bool> m_running;
+	thread m_thread;
+	mutex m_poolLock;
+	vector<SyntheticFrame*> m_pool;
+};
+
+class SyntheticDevice : public DeviceBase
+{
+public:
+	SyntheticDevice(const OniDeviceInfo& info, int number) : m_info(info), m_epoch(SteadyMicroseconds()), m_registration(ONI_IMAGE_REGISTRATION_OFF)
+	{
+		snprintf(m_serial, sizeof(m_serial), "SYN%09d", number);
+
+		// Each resolution at the usual sensor rates, the first mode of each list being the default
+		static const int resolutions[][2] = { { 640, 480 }, { 320, 240 }, { 1280, 1024 } };
+		static const int rates[] = { 30, 60, 15 };
+		static const OniPixelFormat depthFormats[] = { ONI_PIXEL_FORMAT_DEPTH_1_MM, ONI_PIXEL_FORMAT_DEPTH_100_UM };
+		for(int r = 0; r < 3; r++)
+		{
+			for(int f = 0; f < 3; f++)
+			{
+				OniVideoMode mode;
+				mode.resolutionX = resolutions[r][0];
+				mode.resolutionY = resolutions[r][1];
+				mode.fps = rates[f];
+				mode.pixelFormat = ONI_PIXEL_FORMAT_RGB888;
+				m_colorModes.push_back(mode);
+				for(int d = 0; d < 2; d++)
+				{
+					mode.pixelFormat = depthFormats[d];
+					m_depthModes.push_back(mode);
+				}
+			}
+		}
+
+		m_sensors[0].sensorType = ONI_SENSOR_DEPTH;
+		m_sensors[0].numSupportedVideoModes = (int)m_depthModes.size();
+		m_sensors[0].pSupportedVideoModes = &m_depthModes[0];
+		m_sensors[1].sensorType = ONI_SENSOR_COLOR;
+		m_sensors[1].numSupportedVideoModes = (int)m_colorModes.size();
+		m_sensors[1].pSupportedVideoModes = &m_colorModes[0];
+	}
+
+	OniStatus getSensorInfoList(OniSensorInfo** pSensorInfos, int* numSensors)
+	{
+		*pSensorInfos = m_sensors;
+		*numSensors = 2;
+		return ONI_STATUS_OK;
+	}
+
+	StreamBase* createStream(OniSensorType sensorType)
+	{
+		for(int i = 0; i < 2; i++)
+		{
+			if(m_sensors[i].sensorType == sensorType)
+			{
+				return new SyntheticStream(sensorType, m_sensors[i], m_epoch);
+			}
+		}
+		return NULL;
+	}
+
+	void destroyStream(StreamBase* pStream)
+	{
+		delete pStream;
+	}
+
+	OniStatus setProperty(int propertyId, const void* data, int dataSize)
+	{
+		if(propertyId != ONI_DEVICE_PROPERTY_IMAGE_REGISTRATION)
+		{
+			return ONI_STATUS_NOT_SUPPORTED;
+		}
+		if(dataSize != sizeof(OniImageRegistrationMode))
+		{
+			return ONI_STATUS_BAD_PARAMETER;
+		}
+		m_registration = *(const OniImageRegistrationMode*)data;
+		return ONI_STATUS_OK;
+	}
+
+	OniStatus getProperty(int propertyId, void* data, int* pDataSize)
+	{
+		const void* value;
+		int size;
+		switch(propertyId)
+		{
+		case ONI_DEVICE_PROPERTY_SERIAL_NUMBER:
+		case XN_MODULE_PROPERTY_SERIAL_NUMBER:
+			value = m_serial;
+			size = (int)strlen(m_serial) + 1;
+			break;
+		case ONI_DEVICE_PROPERTY_IMAGE_REGISTRATION:
+			value = &m_registration;
+			size = sizeof(m_registration);
+			break;
+		default:
+			return ONI_STATUS_NOT_SUPPORTED;
+		}
+		if(*pDataSize < size)
+		{
+			return ONI_STATUS_BAD_PARAMETER;
+		}
+		memcpy(data, value, size);
+		*pDataSize = size;
+		return ONI_STATUS_OK;
+	}
+
+	OniBool isPropertySupported(int propertyId)
+	{
+		return (propertyId == ONI_DEVICE_PROPERTY_SERIAL_NUMBER || propertyId == XN_MODULE_PROPERTY_SERIAL_NUMBER ||
+			propertyId == ONI_DEVICE_PROPERTY_IMAGE_REGISTRATION) ? TRUE : FALSE;
+	}
+
+	// Depth and color are generated from the same scene on the same pixel grid, so they are
+	// registered already
+	OniBool isImageRegistrationModeSupported(OniImageRegistrationMode mode)
+	{
+		return (mode == ONI_IMAGE_REGISTRATION_OFF || mode == ONI_IMAGE_REGISTRATION_DEPTH_TO_COLOR) ? TRUE : FALSE;
+	}
+
+	const OniDeviceInfo& info() const { return m_info; }
+
+private:
+	OniDeviceInfo m_info;
+	uint64_t m_epoch;
+	char m_serial[32];
+	OniImageRegistrationMode m_registration;
+	vector<OniVideoMode> m_depthModes;
+	vector<OniVideoMode> m_colorModes;
+	OniSensorInfo m_sensors[2];
+};
+
+class SyntheticDriver : public DriverBase
+{
+public:
+	SyntheticDriver(OniDriverServices* pDriverServices) : DriverBase(pDriverServices)
+	{
+	}
+
+	OniStatus initialize(DeviceConnectedCallback connectedCallback, DeviceDisconnectedCallback disconnectedCallback,
+		DeviceStateChangedCallback deviceStateChangedCallback, void* pCookie)
+	{
+		OniStatus status = DriverBase::initialize(connectedCallback, disconnectedCallback, deviceStateChangedCallback, pCookie);
+		if(status != ONI_STATUS_OK)
+		{
+			return status;
+		}
+
+		const char* devices = getenv("SYNTHETIC_DEVICES");
+		int count = (devices != NULL) ? atoi(devices) : 0;
+		for(int i = 0; i < count; i++)
+		{
+			char uri[ONI_MAX_STR];
+			snprintf(uri, sizeof(uri), SYNTHETIC_URI_PREFIX "%d", i);
+			announce(uri);
+		}
+		return ONI_STATUS_OK;
+	}
+
+	// Called for a URI no driver has announced. Any synthetic://N is made to exist on demand.
+	OniStatus tryDevice(const char* uri)
+	{
+		if(parseUri(uri) < 0)
+		{
+			return ONI_STATUS_ERROR;
+		}
+		announce(uri);
+		return ONI_STATUS_OK;
+	}
+
+	DeviceBase* deviceOpen(const char* uri)
+	{
+		int number = parseUri(uri);
+		lock_guard<mutex> lock(m_lock);
+		for(size_t i = 0; number >= 0 && i < m_infos.size(); i++)
+		{
+			if(strcmp(m_infos[i].uri, uri) == 0)
+			{
+				return new SyntheticDevice(m_infos[i], number);
+			}
+		}
+		getServices().errorLoggerAppend("No synthetic device %s", uri);
+		return NULL;
+	}
+
+	void deviceClose(DeviceBase* pDevice)
+	{
+		delete pDevice;
+	}
+
+	void shutdown()
+	{
+	}
+
+	// Frames of one device's streams are synchronized by construction; nothing to set up
+	void* enableFrameSync(StreamBase** /*pStreams*/, int /*streamCount*/)
+	{
+		return this;
+	}
+
+	void disableFrameSync(void* /*frameSyncGroup*/)
+	{
+	}
+
+private:
+	// Device number of a synthetic://N URI, -1 for any other URI
+	static int parseUri(const char* uri)
+	{
+		size_t prefix = strlen(SYNTHETIC_URI_PREFIX);
+		if(uri == NULL || strncmp(uri, SYNTHETIC_URI_PREFIX, prefix) != 0)
+		{
+			return -1;
+		}
+		char* end;
+		long number = strtol(uri + prefix, &end, 10);
+		return (end == uri + prefix || *end != '\0' || number < 0) ? -1 : (int)number;
+	}
+
+	void announce(const char* uri)
+	{
+		OniDeviceInfo info;
+		memset(&info, 0, sizeof(info));
+		snprintf(info.uri, sizeof(info.uri), "%s", uri);
+		snprintf(info.vendor, sizeof(info.vendor), SYNTHETIC_VENDOR);
+		snprintf(info.name, sizeof(info.name), SYNTHETIC_NAME);
+		info.usbVendorId = SYNTHETIC_USB_VENDOR_ID;
+		info.usbProductId = SYNTHETIC_USB_PRODUCT_ID;
+		{
+			lock_guard<mutex> lock(m_lock);
+			for(size_t i = 0; i < m_infos.size(); i++)
+			{
+				if(strcmp(m_infos[i].uri, uri) == 0)
+				{
+					return;
+				}
+			}
+			m_infos.push_back(info);
+		}
+		deviceConnected(&info);
+	}
+
+	mutex m_lock;
+	vector<OniDeviceInfo> m_infos;
+};
+
+ONI_EXPORT_DRIVER(SyntheticDriver);
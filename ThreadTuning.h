@@ -0,0 +1,106 @@
+#ifndef _THREAD_TUNING_H_
+#define _THREAD_TUNING_H_
+
+// Header Includes
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <vector>
+
+// Where and how urgently one kind of thread runs. The defaults leave the thread as it was created.
+struct ThreadTuning
+{
+	ThreadTuning() : policy(SCHED_OTHER), priority(0)
+	{
+	}
+
+	// CPUs the thread may run on, empty for any
+	std::vector<int> cpus;
+	// SCHED_FIFO or SCHED_RR for real-time priority, SCHED_OTHER to keep normal time sharing
+	int policy;
+	// 1 (lowest) to 99 for the real-time policies
+	int priority;
+};
+
+// Parses a CPU list such as "2", "0,2" or "1-3,6". Returns false on a malformed list.
+inline bool ParseCpuList(const char* text, std::vector<int>& cpus)
+{
+	cpus.clear();
+	const char* p = text;
+	while(*p != '\0')
+	{
+		char* end;
+		long first = strtol(p, &end, 10);
+		long last = first;
+		if(end == p || first < 0)
+		{
+			return false;
+		}
+		if(*end == '-')
+		{
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if(end == p || last < first)
+			{
+				return false;
+			}
+		}
+		if(last >= CPU_SETSIZE)
+		{
+			return false;
+		}
+		for(long cpu = first; cpu <= last; cpu++)
+		{
+			cpus.push_back((int)cpu);
+		}
+		if(*end == ',')
+		{
+			end++;
+		}
+		else if(*end != '\0')
+		{
+			return false;
+		}
+		p = end;
+	}
+	return !cpus.empty();
+}
+
+// Pins a thread and sets its scheduling policy. Real-time policies need CAP_SYS_NICE (or an
+// RLIMIT_RTPRIO allowance); on failure returns false with errno set, leaving the rest applied.
+inline bool ApplyThreadTuning(pthread_t thread, const ThreadTuning& tuning)
+{
+	int error = 0;
+	if(!tuning.cpus.empty())
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(size_t i = 0; i < tuning.cpus.size(); i++)
+		{
+			CPU_SET(tuning.cpus[i], &set);
+		}
+		error = pthread_setaffinity_np(thread, sizeof(set), &set);
+	}
+	if(tuning.policy != SCHED_OTHER)
+	{
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = tuning.priority;
+		int result = pthread_setschedparam(thread, tuning.policy, &param);
+		error = (error != 0) ? error : result;
+	}
+	errno = error;
+	return error == 0;
+}
+
+// Locks every current and future page of the process into RAM, so the capture path never stalls
+// on a page fault. Needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK; returns false with errno set.
+inline bool LockProcessMemory()
+{
+	return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+}
+
+#endif // _THREAD_TUNING_H_
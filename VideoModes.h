@@ -0,0 +1,159 @@
+#ifndef _VIDEO_MODES_H_
+#define _VIDEO_MODES_H_
+
+// Header Includes
+#include <OpenNI.h>
+#include <ostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Command line names of the pixel formats OpenNI knows
+struct PixelFormatName
+{
+	openni::PixelFormat format;
+	const char* name;
+};
+
+static const PixelFormatName PIXEL_FORMAT_NAMES[] =
+{
+	{ openni::PIXEL_FORMAT_DEPTH_1_MM, "1mm" },
+	{ openni::PIXEL_FORMAT_DEPTH_100_UM, "100um" },
+	{ openni::PIXEL_FORMAT_SHIFT_9_2, "shift92" },
+	{ openni::PIXEL_FORMAT_SHIFT_9_3, "shift93" },
+	{ openni::PIXEL_FORMAT_RGB888, "rgb888" },
+	{ openni::PIXEL_FORMAT_YUV422, "yuv422" },
+	{ openni::PIXEL_FORMAT_GRAY8, "gray8" },
+	{ openni::PIXEL_FORMAT_GRAY16, "gray16" },
+	{ openni::PIXEL_FORMAT_JPEG, "jpeg" }
+};
+
+// Name of a pixel format, "?" if it isn't one OpenNI 2.1 defines
+inline const char* GetPixelFormatName(openni::PixelFormat format)
+{
+	for(size_t i = 0; i < sizeof(PIXEL_FORMAT_NAMES) / sizeof(PIXEL_FORMAT_NAMES[0]); i++)
+	{
+		if(PIXEL_FORMAT_NAMES[i].format == format)
+		{
+			return PIXEL_FORMAT_NAMES[i].name;
+		}
+	}
+	return "?";
+}
+
+// A wanted stream mode; fields left at 0 are chosen by SelectVideoMode
+struct VideoModeRequest
+{
+	VideoModeRequest(int requestWidth = 0, int requestHeight = 0) : width(requestWidth), height(requestHeight), fps(0), pixelFormat((openni::PixelFormat)0)
+	{
+	}
+
+	int width;
+	int height;
+	int fps;
+	openni::PixelFormat pixelFormat;
+};
+
+// Parses "WxH[@FPS][:FORMAT]", "@FPS[:FORMAT]" or ":FORMAT", e.g. "320x240@60" or "640x480@30:100um".
+// Parts that are left out keep the request's current values. Returns false on a malformed spec.
+inline bool ParseVideoModeRequest(const char* spec, VideoModeRequest& request)
+{
+	const char* p = spec;
+	if(*p >= '0' && *p <= '9')
+	{
+		char* end;
+		request.width = strtol(p, &end, 10);
+		if(*end != 'x' || end[1] < '0' || end[1] > '9')
+		{
+			return false;
+		}
+		request.height = strtol(end + 1, &end, 10);
+		p = end;
+	}
+	if(*p == '@')
+	{
+		char* end;
+		request.fps = strtol(p + 1, &end, 10);
+		if(end == p + 1)
+		{
+			return false;
+		}
+		p = end;
+	}
+	if(*p == ':')
+	{
+		p++;
+		for(size_t i = 0; i < sizeof(PIXEL_FORMAT_NAMES) / sizeof(PIXEL_FORMAT_NAMES[0]); i++)
+		{
+			if(strcmp(PIXEL_FORMAT_NAMES[i].name, p) == 0)
+			{
+				request.pixelFormat = PIXEL_FORMAT_NAMES[i].format;
+				return true;
+			}
+		}
+		return false;
+	}
+	return *p == '\0' && p != spec;
+}
+
+// Formats a mode as "WxH@FPS:FORMAT", the same way ParseVideoModeRequest reads it
+inline void FormatVideoMode(const openni::VideoMode& mode, char* text, size_t size)
+{
+	snprintf(text, size, "%dx%d@%d:%s", mode.getResolutionX(), mode.getResolutionY(), mode.getFps(), GetPixelFormatName(mode.getPixelFormat()));
+}
+
+// Picks the supported mode of a stream that matches every field the request sets. Among several,
+// the one sharing the most unset fields with the stream's current (default) mode wins, so e.g.
+// asking only for a resolution keeps the driver's default fps and pixel format. Returns false if
+// the sensor supports no such mode.
+inline bool SelectVideoMode(const openni::VideoStream& stream, const VideoModeRequest& request, openni::VideoMode& selected)
+{
+	const openni::VideoMode current = stream.getVideoMode();
+	const openni::Array<openni::VideoMode>& modes = stream.getSensorInfo().getSupportedVideoModes();
+	int bestScore = -1;
+	for(int i = 0; i < modes.getSize(); i++)
+	{
+		const openni::VideoMode& mode = modes[i];
+		if((request.width != 0 && (mode.getResolutionX() != request.width || mode.getResolutionY() != request.height)) ||
+			(request.fps != 0 && mode.getFps() != request.fps) || (request.pixelFormat != 0 && mode.getPixelFormat() != request.pixelFormat))
+		{
+			continue;
+		}
+
+		int score = (mode.getResolutionX() == current.getResolutionX() && mode.getResolutionY() == current.getResolutionY()) +
+			(mode.getFps() == current.getFps()) + (mode.getPixelFormat() == current.getPixelFormat());
+		if(score > bestScore)
+		{
+			bestScore = score;
+			selected = mode;
+		}
+	}
+	return bestScore >= 0;
+}
+
+// Lists every mode each sensor of a device supports: depth, color and IR
+inline void PrintSupportedVideoModes(std::ostream& out, openni::Device& device)
+{
+	static const openni::SensorType sensors[] = { openni::SENSOR_DEPTH, openni::SENSOR_COLOR, openni::SENSOR_IR };
+	static const char* sensorNames[] = { "Depth", "Color", "IR" };
+	for(int s = 0; s < 3; s++)
+	{
+		const openni::SensorInfo* info = device.getSensorInfo(sensors[s]);
+		if(info == NULL)
+		{
+			continue;
+		}
+
+		out << sensorNames[s] << " modes :";
+		const openni::Array<openni::VideoMode>& modes = info->getSupportedVideoModes();
+		for(int i = 0; i < modes.getSize(); i++)
+		{
+			char text[64];
+			FormatVideoMode(modes[i], text, sizeof(text));
+			out << " " << text;
+		}
+		out << std::endl;
+	}
+}
+
+#endif // _VIDEO_MODES_H_
@@ -0,0 +1,158 @@
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+// Header Includes
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Runs jobs on a fixed set of worker threads and hands them back in the order they were
+// submitted, however the workers finish. Used for per-frame encoding, where frames must
+// reach the output in capture order. Callers keep at most maxQueued jobs outstanding by taking
+// a finished job back with next() whenever full(), which bounds memory and pushes back on the
+// caller when the workers can't keep up.
+template <typename Job>
+class OrderedWorkerPool
+{
+public:
+	OrderedWorkerPool(unsigned int threads, unsigned int maxQueued, std::function<void(Job&)> work) :
+		m_work(work), m_maxQueued(maxQueued), m_stopping(false)
+	{
+		for(unsigned int i = 0; i < threads; i++)
+		{
+			m_threads.push_back(std::thread(&OrderedWorkerPool::workerThread, this));
+		}
+	}
+
+	~OrderedWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_workAvailable.notify_all();
+		for(size_t i = 0; i < m_threads.size(); i++)
+		{
+			m_threads[i].join();
+		}
+		for(size_t i = 0; i < m_order.size(); i++)
+		{
+			delete m_order[i];
+		}
+	}
+
+	// Queues a job for the workers
+	void submit(Job&& job)
+	{
+		Entry* entry = new Entry;
+		entry->job = std::move(job);
+		entry->done = false;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_order.push_back(entry);
+		m_todo.push_back(entry);
+		lock.unlock();
+		m_workAvailable.notify_one();
+	}
+
+	// Takes the oldest job once its work has finished. Without wait, returns false straight away
+	// if there is no job or the oldest one is still being worked on.
+	bool next(Job& job, bool wait)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if(wait)
+		{
+			m_jobDone.wait(lock, [this] { return m_order.empty() || m_order.front()->done; });
+		}
+		if(m_order.empty() || !m_order.front()->done)
+		{
+			return false;
+		}
+
+		Entry* entry = m_order.front();
+		m_order.pop_front();
+		lock.unlock();
+
+		job = std::move(entry->job);
+		delete entry;
+		return true;
+	}
+
+	// Jobs submitted but not yet taken back with next()
+	unsigned int outstanding()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_order.size();
+	}
+
+	// True once maxQueued jobs are outstanding
+	bool full()
+	{
+		return outstanding() >= m_maxQueued;
+	}
+
+	unsigned int threads() const { return m_threads.size(); }
+
+	// Native handles of the worker threads, e.g. to pin them to CPUs
+	std::vector<std::thread::native_handle_type> threadHandles()
+	{
+		std::vector<std::thread::native_handle_type> handles;
+		for(size_t i = 0; i < m_threads.size(); i++)
+		{
+			handles.push_back(m_threads[i].native_handle());
+		}
+		return handles;
+	}
+
+private:
+	OrderedWorkerPool(const OrderedWorkerPool&);
+	OrderedWorkerPool& operator=(const OrderedWorkerPool&);
+
+	struct Entry
+	{
+		Job job;
+		bool done;
+	};
+
+	void workerThread()
+	{
+		while(true)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_workAvailable.wait(lock, [this] { return m_stopping || !m_todo.empty(); });
+			if(m_todo.empty())
+			{
+				return;
+			}
+			Entry* entry = m_todo.front();
+			m_todo.pop_front();
+			lock.unlock();
+
+			m_work(entry->job);
+
+			lock.lock();
+			entry->done = true;
+			lock.unlock();
+			m_jobDone.notify_all();
+		}
+	}
+
+	std::function<void(Job&)> m_work;
+	unsigned int m_maxQueued;
+	bool m_stopping;
+
+	// Every outstanding job in submission order, and the ones no worker has picked up yet
+	std::deque<Entry*> m_order;
+	std::deque<Entry*> m_todo;
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_workAvailable;
+	std::condition_variable m_jobDone;
+};
+
+#endif // _WORKER_POOL_H_
@@ -81,7 +81,7 @@ int main( const int argc, const char* argv[] )
 
 	/*Set Depth and Color Synchronization*/
 	ret = device.setDepthColorSyncEnabled(TRUE);
-	if (~( ret == openni::STATUS_OK )){
+	if ( ret != openni::STATUS_OK ){
 				cout << "Can't sync depth and color" << endl;
 	}
 
@@ -148,7 +148,7 @@ int main( const int argc, const char* argv[] )
 	
 	//Set Image Registration Mode (Depth to color)
 	ret = device.setImageRegistrationMode(openni::IMAGE_REGISTRATION_DEPTH_TO_COLOR);
-	if (~( ret == openni::STATUS_OK )){
+	if ( ret != openni::STATUS_OK ){
 		cout << "Can't set depth to color registration" << endl;
 	}
 